@@ -0,0 +1,97 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_CHUNK_STORE_BDS_
+#define _BDS_BENCH_CHUNK_STORE_BDS_
+
+#include <bench.h>
+#include <game/chunk_store.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <vector>
+
+void bench_chunk_store_grid(min::thread_pool &pool, std::mt19937 &gen, const size_t grid)
+{
+    const size_t scale = grid * 2;
+    const size_t chunk_size = 8;
+    const size_t cells = scale * scale * scale;
+
+    // Generate a normal world into a scratch buffer
+    std::vector<game::block_id> back(cells, game::block_id::EMPTY);
+    kernel::terrain_base base(scale, chunk_size, 0, scale / 2, 1);
+    base.generate(pool, back);
+    kernel::terrain_height height(scale, chunk_size, scale / 2, scale - 1, 1);
+    height.generate(pool, back);
+
+    // Compress the scratch buffer into chunks and release it
+    bench_timer timer;
+    game::chunk_store store(scale, chunk_size);
+    store.load(pool, back);
+    const double load_ms = timer.elapsed_ms();
+    std::vector<game::block_id>().swap(back);
+    const size_t sparse_peak = peak_rss_kb();
+    const size_t sparse_rss = current_rss_kb();
+
+    // Time random reads against the chunk store
+    std::uniform_int_distribution<size_t> dist(0, cells - 1);
+    size_t count = 0;
+    timer.reset();
+    for (size_t i = 0; i < 1000000; i++)
+    {
+        count += (store.get(dist(gen)) != game::block_id::EMPTY);
+    }
+    const double get_ms = timer.elapsed_ms();
+
+    // Allocate and touch the old dense layout: grid, visit and back buffers
+    std::vector<game::block_id> dense_grid(cells, game::block_id::EMPTY);
+    std::vector<int_fast8_t> dense_visit(cells, -1);
+    std::vector<game::block_id> dense_back(cells, game::block_id::EMPTY);
+    const size_t dense_peak = peak_rss_kb();
+    const size_t dense_bytes = dense_grid.size() + dense_visit.size() + dense_back.size();
+
+    std::cout << "grid " << grid << ": cells " << cells
+              << ", dense grid+visit+back " << dense_bytes / 1024 << " KB"
+              << ", chunk store " << store.bytes() / 1024 << " KB"
+              << " (" << (100.0 * store.bytes()) / (2 * cells) << "% of dense grid+back)" << std::endl;
+    std::cout << "    peak RSS after chunk store " << sparse_peak << " KB"
+              << ", current RSS " << sparse_rss << " KB"
+              << ", peak RSS after dense layout " << dense_peak << " KB" << std::endl;
+    std::cout << "    compress " << load_ms << " ms"
+              << ", 1M random get " << get_ms << " ms (" << count << " solid)" << std::endl;
+}
+
+void bench_chunk_store()
+{
+    bench_header("chunk_store memory");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+    std::mt19937 gen(1);
+    pool.seed(1);
+
+    // Grids are run in ascending size so peak RSS is monotonic
+    for (const size_t grid : {64, 128, 256})
+    {
+        bench_chunk_store_grid(pool, gen, grid);
+    }
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
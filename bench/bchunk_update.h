@@ -0,0 +1,150 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_CHUNK_UPDATE_BDS_
+#define _BDS_BENCH_CHUNK_UPDATE_BDS_
+
+#include <bench.h>
+#include <game/chunk_store.h>
+#include <game/terrain_mesher.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <vector>
+
+// Face culling modes, grid lookups, padded apron strides, padded occupancy bitmasks
+enum class bench_cull
+{
+    grid,
+    strided,
+    bitmask
+};
+
+void bench_chunk_update_mode(const game::chunk_store &store, const size_t scale, const size_t chunk_size, const bench_cull mode)
+{
+    const size_t chunk_scale = scale / chunk_size;
+    const size_t chunks = chunk_scale * chunk_scale * chunk_scale;
+    const float world_min = -static_cast<float>(scale / 2);
+    const size_t edge = scale - 1;
+    const auto edges = min::tri<size_t>(edge, edge, edge);
+
+    // Function to retrieve block value, packs a grid key per call
+    const auto get_block = [&store](const min::tri<size_t> &index) -> game::block_id {
+        return store.get(index);
+    };
+
+    // Mesh every chunk like cgrid::chunk_update
+    game::terrain_mesher mesher(chunk_size);
+    min::mesh<float, uint32_t> mesh("chunk");
+    std::vector<game::block_id> scratch;
+    double faces_ms = 0.0;
+    size_t faces = 0;
+    bench_timer total;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        const size_t cx = key / (chunk_scale * chunk_scale);
+        const size_t cy = (key / chunk_scale) % chunk_scale;
+        const size_t cz = key % chunk_scale;
+        const size_t xs = cx * chunk_size;
+        const size_t ys = cy * chunk_size;
+        const size_t zs = cz * chunk_size;
+
+        // Clear the mesh and mesher
+        mesh.clear();
+        mesher.clear();
+        mesher.set_origin(min::vec3<float>(xs, ys, zs) + world_min);
+
+        // Generate cell faces
+        bench_timer timer;
+        if (mode == bench_cull::strided)
+        {
+            store.copy_apron(key, scratch, game::block_id::INVALID);
+            mesher.generate_chunk_strided(scratch);
+        }
+        else if (mode == bench_cull::bitmask)
+        {
+            store.copy_apron(key, scratch, game::block_id::INVALID);
+            mesher.generate_chunk_masked(scratch);
+        }
+        else
+        {
+            for (size_t x = xs; x < xs + chunk_size; x++)
+            {
+                for (size_t y = ys; y < ys + chunk_size; y++)
+                {
+                    for (size_t z = zs; z < zs + chunk_size; z++)
+                    {
+                        const auto index = min::tri<size_t>(x, y, z);
+                        const game::block_id atlas = get_block(index);
+                        if (atlas != game::block_id::EMPTY)
+                        {
+                            const min::vec3<float> p = min::vec3<float>(x, y, z) + world_min + 0.5;
+                            mesher.generate_chunk_faces(p, index, edges, get_block, static_cast<float>(atlas));
+                        }
+                    }
+                }
+            }
+        }
+        faces_ms += timer.elapsed_ms();
+
+        // Build the vertex buffers
+        mesher.generate_chunk_serial(mesh);
+        faces += mesh.vertex.size() / 6;
+    }
+    const double total_ms = total.elapsed_ms();
+    const double cells = static_cast<double>(chunks * chunk_size * chunk_size * chunk_size);
+
+    const char *const names[] = {"grid lookups ", "padded stride", "bitmask      "};
+    std::cout << "    chunk " << chunk_size << ", " << names[static_cast<size_t>(mode)]
+              << ": faces " << faces
+              << ", face culling " << cells / (faces_ms * 1000.0) << " M cells/s"
+              << ", chunk_update " << cells / (total_ms * 1000.0) << " M cells/s" << std::endl;
+}
+
+void bench_chunk_update()
+{
+    bench_header("chunk_update throughput");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+    pool.seed(1);
+
+    // Generate a normal world
+    const size_t scale = 128;
+    std::vector<game::block_id> back(scale * scale * scale, game::block_id::EMPTY);
+    kernel::terrain_base base(scale, 8, 0, scale / 2, 1);
+    base.generate(pool, back);
+    kernel::terrain_height height(scale, 8, scale / 2, scale - 1, 1);
+    height.generate(pool, back);
+
+    for (const size_t chunk_size : {8, 16, 32})
+    {
+        // Compress the world into chunks
+        game::chunk_store store(scale, chunk_size);
+        store.load(pool, back);
+
+        // Compare per cell grid lookups against the padded chunk copy
+        bench_chunk_update_mode(store, scale, chunk_size, bench_cull::grid);
+        bench_chunk_update_mode(store, scale, chunk_size, bench_cull::strided);
+        bench_chunk_update_mode(store, scale, chunk_size, bench_cull::bitmask);
+    }
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
@@ -0,0 +1,95 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCHUTIL_BDS_
+#define _BDS_BENCHUTIL_BDS_
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#if defined(__unix__) || defined(__CYGWIN__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+class bench_timer
+{
+  private:
+    std::chrono::high_resolution_clock::time_point _start;
+
+  public:
+    bench_timer() : _start(std::chrono::high_resolution_clock::now()) {}
+
+    inline double elapsed_ms() const
+    {
+        // Calculate elapsed time since start in milliseconds
+        const auto stop = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(stop - _start).count();
+    }
+    inline void reset()
+    {
+        _start = std::chrono::high_resolution_clock::now();
+    }
+};
+
+inline size_t peak_rss_kb()
+{
+#if defined(__unix__) || defined(__CYGWIN__)
+    // Get the peak resident set size of this process
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        return static_cast<size_t>(usage.ru_maxrss);
+    }
+#endif
+
+    // Not supported on this platform
+    return 0;
+}
+
+inline size_t current_rss_kb()
+{
+#if defined(__linux__)
+    // Read the current resident pages of this process
+    size_t pages = 0;
+    size_t resident = 0;
+    FILE *f = std::fopen("/proc/self/statm", "r");
+    if (f)
+    {
+        if (std::fscanf(f, "%zu %zu", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        std::fclose(f);
+    }
+
+    // Convert pages to KB
+    return (resident * sysconf(_SC_PAGESIZE)) / 1024;
+#else
+    return peak_rss_kb();
+#endif
+}
+
+inline void bench_header(const std::string &name)
+{
+    std::cout << std::endl
+              << "== " << name << " ==" << std::endl;
+}
+
+#endif
@@ -0,0 +1,280 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_GRID_SEARCH_BDS_
+#define _BDS_BENCH_GRID_SEARCH_BDS_
+
+#include <algorithm>
+#include <bench.h>
+#include <game/chunk_store.h>
+#include <game/flow_field.h>
+#include <game/grid_search.h>
+#include <game/nav_graph.h>
+#include <game/path_queue.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <memory>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+void bench_grid_search_grid(min::thread_pool &pool, const size_t grid)
+{
+    const size_t scale = grid * 2;
+    const size_t chunk_size = 8;
+    const size_t searches = 5000;
+
+    // Generate a normal world straight into chunks
+    game::chunk_store store(scale, chunk_size);
+    const kernel::terrain_base base(scale, chunk_size, 0, scale / 2, 1);
+    const kernel::terrain_height height(scale, chunk_size, scale / 2, scale - 1, 1);
+    store.generate(pool, [&base, &height](const min::tri<size_t> &start, std::vector<game::block_id> &cells) {
+        base.generate_chunk(start, cells);
+        height.generate_chunk(start, cells);
+    });
+
+    // Drone searches above the terrain to a cell nearby, like path::step, or anywhere in the sky
+    game::grid_search search(scale);
+    std::uniform_int_distribution<size_t> xz(0, scale - 1);
+    std::uniform_int_distribution<size_t> y(scale - scale / 8, scale - 1);
+    std::uniform_int_distribution<int> step(-6, 6);
+    const auto clamp = [scale](const size_t v, const int d) -> size_t {
+        return static_cast<size_t>(std::min(std::max(static_cast<int>(v) + d, 0), static_cast<int>(scale) - 1));
+    };
+    for (const bool far : {false, true})
+    {
+        // Time searches, each search only touches the cells it explores
+        std::mt19937 gen(1);
+        size_t found = 0;
+        size_t expanded = 0;
+        bench_timer timer;
+        for (size_t i = 0; i < searches; i++)
+        {
+            // Drones and players are never inside terrain
+            min::tri<size_t> a(0, 0, 0);
+            min::tri<size_t> b(0, 0, 0);
+            do
+            {
+                a = min::tri<size_t>(xz(gen), y(gen), xz(gen));
+                b = far ? min::tri<size_t>(xz(gen), y(gen), xz(gen))
+                        : min::tri<size_t>(clamp(a.x(), step(gen)), clamp(a.y(), step(gen)), clamp(a.z(), step(gen)));
+            } while (store.get(a) != game::block_id::EMPTY || store.get(b) != game::block_id::EMPTY);
+
+            search.search(store, min::vec3<float>::grid_key(a, scale), min::vec3<float>::grid_key(b, scale));
+            found += search.is_found();
+            expanded += search.get_expanded();
+        }
+        const double search_ms = timer.elapsed_ms();
+
+        std::cout << "grid " << grid << (far ? " far:  " : " near: ") << searches / (search_ms / 1000.0) << " searches/s"
+                  << ", " << 1000.0 * search_ms / searches << " us per search"
+                  << ", " << static_cast<double>(expanded) / searches << " nodes expanded per search"
+                  << ", " << found << " of " << searches << " reached the goal" << std::endl;
+    }
+
+    // Drones chasing one goal share a flow field, build it in one frame to time it
+    std::mt19937 gen(1);
+    min::tri<size_t> goal(0, 0, 0);
+    do
+    {
+        goal = min::tri<size_t>(xz(gen), y(gen), xz(gen));
+    } while (store.get(goal) != game::block_id::EMPTY);
+    const size_t goal_key = min::vec3<float>::grid_key(goal, scale);
+    game::flow_field field(scale, 32);
+    field.set_budget(scale * scale * scale);
+    field.set_goal(goal_key);
+    bench_timer build_timer;
+    field.update(store);
+    const double build_ms = build_timer.elapsed_ms();
+
+    // Every drone reads its next steps from the field
+    size_t walked = 0;
+    bench_timer walk_timer;
+    for (size_t i = 0; i < searches; i++)
+    {
+        min::tri<size_t> a(0, 0, 0);
+        do
+        {
+            a = min::tri<size_t>(xz(gen), y(gen), xz(gen));
+        } while (store.get(a) != game::block_id::EMPTY);
+        walked += field.path(store, min::vec3<float>::grid_key(a, scale), goal_key);
+    }
+    const double walk_ms = walk_timer.elapsed_ms();
+
+    std::cout << "grid " << grid << " flow: " << build_ms << " ms to build the field"
+              << ", " << searches / (walk_ms / 1000.0) << " paths/s"
+              << ", " << 1000.0 * walk_ms / searches << " us per path"
+              << ", " << walked << " of " << searches << " inside the field" << std::endl;
+
+    // Chunks shared by path snapshots, copied on first use
+    const size_t chunk_scale = scale / chunk_size;
+    std::vector<std::shared_ptr<const game::palette_chunk>> shared(chunk_scale * chunk_scale * chunk_scale);
+    const auto snapshot = [&store, &shared, scale, chunk_size, chunk_scale](const min::tri<size_t> &a) -> game::path_snapshot {
+        const size_t r = 20;
+        const min::tri<size_t> lower((a.x() - std::min(a.x(), r)) / chunk_size, (a.y() - std::min(a.y(), r)) / chunk_size, (a.z() - std::min(a.z(), r)) / chunk_size);
+        const min::tri<size_t> upper(std::min(a.x() + r, scale - 1) / chunk_size + 1, std::min(a.y() + r, scale - 1) / chunk_size + 1, std::min(a.z() + r, scale - 1) / chunk_size + 1);
+        game::path_snapshot out(scale, chunk_size, lower, upper);
+        for (size_t x = lower.x(); x < upper.x(); x++)
+        {
+            for (size_t y = lower.y(); y < upper.y(); y++)
+            {
+                for (size_t z = lower.z(); z < upper.z(); z++)
+                {
+                    const size_t ckey = (x * chunk_scale * chunk_scale) + (y * chunk_scale) + z;
+                    if (!shared[ckey])
+                    {
+                        shared[ckey] = std::make_shared<const game::palette_chunk>(store.get_chunk(ckey));
+                    }
+                    out.push_back(shared[ckey], 0);
+                }
+            }
+        }
+        return out;
+    };
+
+    // Chunk graphs route over a snapshot of the whole world
+    game::path_snapshot all(scale, chunk_size, min::tri<size_t>(0, 0, 0), min::tri<size_t>(chunk_scale, chunk_scale, chunk_scale));
+    for (size_t ckey = 0; ckey < shared.size(); ckey++)
+    {
+        if (!shared[ckey])
+        {
+            shared[ckey] = std::make_shared<const game::palette_chunk>(store.get_chunk(ckey));
+        }
+        all.push_back(shared[ckey], 0);
+    }
+    const std::shared_ptr<const game::path_snapshot> world = std::make_shared<const game::path_snapshot>(std::move(all));
+
+    // Ten drones request far paths from the worker queue, the game thread only pays for the snapshot
+    game::path_queue queue(scale, chunk_size, 20, 1);
+    const size_t drones = 10;
+    size_t done = 0;
+    double submit_ms = 0.0;
+    bench_timer queue_timer;
+    for (size_t i = 0; i < searches; i += drones)
+    {
+        std::vector<std::pair<min::tri<size_t>, min::tri<size_t>>> batch;
+        for (size_t j = 0; j < drones; j++)
+        {
+            min::tri<size_t> a(0, 0, 0);
+            min::tri<size_t> b(0, 0, 0);
+            do
+            {
+                a = min::tri<size_t>(xz(gen), y(gen), xz(gen));
+                b = min::tri<size_t>(xz(gen), y(gen), xz(gen));
+            } while (store.get(a) != game::block_id::EMPTY || store.get(b) != game::block_id::EMPTY);
+            batch.emplace_back(a, b);
+        }
+
+        // Time the requests
+        bench_timer submit_timer;
+        for (size_t j = 0; j < drones; j++)
+        {
+            const min::tri<size_t> &a = batch[j].first;
+            queue.push(j, i, min::vec3<float>::grid_key(a, scale), min::vec3<float>::grid_key(batch[j].second, scale), snapshot(a), std::shared_ptr<const game::path_snapshot>(world));
+        }
+        submit_ms += submit_timer.elapsed_ms();
+
+        // Collect the batch like the frames that follow
+        while (done < i + drones)
+        {
+            std::this_thread::yield();
+            queue.pop([&done](const size_t, const size_t, const std::vector<size_t> &) {
+                done++;
+            });
+        }
+    }
+    const double queue_ms = queue_timer.elapsed_ms();
+
+    std::cout << "grid " << grid << " queue: " << searches / (queue_ms / 1000.0) << " paths/s"
+              << ", " << 1000.0 * submit_ms / searches << " us per request on the game thread"
+              << ", " << queue.get_latency_avg() << " ms average latency"
+              << ", " << queue.get_latency_max() << " ms max latency"
+              << ", " << queue.get_max_depth() << " max queue depth" << std::endl;
+
+    // Long routes between empty cells anywhere in the world, through the terrain if there is a way
+    const size_t routes = 1000;
+    std::vector<std::pair<size_t, size_t>> pairs;
+    pairs.reserve(routes);
+    while (pairs.size() < routes)
+    {
+        const min::tri<size_t> a(xz(gen), xz(gen), xz(gen));
+        const min::tri<size_t> b(xz(gen), xz(gen), xz(gen));
+        if (store.get(a) == game::block_id::EMPTY && store.get(b) == game::block_id::EMPTY)
+        {
+            pairs.emplace_back(min::vec3<float>::grid_key(a, scale), min::vec3<float>::grid_key(b, scale));
+        }
+    }
+
+    // Plan on the chunk graph with the drone route budget, chunks are built by the first pass and reused by the second
+    game::nav_graph nav(scale, chunk_size);
+    nav.set_budget(2048, scale * scale * scale);
+    for (const bool warm : {false, true})
+    {
+        size_t routed = 0;
+        size_t expanded = 0;
+        const size_t built = nav.get_built();
+        bench_timer timer;
+        for (const auto &p : pairs)
+        {
+            routed += nav.route(*world, p.first, p.second, 20);
+            expanded += nav.get_expanded();
+        }
+        const double route_ms = timer.elapsed_ms();
+
+        std::cout << "grid " << grid << (warm ? " nav warm: " : " nav cold: ") << 1000.0 * route_ms / routes << " us per route"
+                  << ", " << static_cast<double>(expanded) / routes << " portals expanded per route"
+                  << ", " << nav.get_built() - built << " chunks built"
+                  << ", " << routed << " of " << routes << " routed" << std::endl;
+    }
+
+    // Cell search toward the same goals with the drone query budget
+    size_t reached = 0;
+    bench_timer cell_timer;
+    for (const auto &p : pairs)
+    {
+        search.search(store, p.first, p.second);
+        reached += search.is_found();
+    }
+    const double cell_ms = cell_timer.elapsed_ms();
+
+    std::cout << "grid " << grid << " cell: " << 1000.0 * cell_ms / routes << " us per search"
+              << ", " << reached << " of " << routes << " reached the goal" << std::endl;
+}
+
+void bench_grid_search()
+{
+    bench_header("grid search");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+
+    // Near searches per second should not depend on the world size, far searches are capped by the node budget
+    // Flow field paths cost a few lookups per step, the field build is capped by its radius
+    // Queued paths cost the game thread a chunk snapshot, latency depends on the worker
+    // Chunk graph routes scale with the chunks crossed, cell searches with the cells explored
+    for (const size_t grid : {16, 32, 64, 128})
+    {
+        bench_grid_search_grid(pool, grid);
+    }
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
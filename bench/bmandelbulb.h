@@ -0,0 +1,140 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_MANDELBULB_BDS_
+#define _BDS_BENCH_MANDELBULB_BDS_
+
+#include <bench.h>
+#include <game/chunk_store.h>
+#include <kernel/mandelbulb_asym.h>
+#include <kernel/mandelbulb_exp.h>
+#include <kernel/mandelbulb_sym.h>
+#include <min/thread_pool.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <string>
+#include <vector>
+
+template <typename K>
+void bench_mandelbulb_kernel(const std::string &name, K &k, min::thread_pool &pool, const size_t scale)
+{
+    // Cell centers of a portal grid
+    const auto f = [scale](const size_t i) -> min::vec3<float> {
+        const float half = scale / 2;
+        const size_t x = i / (scale * scale);
+        const size_t y = (i / scale) % scale;
+        const size_t z = i % scale;
+        return min::vec3<float>(x - half + 0.5, y - half + 0.5, z - half + 0.5);
+    };
+    std::vector<game::block_id> grid(scale * scale * scale);
+    const double cells = static_cast<double>(grid.size());
+
+    // Generate one cell at a time, then with the best supported lane width, then folded by symmetry
+    const kernel::simd_level levels[] = {kernel::simd_level::scalar, kernel::simd_support(), kernel::simd_support()};
+    const bool folds[] = {false, false, true};
+    double scalar_ms = 0.0;
+    for (size_t i = 0; i < 3; i++)
+    {
+        std::fill(grid.begin(), grid.end(), game::block_id::EMPTY);
+        k.set_simd(levels[i]);
+        k.set_fold(folds[i]);
+        bench_timer timer;
+        k.generate(pool, grid, scale, f);
+        const double ms = timer.elapsed_ms();
+        if (i == 0)
+        {
+            scalar_ms = ms;
+        }
+
+        std::cout << "    " << name << " " << kernel::simd_lanes(levels[i]) << " lanes"
+                  << (kernel::simd_lanes(levels[i]) < 10 ? " " : "") << (folds[i] ? " folded" : "       ") << ": "
+                  << ms << " ms, " << cells / (ms * 1000.0) << " M cells/s, speedup "
+                  << scalar_ms / ms << "x" << std::endl;
+    }
+}
+
+template <typename K>
+void bench_mandelbulb_chunks(const std::string &name, K &k, min::thread_pool &pool, const size_t scale, const bool back)
+{
+    // Cell centers of a portal grid
+    const auto f = [scale](const size_t i) -> min::vec3<float> {
+        const float half = scale / 2;
+        const size_t x = i / (scale * scale);
+        const size_t y = (i / scale) % scale;
+        const size_t z = i % scale;
+        return min::vec3<float>(x - half + 0.5, y - half + 0.5, z - half + 0.5);
+    };
+    const size_t chunk_size = 16;
+    k.set_simd(kernel::simd_support());
+    k.set_fold(true);
+
+    // Freed memory stays with the allocator between runs, count the generation buffers directly
+    game::chunk_store store(scale, chunk_size);
+    size_t buffer = 0;
+    bench_timer timer;
+    if (back)
+    {
+        // Generate into a dense back buffer and compress it into the store
+        std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+        k.generate(pool, grid, scale, f);
+        store.load(pool, grid);
+        buffer = grid.size() * sizeof(game::block_id);
+    }
+    else
+    {
+        // Generate each chunk straight into the store, each job only needs one chunk of scratch cells
+        k.prepare(pool, scale, f);
+        store.generate(pool, [&k, chunk_size, scale, &f](const min::tri<size_t> &start, std::vector<game::block_id> &cells) {
+            k.generate_chunk(start, cells, chunk_size, scale, f);
+        });
+        buffer = store.get_chunk_cells() * sizeof(game::block_id);
+    }
+    const double ms = timer.elapsed_ms();
+
+    std::cout << "    " << name << (back ? " back buffer: " : " chunked:     ") << ms << " ms, "
+              << "cell buffer " << buffer / 1024 << " KB, store " << store.bytes() / 1024 << " KB" << std::endl;
+}
+
+void bench_mandelbulb()
+{
+    bench_header("portal mandelbulb generation");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+
+    // Portal at -grid 128
+    const size_t scale = 128;
+    kernel::mandelbulb_sym sym(1, 10, 30, 5);
+    bench_mandelbulb_kernel("sym ", sym, pool, scale);
+    kernel::mandelbulb_asym asym(1, 10, 30, 5, 2, 8, 20, 4, 3, 12, 25, 6);
+    bench_mandelbulb_kernel("asym", asym, pool, scale);
+    kernel::mandelbulb_exp exp(3, 5, 7, 2);
+    bench_mandelbulb_kernel("exp ", exp, pool, scale);
+
+    // Portal generated straight into chunks and through a back buffer
+    for (const bool back : {false, true})
+    {
+        bench_mandelbulb_chunks("sym ", sym, pool, scale * 2, back);
+        bench_mandelbulb_chunks("asym", asym, pool, scale * 2, back);
+        bench_mandelbulb_chunks("exp ", exp, pool, scale * 2, back);
+    }
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
@@ -0,0 +1,134 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_MANDELBULB_EXP_BDS_
+#define _BDS_BENCH_MANDELBULB_EXP_BDS_
+
+#include <bench.h>
+#include <game/file.h>
+#include <kernel/mandelbulb_exp.h>
+#include <min/mem_chunk.h>
+#include <min/strtoken.h>
+#include <min/thread_pool.h>
+#include <min/vec3.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+void bench_mandelbulb_exp(const bool print_lines, const size_t scale)
+{
+    bench_header("portal exp accuracy, " + std::to_string(scale) + "^3 per man_exp line");
+
+    // Load the exp portal coefficients from the game data
+    std::string portal;
+    try
+    {
+        min::mem_chunk data(DATA_FILE);
+        portal = data.get_file("data/portals/man_exp.portal").to_string();
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << "    skipped, can't load '" << DATA_FILE << "': " << ex.what() << std::endl;
+        return;
+    }
+    const std::vector<std::pair<size_t, size_t>> lines = min::read_lines(portal, 738);
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+
+    // Cell centers of a portal grid
+    const auto f = [scale](const size_t i) -> min::vec3<float> {
+        const float half = scale / 2;
+        const size_t x = i / (scale * scale);
+        const size_t y = (i / scale) % scale;
+        const size_t z = i % scale;
+        return min::vec3<float>(x - half + 0.5, y - half + 0.5, z - half + 0.5);
+    };
+    std::vector<game::block_id> reference(scale * scale * scale);
+    std::vector<game::block_id> grid(reference.size());
+
+    // Approximate exp modes compared against std::exp
+    const kernel::exp_mode modes[] = {kernel::exp_mode::bounded, kernel::exp_mode::fast};
+    const char *const names[] = {"bounded", "fast"};
+    double libm_ms = 0.0;
+    double mode_ms[2] = {0.0, 0.0};
+    size_t cells[2] = {0, 0};
+    size_t differ[2] = {0, 0};
+    size_t worst[2] = {0, 0};
+    for (const auto &p : lines)
+    {
+        // Parse the string into four ints
+        std::istringstream ss(portal.substr(p.first, p.second));
+        int a, b, c, d;
+        ss >> a >> b >> c >> d;
+        if (ss.fail())
+        {
+            throw std::runtime_error("bench_mandelbulb_exp: Invalid man_exp line '" + ss.str() + "'");
+        }
+        kernel::mandelbulb_exp k(a, b, c, d);
+
+        // Generate the reference with std::exp
+        std::fill(reference.begin(), reference.end(), game::block_id::EMPTY);
+        k.set_exp(kernel::exp_mode::libm);
+        bench_timer timer;
+        k.generate(pool, reference, scale, f);
+        libm_ms += timer.elapsed_ms();
+
+        // Count cells that differ for each approximation
+        size_t count[2];
+        for (size_t m = 0; m < 2; m++)
+        {
+            std::fill(grid.begin(), grid.end(), game::block_id::EMPTY);
+            k.set_exp(modes[m]);
+            timer.reset();
+            k.generate(pool, grid, scale, f);
+            mode_ms[m] += timer.elapsed_ms();
+
+            count[m] = 0;
+            for (size_t i = 0; i < grid.size(); i++)
+            {
+                count[m] += (grid[i] != reference[i]);
+            }
+            cells[m] += count[m];
+            differ[m] += (count[m] > 0);
+            worst[m] = std::max(worst[m], count[m]);
+        }
+
+        // Report every coefficient line if requested
+        if (print_lines)
+        {
+            std::cout << "    " << a << " " << b << " " << c << " " << d
+                      << ": bounded " << count[0] << ", fast " << count[1] << std::endl;
+        }
+    }
+
+    // Summarize each mode
+    const double total = static_cast<double>(reference.size() * lines.size());
+    std::cout << "    libm    : " << libm_ms << " ms" << std::endl;
+    for (size_t m = 0; m < 2; m++)
+    {
+        std::cout << "    " << names[m] << (m == 0 ? "" : "   ") << " : " << mode_ms[m] << " ms, speedup "
+                  << libm_ms / mode_ms[m] << "x, " << cells[m] << " cells differ ("
+                  << 100.0 * cells[m] / total << "%), " << differ[m] << "/" << lines.size()
+                  << " lines differ, worst line " << worst[m] << " cells" << std::endl;
+    }
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
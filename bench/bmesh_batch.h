@@ -0,0 +1,107 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_MESH_BATCH_BDS_
+#define _BDS_BENCH_MESH_BATCH_BDS_
+
+#include <bench.h>
+#include <game/chunk_store.h>
+#include <game/mesh_batch.h>
+#include <game/terrain_mesher.h>
+#include <game/work_queue.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <numeric>
+#include <vector>
+
+void bench_mesh_batch()
+{
+    bench_header("initial world meshing");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+    pool.seed(1);
+
+    // Generate a normal world and compress it into chunks
+    const size_t scale = 128;
+    const size_t chunk_size = 8;
+    std::vector<game::block_id> back(scale * scale * scale, game::block_id::EMPTY);
+    kernel::terrain_base base(scale, chunk_size, 0, scale / 2, 1);
+    base.generate(pool, back);
+    kernel::terrain_height height(scale, chunk_size, scale / 2, scale - 1, 1);
+    height.generate(pool, back);
+    game::chunk_store store(scale, chunk_size);
+    store.load(pool, back);
+    pool.kill();
+
+    // Mesh every chunk in the world like loading with a large view
+    const size_t chunk_scale = scale / chunk_size;
+    const size_t chunks = chunk_scale * chunk_scale * chunk_scale;
+    const float world_min = -static_cast<float>(scale / 2);
+    std::vector<size_t> keys(chunks);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::vector<min::mesh<float, uint32_t>> meshes(chunks, min::mesh<float, uint32_t>("chunk"));
+    const auto origin = [chunk_scale, chunk_size, world_min](const size_t key) -> min::vec3<float> {
+        const size_t cx = key / (chunk_scale * chunk_scale);
+        const size_t cy = (key / chunk_scale) % chunk_scale;
+        const size_t cz = key % chunk_scale;
+        return min::vec3<float>(cx * chunk_size, cy * chunk_size, cz * chunk_size) + world_min;
+    };
+
+    // Per chunk fan out, each chunk wakes the shared pool for its face loop
+    {
+        game::terrain_mesher mesher(chunk_size);
+        std::vector<game::block_id> padded;
+        bench_timer timer;
+        for (const size_t key : keys)
+        {
+            meshes[key].clear();
+            mesher.clear();
+            mesher.set_origin(origin(key));
+            store.copy_apron(key, padded, game::block_id::INVALID);
+            mesher.generate_chunk_padded(padded);
+            mesher.generate_chunk(meshes[key]);
+        }
+        const double ms = timer.elapsed_ms();
+        std::cout << "    per chunk fan out  : " << ms << " ms, "
+                  << chunks / ms << " chunks/ms" << std::endl;
+    }
+
+    // Chunk parallel batches, one mesher per worker
+    double serial_ms = 0.0;
+    for (const size_t threads : {1, 2, 4, 8, 16})
+    {
+        min::thread_pool batch_pool(threads);
+        game::mesh_batch batch(chunk_size, threads, false);
+        bench_timer timer;
+        batch.generate(batch_pool, store, keys, meshes, origin);
+        const double ms = timer.elapsed_ms();
+        batch_pool.kill();
+
+        // Speedup relative to one thread
+        if (threads == 1)
+        {
+            serial_ms = ms;
+        }
+        std::cout << "    batch " << threads << " threads" << (threads < 10 ? " " : "")
+                  << "   : " << ms << " ms, " << chunks / ms << " chunks/ms, speedup "
+                  << serial_ms / ms << "x" << std::endl;
+    }
+}
+
+#endif
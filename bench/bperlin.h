@@ -0,0 +1,157 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_PERLIN_BDS_
+#define _BDS_BENCH_PERLIN_BDS_
+
+#include <algorithm>
+#include <bench.h>
+#include <cmath>
+#include <game/chunk_noise.h>
+#include <game/fractal_noise.h>
+#include <game/perlin.h>
+#include <string>
+#include <vector>
+
+void bench_perlin()
+{
+    bench_header("perlin noise samples");
+
+    // Base section of a normal world at -grid 64, 8 samples per lattice cell
+    const size_t scale = 128;
+    const size_t chunk_size = 8;
+    const size_t nx = scale;
+    const size_t ny = scale / 2;
+    const size_t nz = scale;
+    const float inv_cs = 1.0 / chunk_size;
+    std::vector<float> coord(scale);
+    for (size_t i = 0; i < scale; i++)
+    {
+        coord[i] = i * inv_cs;
+    }
+    const double samples = static_cast<double>(nx * ny * nz);
+    kernel::perlin_noise noise(1);
+
+    // One sample at a time
+    std::vector<float> scalar(nx * ny * nz);
+    bench_timer timer;
+    for (size_t i = 0, c = 0; i < nx; i++)
+    {
+        for (size_t j = 0; j < ny; j++)
+        {
+            for (size_t k = 0; k < nz; k++, c++)
+            {
+                scalar[c] = noise.perlin(coord[i], coord[j], coord[k]);
+            }
+        }
+    }
+    const double scalar_ms = timer.elapsed_ms();
+    std::cout << "    perlin             : " << scalar_ms << " ms, " << samples / (scalar_ms * 1000.0) << " M samples/s" << std::endl;
+
+    // Bricks with the baseline and the best supported instruction set
+    std::vector<float> batch(nx * ny * nz);
+    const kernel::simd_level levels[] = {kernel::simd_level::scalar, kernel::simd_support()};
+    const char *const names[] = {"base  ", (levels[1] == kernel::simd_level::avx512) ? "avx512" : (levels[1] == kernel::simd_level::avx2) ? "avx2  " : "base  "};
+    for (size_t l = 0; l < 2; l++)
+    {
+        const kernel::simd_level level = levels[l];
+        noise.set_simd(level);
+        timer.reset();
+        noise.perlin_brick(coord.data(), nx, coord.data(), ny, coord.data(), nz, batch.data());
+        const double ms = timer.elapsed_ms();
+
+        // Largest difference to the scalar samples
+        float error = 0.0;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            error = std::max(error, std::abs(batch[i] - scalar[i]));
+        }
+
+        std::cout << "    perlin_brick " << names[l] << ": "
+                  << ms << " ms, " << samples / (ms * 1000.0) << " M samples/s, speedup "
+                  << scalar_ms / ms << "x, max error " << error << std::endl;
+    }
+}
+
+void bench_fractal_chunks(const std::string &name, const kernel::fractal_noise &noise)
+{
+    // Sample every chunk of the base section of a normal world at -grid 64
+    const size_t scale = 128;
+    const size_t chunk_size = 8;
+    kernel::chunk_noise cache(chunk_size);
+    const size_t layer = cache.add(noise);
+    double sum = 0.0;
+    bench_timer timer;
+    for (size_t x = 0; x < scale; x += chunk_size)
+    {
+        for (size_t y = 0; y < scale / 2; y += chunk_size)
+        {
+            for (size_t z = 0; z < scale; z += chunk_size)
+            {
+                cache.set_chunk(min::tri<size_t>(x, y, z));
+                sum += cache.get(layer)[0];
+            }
+        }
+    }
+    const double ms = timer.elapsed_ms();
+
+    // Throughput per sample and cost per octave
+    const double samples = static_cast<double>(scale * scale * (scale / 2));
+    const size_t octaves = noise.get_octaves();
+    std::cout << "    " << name << " octaves " << octaves << ": " << ms << " ms, "
+              << samples / (ms * 1000.0) << " M samples/s, "
+              << (ms * 1E6) / (samples * octaves) << " ns per sample octave"
+              << ((sum < 0.0) ? " " : "") << std::endl;
+}
+
+void bench_fractal()
+{
+    bench_header("fractal noise per octave count");
+
+    // Terrain lattice frequency
+    const float frequency = 1.0 / 8;
+    for (size_t octaves = 1; octaves <= 6; octaves++)
+    {
+        bench_fractal_chunks("fbm   ", kernel::fractal_noise(1, frequency, kernel::fractal_type::fbm, octaves));
+    }
+    for (size_t octaves = 1; octaves <= 6; octaves++)
+    {
+        bench_fractal_chunks("ridged", kernel::fractal_noise(1, frequency, kernel::fractal_type::ridged, octaves));
+    }
+    for (size_t octaves = 1; octaves <= 6; octaves++)
+    {
+        bench_fractal_chunks("warped", kernel::fractal_noise(1, frequency, kernel::fractal_type::fbm, octaves, 2.0, 0.5, 2.0));
+    }
+
+    // Layers reading a field already sampled for the chunk share it
+    kernel::chunk_noise cache(8);
+    const size_t layer = cache.add(kernel::fractal_noise(1, frequency, kernel::fractal_type::fbm, 4));
+    cache.set_chunk(min::tri<size_t>(0, 0, 0));
+    bench_timer timer;
+    const float *field = cache.get(layer);
+    const double miss_us = timer.elapsed_ms() * 1000.0;
+    timer.reset();
+    for (size_t i = 0; i < 1000; i++)
+    {
+        field = cache.get(layer);
+    }
+    const double hit_us = timer.elapsed_ms();
+    std::cout << "    chunk_noise 4 octaves: first read " << miss_us << " us, shared read " << hit_us << " us"
+              << ((field[0] < 0.0) ? " " : "") << std::endl;
+}
+
+#endif
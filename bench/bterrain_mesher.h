@@ -0,0 +1,169 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_TERRAIN_MESHER_BDS_
+#define _BDS_BENCH_TERRAIN_MESHER_BDS_
+
+#include <algorithm>
+#include <bench.h>
+#include <cstring>
+#include <game/geometry.h>
+#include <game/terrain_mesher.h>
+#include <kernel/mandelbulb_sym.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_creative.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <string>
+#include <vector>
+
+void bench_terrain_mesher_mode(const std::vector<game::block_id> &grid, const size_t scale, const size_t chunk_size, const bool greedy)
+{
+    const size_t chunk_scale = scale / chunk_size;
+    const float world_min = -static_cast<float>(scale / 2);
+    const size_t edge = scale - 1;
+    const auto edges = min::tri<size_t>(edge, edge, edge);
+
+    // Function to retrieve block value from the dense grid
+    const auto get_block = [&grid, scale](const min::tri<size_t> &index) -> game::block_id {
+        return grid[(index.x() * scale + index.y()) * scale + index.z()];
+    };
+
+    // Mesh every chunk on this thread
+    game::terrain_mesher mesher(chunk_size);
+    mesher.set_greedy(greedy);
+    min::mesh<float, uint32_t> mesh("chunk");
+    std::vector<float> upload;
+    size_t vertices = 0;
+    size_t mesh_bytes = 0;
+    size_t meshed = 0;
+    bench_timer timer;
+    for (size_t cx = 0; cx < chunk_scale; cx++)
+    {
+        for (size_t cy = 0; cy < chunk_scale; cy++)
+        {
+            for (size_t cz = 0; cz < chunk_scale; cz++)
+            {
+                // Clear the mesh and mesher
+                const size_t xs = cx * chunk_size;
+                const size_t ys = cy * chunk_size;
+                const size_t zs = cz * chunk_size;
+                mesh.clear();
+                mesher.clear();
+                mesher.set_origin(min::vec3<float>(xs, ys, zs) + world_min);
+
+                // Generate cell faces for this chunk
+                for (size_t x = xs; x < xs + chunk_size; x++)
+                {
+                    for (size_t y = ys; y < ys + chunk_size; y++)
+                    {
+                        for (size_t z = zs; z < zs + chunk_size; z++)
+                        {
+                            const auto index = min::tri<size_t>(x, y, z);
+                            const game::block_id atlas = get_block(index);
+                            if (atlas != game::block_id::EMPTY)
+                            {
+                                const min::vec3<float> p = min::vec3<float>(x, y, z) + world_min + 0.5;
+                                mesher.generate_chunk_faces(p, index, edges, get_block, static_cast<float>(atlas));
+                            }
+                        }
+                    }
+                }
+
+                // Build the vertex buffers
+                mesher.generate_chunk_serial(mesh);
+                const size_t size = mesh.vertex.size();
+                vertices += size;
+                meshed += (size > 0);
+                mesh_bytes += size * sizeof(min::vec4<float>);
+
+                // Pack the vertices into the upload buffer like terrain_vertex::copy
+                upload.resize(size);
+                for (size_t i = 0; i < size; i++)
+                {
+                    const uint32_t packed = game::face_pack(mesh.vertex[i]);
+                    std::memcpy(&upload[i], &packed, sizeof(uint32_t));
+                }
+            }
+        }
+    }
+    const double ms = timer.elapsed_ms();
+    const size_t chunks = chunk_scale * chunk_scale * chunk_scale;
+
+    // Unpacked vertices were vec4 position, vec2 uv and vec3 normal
+    const double per_chunk = static_cast<double>(vertices) / std::max(meshed, size_t(1));
+    const size_t unpacked_bytes = sizeof(float) * 9;
+    std::cout << "    " << (greedy ? "greedy  " : "per-face")
+              << ": vertices " << vertices
+              << ", " << per_chunk << " per non-empty chunk"
+              << ", " << (1000.0 * ms) / chunks << " us/chunk" << std::endl;
+    std::cout << "              upload " << per_chunk * sizeof(uint32_t) << " bytes/chunk"
+              << " (unpacked " << per_chunk * unpacked_bytes << ")"
+              << ", cpu mesh " << static_cast<double>(mesh_bytes) / std::max(meshed, size_t(1)) << " bytes/chunk"
+              << " (unpacked " << per_chunk * unpacked_bytes << ")" << std::endl;
+}
+
+void bench_terrain_mesher_world(const std::string &name, const std::vector<game::block_id> &grid, const size_t scale, const size_t chunk_size)
+{
+    // Compare both meshing modes on the same world
+    std::cout << name << ":" << std::endl;
+    bench_terrain_mesher_mode(grid, scale, chunk_size, false);
+    bench_terrain_mesher_mode(grid, scale, chunk_size, true);
+}
+
+void bench_terrain_mesher()
+{
+    bench_header("terrain_mesher per-face vs greedy");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+    pool.seed(1);
+
+    const size_t grid = 64;
+    const size_t scale = grid * 2;
+    const size_t chunk_size = 8;
+    std::vector<game::block_id> back(scale * scale * scale, game::block_id::EMPTY);
+
+    // Creative world
+    kernel::terrain_creative creative(scale, chunk_size, 1);
+    creative.generate(pool, back);
+    bench_terrain_mesher_world("creative", back, scale, chunk_size);
+
+    // Normal world
+    std::fill(back.begin(), back.end(), game::block_id::EMPTY);
+    kernel::terrain_base base(scale, chunk_size, 0, scale / 2, 1);
+    base.generate(pool, back);
+    kernel::terrain_height height(scale, chunk_size, scale / 2, scale - 1, 1);
+    height.generate(pool, back);
+    bench_terrain_mesher_world("normal", back, scale, chunk_size);
+
+    // Portal world from the first man_sym.portal entry
+    std::fill(back.begin(), back.end(), game::block_id::EMPTY);
+    const float world_min = -static_cast<float>(grid);
+    kernel::mandelbulb_sym(1, 10, 30, 5).generate(pool, back, scale, [scale, world_min](const size_t i) {
+        const size_t x = i / (scale * scale);
+        const size_t y = (i / scale) % scale;
+        const size_t z = i % scale;
+        return min::vec3<float>(x, y, z) + world_min + 0.5;
+    });
+    bench_terrain_mesher_world("portal", back, scale, chunk_size);
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
@@ -0,0 +1,117 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_BENCH_WORLD_LOAD_BDS_
+#define _BDS_BENCH_WORLD_LOAD_BDS_
+
+#include <bench.h>
+#include <cstdio>
+#include <game/chunk_file.h>
+#include <game/chunk_store.h>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <string>
+#include <vector>
+
+void bench_world_load_grid(min::thread_pool &pool, const size_t grid)
+{
+    const size_t scale = grid * 2;
+    const size_t chunk_size = 8;
+    const size_t chunk_scale = scale / chunk_size;
+    const size_t chunks = chunk_scale * chunk_scale * chunk_scale;
+    const size_t view = 5;
+    const std::string file_name = "bench_world.tmp";
+
+    // Generate a normal world and save it in the chunk format
+    {
+        std::vector<game::block_id> back(scale * scale * scale, game::block_id::EMPTY);
+        kernel::terrain_base base(scale, chunk_size, 0, scale / 2, 1);
+        base.generate(pool, back);
+        kernel::terrain_height height(scale, chunk_size, scale / 2, scale - 1, 1);
+        height.generate(pool, back);
+
+        game::chunk_store store(scale, chunk_size);
+        store.load(pool, back);
+        std::vector<game::block_id>().swap(back);
+
+        game::chunk_file save(scale, chunk_size, chunks);
+        save.save(file_name, store);
+    }
+    const size_t base_rss = current_rss_kb();
+
+    // Time reading only the chunk index
+    bench_timer timer;
+    game::chunk_store store(scale, chunk_size);
+    game::chunk_file load(scale, chunk_size, chunks);
+    load.load_index(file_name);
+    load.page_chunks(store);
+    const double index_ms = timer.elapsed_ms();
+
+    // Time paging in the view cube around the world center
+    timer.reset();
+    const size_t lo = chunk_scale / 2 - view / 2;
+    for (size_t x = lo; x < lo + view; x++)
+    {
+        for (size_t y = lo; y < lo + view; y++)
+        {
+            for (size_t z = lo; z < lo + view; z++)
+            {
+                store.page((x * chunk_scale * chunk_scale) + (y * chunk_scale) + z);
+            }
+        }
+    }
+    const double view_ms = timer.elapsed_ms();
+    const size_t view_rss = current_rss_kb();
+    const size_t resident = store.resident();
+
+    // Time paging in the whole world, what an eager load would cost
+    timer.reset();
+    store.page_all();
+    const double all_ms = timer.elapsed_ms();
+    const size_t all_rss = current_rss_kb();
+
+    // Clean up the world file
+    std::remove(file_name.c_str());
+
+    std::cout << "grid " << grid << ": chunks " << chunks
+              << ", index " << index_ms << " ms"
+              << ", first view " << view_ms << " ms (" << resident << " chunks resident)"
+              << ", eager page all " << all_ms << " ms" << std::endl;
+    std::cout << "    RSS over base after first view " << view_rss - std::min(view_rss, base_rss) << " KB"
+              << ", after page all " << all_rss - std::min(all_rss, base_rss) << " KB" << std::endl;
+}
+
+void bench_world_load()
+{
+    bench_header("world load latency");
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+    pool.seed(1);
+
+    // Time to first frame for each world size
+    for (const size_t grid : {64, 128, 256})
+    {
+        bench_world_load_grid(pool, grid);
+    }
+
+    // Kill the pool
+    pool.kill();
+}
+
+#endif
@@ -0,0 +1,66 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <bchunk_store.h>
+#include <bchunk_update.h>
+#include <bgrid_search.h>
+#include <bmandelbulb.h>
+#include <bmandelbulb_exp.h>
+#include <bmesh_batch.h>
+#include <bperlin.h>
+#include <bterrain_mesher.h>
+#include <bworld_load.h>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[])
+{
+    try
+    {
+        // 'bench exp [scale]' reports exp approximation differences for every man_exp line
+        if (argc > 1 && std::string(argv[1]) == "exp")
+        {
+            const size_t scale = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 64;
+            bench_mandelbulb_exp(true, scale);
+            return 0;
+        }
+
+        // Run all benchmarks
+        bench_chunk_store();
+        bench_world_load();
+        bench_terrain_mesher();
+        bench_chunk_update();
+        bench_mesh_batch();
+        bench_perlin();
+        bench_fractal();
+        bench_mandelbulb();
+        bench_mandelbulb_exp(false, 16);
+        bench_grid_search();
+
+        std::cout << std::endl
+                  << "Game benchmarks finished!" << std::endl;
+        return 0;
+    }
+    catch (std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+
+    std::cout << "Game benchmarks failed!" << std::endl;
+    return -1;
+}
@@ -206,6 +206,34 @@ bool parse_uint(char *str, size_t &out)
     return false;
 }
 
+uint64_t parse_uint64(const char *flag, const char *str)
+{
+    // Seeds printed by the game use all 64 bits, a sign would silently wrap around
+    const std::string input(str);
+    const size_t start = input.find_first_not_of(" \t");
+    if (start == std::string::npos || input[start] == '-' || input[start] == '+')
+    {
+        throw std::runtime_error(std::string("bds: '") + flag + "' expects an unsigned 64 bit integer, got '" + input + "'");
+    }
+
+    // The whole string must be a number that fits in 64 bits
+    try
+    {
+        size_t end = 0;
+        const unsigned long long value = std::stoull(input, &end, 10);
+        if (end == input.size() && value <= std::numeric_limits<uint64_t>::max())
+        {
+            return static_cast<uint64_t>(value);
+        }
+    }
+    catch (const std::exception &ex)
+    {
+        // Out of range or not a number
+    }
+
+    throw std::runtime_error(std::string("bds: '") + flag + "' expects an unsigned 64 bit integer, got '" + input + "'");
+}
+
 int main(int argc, char *argv[])
 {
     try
@@ -233,6 +261,10 @@ int main(int argc, char *argv[])
             {
                 opt.set_no_persist();
             }
+            else if (input.compare("--greedy") == 0)
+            {
+                opt.set_greedy(true);
+            }
             else if (i < (argc - 1))
             {
                 if (input.compare("-fps") == 0)
@@ -259,6 +291,11 @@ int main(int argc, char *argv[])
                         opt.set_grid(parse);
                     }
                 }
+                else if (input.compare("-seed") == 0)
+                {
+                    // Parse uint64, a bad seed stops the launch instead of picking a random world
+                    opt.set_seed(parse_uint64("-seed", argv[++i]));
+                }
                 else if (input.compare("-view") == 0)
                 {
                     // Parse uint
@@ -19,13 +19,23 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define _BDS_CHUNK_GRID_BDS_
 
 #include <chrono>
+#include <cstdio>
 #include <game/cgrid_generator.h>
+#include <game/chunk_file.h>
+#include <game/chunk_remesher.h>
+#include <game/chunk_store.h>
 #include <game/def.h>
+#include <game/delta_file.h>
 #include <game/file.h>
+#include <game/flow_field.h>
 #include <game/id.h>
+#include <game/mesh_batch.h>
 #include <game/options.h>
+#include <game/path_queue.h>
+#include <game/path_snapshot.h>
 #include <game/swatch.h>
 #include <game/terrain_mesher.h>
+#include <game/work_queue.h>
 #include <min/aabbox.h>
 #include <min/camera.h>
 #include <min/intersect.h>
@@ -72,30 +82,57 @@ class view_chunk
 class cgrid
 {
   private:
-    constexpr static size_t _search_limit = 20;
     const size_t _grid_scale;
-    std::vector<block_id> _grid;
-    std::vector<int_fast8_t> _visit;
-    std::vector<std::pair<size_t, float>> _neighbors;
-    std::vector<size_t> _path;
-    std::vector<size_t> _stack;
+    chunk_store _grid;
     const size_t _chunk_size;
     const size_t _chunk_cells;
     const size_t _chunk_scale;
     std::vector<min::mesh<float, uint32_t>> _chunks;
+    std::vector<bool> _chunk_mesh;
+    std::vector<size_t> _chunk_used;
+    std::vector<size_t> _chunk_version;
+    std::vector<size_t> _mesh_keys;
+    size_t _mesh_frame;
     std::vector<bool> _chunk_update;
     std::vector<size_t> _chunk_update_keys;
+    std::vector<bool> _chunk_save;
+    std::vector<size_t> _chunk_save_keys;
+    std::vector<block_id> _padded;
+    chunk_file _world_file;
+    bool _save_all;
+    delta_file _delta_file;
+    bool _delta;
+    std::vector<size_t> _edit_keys;
+    std::vector<size_t> _sort_edit;
+    size_t _edit_limit;
     std::vector<size_t> _sort_chunk;
     std::vector<view_chunk> _view_chunks;
     size_t _recent_chunk;
     min::vec3<float> _recent_p;
     const size_t _view_chunk_size;
     const size_t _view_half_width;
+    const size_t _mesh_budget;
     const float _view_dist;
     const min::aabbox<float, min::vec3> _world;
     const min::vec3<float> _cell_extent;
     cgrid_generator _generator;
+    world_type _type;
+    uint64_t _seed;
     terrain_mesher _mesher;
+    mesh_batch _batch;
+    std::vector<size_t> _batch_keys;
+    chunk_remesher _remesher;
+    flow_field _flow;
+    const size_t _path_radius;
+    const size_t _path_copies;
+    std::vector<std::shared_ptr<const palette_chunk>> _path_chunks;
+    std::vector<uint64_t> _path_stamps;
+    uint64_t _path_edits;
+    std::shared_ptr<const path_snapshot> _path_world;
+    bool _path_dirty;
+    std::vector<size_t> _path_missing;
+    std::vector<min::vec3<float>> _path_points;
+    path_queue _path_queue;
 
     static inline bool in_x(const min::vec3<float> &p, const min::vec3<float> &min, const min::vec3<float> &max)
     {
@@ -147,16 +184,31 @@ class cgrid
             const size_t key = overlap[i];
 
             // Check if valid and if the cell is not empty
-            if (_grid[key] != block_id::EMPTY)
+            const block_id value = _grid.get(key);
+            if (value != block_id::EMPTY)
             {
                 // Create box at this point
                 const min::aabbox<float, min::vec3> grid = grid_box(grid_cell_center(key));
 
                 // Add box and grid value to
-                out.emplace_back(grid, _grid[key]);
+                out.emplace_back(grid, value);
             }
         }
     }
+    inline void compact_edits()
+    {
+        // Sort edited cell keys using a radix sort
+        min::uint_sort<size_t>(_edit_keys, _sort_edit, [](const size_t i) {
+            return i;
+        });
+
+        // Make keys unique
+        const auto last = std::unique(_edit_keys.begin(), _edit_keys.end());
+        _edit_keys.erase(last, _edit_keys.end());
+
+        // Compact again when the list doubles
+        _edit_limit = std::max(static_cast<size_t>(4096), 2 * _edit_keys.size());
+    }
     template <typename F>
     inline void cubic(const min::vec3<float> &start, const min::tri<unsigned> &length, const min::tri<int> &offset, const F &f) const
     {
@@ -274,6 +326,11 @@ class cgrid
         // Center not guaranteed to be in middle of box!
         return min::vec3<float>(x, y, z);
     }
+    inline min::vec3<float> chunk_origin(const size_t key) const
+    {
+        // Calculate the bottom left corner of the first chunk cell
+        return chunk_start(key) - min::vec3<float>(0.5, 0.5, 0.5);
+    }
     inline min::vec3<float> chunk_start(const size_t key) const
     {
         const min::tri<size_t> index = chunk_key_unpack(key);
@@ -349,68 +406,116 @@ class cgrid
     }
     inline void chunk_update(const size_t chunk_key)
     {
-        // Clear the mesh and mesher
+        // Clear the mesh and mesher, vertices are relative to the chunk origin
         _chunks[chunk_key].clear();
         _mesher.clear();
+        _mesher.set_origin(chunk_origin(chunk_key));
 
-        // Get the last valid cell on each grid dimension
-        const size_t edge = _grid_scale - 1;
-        const auto edges = min::tri<size_t>(edge, edge, edge);
+        // Copy the chunk and its neighbor faces once, cells outside the world never expose faces
+        _grid.copy_apron(chunk_key, _padded, block_id::INVALID);
 
-        // Begin at start position, clamp out of bound to world boundary
-        const min::vec3<float> start = min::vec3<float>(chunk_start(chunk_key)).clamp(_world.get_min(), _world.get_max());
+        // Generate cell faces
+        _mesher.generate_chunk_padded(_padded);
 
-        // Get the grid axis components
-        const auto index = grid_key_unpack(start);
-        const size_t xend = std::min(index.x() + _chunk_size, _grid_scale);
-        const size_t yend = std::min(index.y() + _chunk_size, _grid_scale);
-        const size_t zend = std::min(index.z() + _chunk_size, _grid_scale);
+        // Generate mesh
+        _mesher.generate_chunk(_chunks[chunk_key]);
 
-        // Function to retrieve block value
-        const auto get_block = [this](const min::tri<size_t> &index) -> block_id {
-            return _grid[this->grid_key_pack(index)];
-        };
+        // Track the new mesh
+        chunk_meshed(chunk_key);
+    }
+    inline void chunk_update_batch(const std::vector<size_t> &keys)
+    {
+        // Mesh whole chunks in parallel, each worker owns a mesher
+        work_queue::worker.wake();
+        _batch.generate(work_queue::worker, _grid, keys, _chunks, [this](const size_t key) {
+            return this->chunk_origin(key);
+        });
+        work_queue::worker.sleep();
 
-        // Iterate through the chunk
-        for (size_t tx = index.x(); tx < xend; tx++)
+        // Track the new meshes
+        for (const size_t key : keys)
         {
-            for (size_t ty = index.y(); ty < yend; ty++)
-            {
-                for (size_t tz = index.z(); tz < zend; tz++)
-                {
-                    // Get the cell index
-                    const auto index = min::tri<size_t>(tx, ty, tz);
-
-                    // Get the current cell index value
-                    const block_id atlas = get_block(index);
-                    if (atlas != block_id::EMPTY)
-                    {
-                        // Get the cell center point
-                        const min::vec3<float> p = grid_cell_center(index);
-
-                        // Generate cell faces
-                        _mesher.generate_chunk_faces(p, index, edges, get_block, static_cast<float>(atlas));
-                    }
-                }
-            }
+            chunk_meshed(key);
         }
+    }
+    inline void chunk_meshed(const size_t chunk_key)
+    {
+        // Discard older background meshes of this chunk
+        _chunk_version[chunk_key]++;
 
-        // Generate mesh
-        _mesher.generate_chunk(_chunks[chunk_key]);
+        // Track the chunk mesh for eviction
+        if (!_chunk_mesh[chunk_key])
+        {
+            _chunk_mesh[chunk_key] = true;
+            _mesh_keys.push_back(chunk_key);
+        }
+        _chunk_used[chunk_key] = _mesh_frame;
 
         // Flag that the chunk needs to be updated
         _chunk_update[chunk_key] = true;
     }
-    inline void chunk_warm(const size_t key)
+    inline void chunk_evict()
     {
-#ifdef MGL_GS_RENDER
-        _chunks[key].vertex.reserve(_chunk_cells);
-#else
-        const size_t size6 = _chunk_cells * 6;
-        _chunks[key].vertex.reserve(size6);
-        _chunks[key].uv.reserve(size6);
-        _chunks[key].normal.reserve(size6);
-#endif
+        // Sort meshed chunks from most to least recently viewed
+        std::sort(_mesh_keys.begin(), _mesh_keys.end(), [this](const size_t a, const size_t b) {
+            return _chunk_used[a] > _chunk_used[b];
+        });
+
+        // Evict down to three quarters of the budget, never evict chunks in view
+        const size_t keep = (_mesh_budget * 3) / 4;
+        size_t size = _mesh_keys.size();
+        while (size > keep && _chunk_used[_mesh_keys[size - 1]] != _mesh_frame)
+        {
+            chunk_release(_mesh_keys[--size]);
+        }
+
+        // Shrink the meshed chunk list
+        _mesh_keys.resize(size);
+    }
+    inline void chunk_remesh(const size_t chunk_key)
+    {
+        // Snapshot the chunk and a one cell apron for the background mesher
+        std::vector<block_id> cells;
+        _grid.copy_apron(chunk_key, cells, block_id::INVALID);
+        const min::tri<size_t> start = grid_key_unpack(chunk_start(chunk_key));
+
+        // Visible chunks are meshed first, then by distance from the player
+        const min::vec3<float> d = chunk_center(chunk_key) - _recent_p;
+        const float visible = (_chunk_used[chunk_key] == _mesh_frame) ? 0.0 : 1E12;
+        const float priority = visible + d.dot(d);
+
+        // Queue the chunk for meshing
+        _remesher.push(chunk_key, ++_chunk_version[chunk_key], priority, start, std::move(cells));
+    }
+    inline void chunk_swap_meshes()
+    {
+        // Swap in finished background meshes that are still current
+        _remesher.pop([this](const size_t key, const size_t version, min::mesh<float, uint32_t> &mesh) {
+            if (_chunk_mesh[key] && _chunk_version[key] == version)
+            {
+                std::swap(_chunks[key], mesh);
+                _chunk_update[key] = true;
+            }
+        });
+    }
+    inline void chunk_release(const size_t chunk_key)
+    {
+        // Free the mesh memory, it will be rebuilt if the chunk is viewed again
+        _chunks[chunk_key] = min::mesh<float, uint32_t>("chunk");
+        _chunk_mesh[chunk_key] = false;
+        _chunk_version[chunk_key]++;
+    }
+    inline void chunk_release_all()
+    {
+        // Drop queued background meshes
+        _remesher.clear();
+
+        // Free all chunk meshes
+        for (const auto k : _mesh_keys)
+        {
+            chunk_release(k);
+        }
+        _mesh_keys.clear();
     }
     inline unsigned geometry_add(const min::vec3<float> &start, const min::tri<unsigned> &length,
                                  const min::tri<int> &offset, const block_id atlas_id)
@@ -420,7 +525,7 @@ class cgrid
         // Create cubic function, for each cell in cubic space
         const auto f = [this, &out, atlas_id](const size_t i, const size_t j, const size_t k, const size_t key) {
             // Count changed blocks
-            if (_grid[key] != atlas_id)
+            if (_grid.get(key) != atlas_id)
             {
                 // Increment the out counter
                 out++;
@@ -444,7 +549,7 @@ class cgrid
         const auto f = [this, &out, &sw](const size_t i, const size_t j, const size_t k, const size_t key) {
             // Count changed blocks
             const block_id value = sw.get(i, j, k);
-            if (_grid[key] != value)
+            if (_grid.get(key) != value)
             {
                 // Increment the out counter
                 out++;
@@ -475,10 +580,10 @@ class cgrid
         // Create cubic function, for each cell in cubic space
         const auto f = [this, &out, atlas_id, &set_block_call](const size_t i, const size_t j, const size_t k, const size_t key) {
             // Get the old value
-            const block_id old_value = _grid[key];
+            const block_id old_value = _grid.get(key);
 
             // Count changed blocks
-            if (_grid[key] != atlas_id)
+            if (old_value != atlas_id)
             {
                 // Increment the out counter
                 out++;
@@ -508,37 +613,84 @@ class cgrid
         _chunk_update_keys.push_back(ckey);
 
         // Set the cell with value
-        _grid[key] = value;
+        _grid.set(key, value);
+
+        // Rebuild the flow field if the cell is inside it
+        _flow.edit(grid_key_unpack(key));
+
+        // Path snapshots copy the chunk again, chunk graphs rebuild it on the new stamp
+        _path_chunks[ckey].reset();
+        _path_stamps[ckey] = ++_path_edits;
+        _path_dirty = true;
+
+        // Record the edit if the world is saved as seed and edits
+        if (_delta)
+        {
+            _edit_keys.push_back(key);
+            if (_edit_keys.size() >= _edit_limit)
+            {
+                compact_edits();
+            }
+        }
 
         // Return position
         return p;
     }
     inline void generate_portal()
     {
-        // Function for finding grid key index
-        const auto f = [this](const min::tri<size_t> &index) -> size_t {
-            return grid_key_pack(index);
-        };
-
-        // Function for finding grid center
-        const auto g = [this](const size_t key) -> min::vec3<float> {
-            return grid_cell_center(key);
-        };
+        // Each portal world is seeded from the world before it
+        const uint64_t seed = counter_rng(counter_rng::derive(_seed, seed_stream::next_world), 0).next64();
 
         // Generate the cgrid data
-        _generator.generate_portal(_grid, _grid_scale, _chunk_size, f, g);
+        generate_world(world_type::portal, seed);
     }
     inline void generate_world(const options &opt)
     {
-        const game_type gt = opt.get_game_mode();
-        if (gt == game_type::CREATIVE)
+        // Use the seed option or pick a new seed for every world
+        const uint64_t seed = opt.has_seed() ? opt.seed() : std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+        // Generate the cgrid data
+        const world_type type = (opt.get_game_mode() == game_type::CREATIVE) ? world_type::creative : world_type::normal;
+        generate_world(type, seed);
+    }
+    inline void generate_world(const world_type type, const uint64_t seed)
+    {
+        // Remember how to regenerate this world, it has no edits yet
+        _type = type;
+        _seed = seed;
+        _delta = true;
+        _edit_keys.clear();
+        std::cout << "cgrid: world seed " << _seed << std::endl;
+
+        // The flow field and path snapshots belong to the last world
+        _flow.clear();
+        path_release_all();
+
+        if (type == world_type::portal)
         {
-            _generator.generate_creative(_grid, _grid_scale, _chunk_size);
+            // Function for finding grid key index
+            const auto f = [this](const min::tri<size_t> &index) -> size_t {
+                return grid_key_pack(index);
+            };
+
+            // Function for finding grid center
+            const auto g = [this](const size_t key) -> min::vec3<float> {
+                return grid_cell_center(key);
+            };
+
+            _generator.generate_portal(_grid, _grid_scale, _chunk_size, _seed, f, g);
+        }
+        else if (type == world_type::creative)
+        {
+            _generator.generate_creative(_grid, _grid_scale, _chunk_size, _seed);
         }
         else
         {
-            _generator.generate_normal(_grid, _grid_scale, _chunk_size);
+            _generator.generate_normal(_grid, _grid_scale, _chunk_size, _seed);
         }
+
+        // Every chunk changed so the next save must rewrite the world
+        _save_all = true;
     }
     inline float grid_center_square_dist(const size_t key, const min::vec3<float> &point) const
     {
@@ -571,7 +723,7 @@ class cgrid
             // bad flag signals that we have hit the last valid cell
             bool bad_flag = false;
             unsigned count = 0;
-            while (_grid[key] == block_id::EMPTY && !bad_flag && count < length)
+            while (_grid.get(key) == block_id::EMPTY && !bad_flag && count < length)
             {
                 // Update the previous key
                 prev_key = key;
@@ -582,221 +734,205 @@ class cgrid
             }
 
             // return the stopping cell value
-            value = _grid[key];
+            value = _grid.get(key);
         }
 
         return is_valid;
     }
-    inline void reserve_memory()
-    {
-        _path.reserve(20);
-        _neighbors.reserve(6);
-        _stack.reserve(100);
-        _sort_chunk.reserve(27);
-        _view_chunks.reserve(27);
-    }
-    inline void reset()
-    {
-        // Clear out all vectors
-        _neighbors.clear();
-        _path.clear();
-        _stack.clear();
-        _chunk_update_keys.clear();
-        _sort_chunk.clear();
-        _view_chunks.clear();
-    }
-    inline void search(const min::vec3<float> &start, const min::vec3<float> &stop)
+    inline const std::shared_ptr<const palette_chunk> &path_chunk(const size_t ckey)
     {
-        // Get grid keys
-        bool is_valid = true;
-        const size_t start_key = grid_key_safe(start, is_valid);
-        const size_t stop_key = grid_key_safe(stop, is_valid);
-
-        // If points are not in grid
-        if (!is_valid)
+        // Share a copy of the chunk, chunks are copied again only after edits
+        std::shared_ptr<const palette_chunk> &chunk = _path_chunks[ckey];
+        if (!chunk)
         {
-            return;
+            chunk = std::make_shared<const palette_chunk>(_grid.get_chunk(ckey));
+            _path_dirty = true;
         }
 
-        // Clear the old neighbors
-        _neighbors.clear();
-
-        // Clear the old path
-        _path.clear();
-
-        // Clear the old stack
-        _stack.clear();
-
-        // If the start key is inside terrain
-        if (_grid[start_key] != block_id::EMPTY)
+        return chunk;
+    }
+    inline void path_release_all()
+    {
+        // Forget chunk copies shared with path searches, every chunk graph entry is stale on the new stamp
+        const uint64_t stamp = ++_path_edits;
+        for (auto &c : _path_chunks)
         {
-            return;
+            c.reset();
         }
-
-        // Reset the visited flag
-        std::fill(_visit.begin(), _visit.end(), -1);
-
-        // If we need to search
-        if (start_key != stop_key)
+        std::fill(_path_stamps.begin(), _path_stamps.end(), stamp);
+        _path_world.reset();
+        _path_dirty = false;
+    }
+    inline path_snapshot path_snapshot_box(const size_t start_key)
+    {
+        // Chunks within reach of a path horizon around the start
+        const min::tri<size_t> start = grid_key_unpack(start_key);
+        const size_t r = _path_radius;
+        const size_t last = _grid_scale - 1;
+        const min::tri<size_t> lower((start.x() - std::min(start.x(), r)) / _chunk_size,
+                                     (start.y() - std::min(start.y(), r)) / _chunk_size,
+                                     (start.z() - std::min(start.z(), r)) / _chunk_size);
+        const min::tri<size_t> upper(std::min(start.x() + r, last) / _chunk_size + 1,
+                                     std::min(start.y() + r, last) / _chunk_size + 1,
+                                     std::min(start.z() + r, last) / _chunk_size + 1);
+
+        // Share a copy of each chunk
+        path_snapshot out(_grid_scale, _chunk_size, lower, upper);
+        const size_t cs = _chunk_scale;
+        for (size_t x = lower.x(); x < upper.x(); x++)
         {
-            // Push the start_key on the stack
-            _stack.push_back(start_key);
-
-            // Flag that we pushed this key
-            _visit[start_key] = 1;
-
-            // Iteratively Search for a path
-            while (!_stack.empty())
+            for (size_t y = lower.y(); y < upper.y(); y++)
             {
-                const bool found = search_next(stop, stop_key);
-                if (found)
+                for (size_t z = lower.z(); z < upper.z(); z++)
                 {
-                    break;
+                    const size_t ckey = (x * cs * cs) + (y * cs) + z;
+                    out.push_back(path_chunk(ckey), _path_stamps[ckey]);
                 }
             }
         }
+
+        return out;
     }
-    inline void search_neighbors(const min::tri<size_t> &index, const min::vec3<float> &stop)
+    inline const std::shared_ptr<const path_snapshot> &path_world()
     {
-        // Clear neighbors buffer
-        _neighbors.clear();
-
-        // Unpack start_key to components
-        const size_t x = index.x();
-        const size_t y = index.y();
-        const size_t z = index.z();
-
-        // Check against lower x grid dimensions
-        const size_t edge = _grid_scale - 1;
-        if (x != 0)
+        // Share every chunk copied so far with the chunk graphs, chunks not copied yet are reported by the routes
+        if (!_path_world)
         {
-            const size_t nxk = min::vec3<float>::grid_key(min::tri<size_t>(x - 1, y, z), _grid_scale);
-            _neighbors.push_back({nxk, grid_center_square_dist(nxk, stop)});
+            const size_t cs = _chunk_scale;
+            path_snapshot out(_grid_scale, _chunk_size, min::tri<size_t>(0, 0, 0), min::tri<size_t>(cs, cs, cs));
+            const size_t size = _path_chunks.size();
+            for (size_t i = 0; i < size; i++)
+            {
+                out.push_back(_path_chunks[i], _path_stamps[i]);
+            }
+            _path_world = std::make_shared<const path_snapshot>(std::move(out));
         }
 
-        // Check against upper x grid dimensions
-        if (x != edge)
-        {
-            const size_t pxk = min::vec3<float>::grid_key(min::tri<size_t>(x + 1, y, z), _grid_scale);
-            _neighbors.push_back({pxk, grid_center_square_dist(pxk, stop)});
-        }
+        return _path_world;
+    }
+    inline void reserve_memory()
+    {
+        _sort_chunk.reserve(27);
+        _view_chunks.reserve(27);
+    }
+    inline void reset()
+    {
+        // Clear out all vectors
+        _flow.clear();
+        _path_queue.clear();
+        path_release_all();
+        _chunk_update_keys.clear();
+        std::fill(_chunk_save.begin(), _chunk_save.end(), false);
+        _chunk_save_keys.clear();
+        _edit_keys.clear();
+        _sort_chunk.clear();
+        _view_chunks.clear();
+    }
+    inline void world_create(const options &opt)
+    {
+        // Else generate world
+        generate_world(opt);
 
-        // Check against lower y grid dimensions
-        if (y != 0)
-        {
-            const size_t nyk = min::vec3<float>::grid_key(min::tri<size_t>(x, y - 1, z), _grid_scale);
-            _neighbors.push_back({nyk, grid_center_square_dist(nyk, stop)});
-        }
+        // Chunks are meshed when they enter the view
+        chunk_release_all();
+    }
+    inline void world_load(const options &opt)
+    {
+        const std::string file_name = file::get_world_file(opt.get_save_slot());
 
-        // Check against upper y grid dimensions
-        if (y != edge)
+        // Load a world saved as seed and edits
+        if (delta_file::is_delta_file(file_name))
         {
-            const size_t pyk = min::vec3<float>::grid_key(min::tri<size_t>(x, y + 1, z), _grid_scale);
-            _neighbors.push_back({pyk, grid_center_square_dist(pyk, stop)});
+            world_load_delta(opt, file_name);
         }
-
-        // Check against lower z grid dimensions
-        if (z != 0)
+        else if (chunk_file::is_chunk_file(file_name))
         {
-            const size_t nzk = min::vec3<float>::grid_key(min::tri<size_t>(x, y, z - 1), _grid_scale);
-            _neighbors.push_back({nzk, grid_center_square_dist(nzk, stop)});
+            // Read the chunk index only
+            if (_world_file.load_index(file_name))
+            {
+                // Chunks are paged in as they are used
+                _world_file.page_chunks(_grid);
+                _save_all = false;
+                _delta = false;
+            }
+            else
+            {
+                // Grid is wrong dimensions so regenerate world
+                generate_world(opt);
+            }
         }
-
-        // Check against upper z grid dimensions
-        if (z != edge)
+        else
         {
-            const size_t pzk = min::vec3<float>::grid_key(min::tri<size_t>(x, y, z + 1), _grid_scale);
-            _neighbors.push_back({pzk, grid_center_square_dist(pzk, stop)});
+            world_load_legacy(opt, file_name);
         }
 
-        // lambda function to create sorted array indices based on distance
-        std::sort(_neighbors.begin(), _neighbors.end(), [](const std::pair<size_t, float> &a, const std::pair<size_t, float> &b) {
-            return a.second > b.second;
-        });
+        // Chunks are meshed when they enter the view
+        chunk_release_all();
     }
-    inline bool search_next(const min::vec3<float> &stop, const size_t stop_key)
+    inline void world_load_delta(const options &opt, const std::string &file_name)
     {
-        // Check if stack is empty to avoid stomping the stack
-        if (_stack.size() == 0)
-        {
-            return true;
-        }
-        else if (_path.size() > _search_limit)
-        {
-            return true;
-        }
-
-        // Get element on top of stack
-        const size_t key = _stack.back();
-
-        // Check if we made it to the mother lands!
-        if (key == stop_key)
+        // Read the seed and edits
+        if (!_delta_file.load(file_name))
         {
-            // Store end point of path
-            _path.push_back(key);
-
-            // Stop searching
-            return true;
-        }
-        else if (_visit[key] == 1)
-        {
-            // If we haven't seen this node yet, we are traversing
-            _path.push_back(key);
-
-            // Visit this node
-            _visit[key] = 0;
-
-            // Search along the gradient until we hit a wall
-            const min::tri<size_t> index = grid_key_unpack(key);
-
-            // Search all neighboring cells
-            search_neighbors(index, stop);
-
-            for (const auto &n : _neighbors)
+            // Keep worlds from another generator aside, the next save would overwrite them
+            if (_delta_file.is_stale())
             {
-                // If we haven't visited the neighbor cell, and it isn't a wall
-                if (_visit[n.first] == -1 && _grid[n.first] == block_id::EMPTY)
+                // Number the stale file past any kept earlier, rename silently replaces an existing file
+                std::string stale_name = file_name + ".stale";
+                for (size_t i = 1; file::exists_file(stale_name); i++)
                 {
-                    // Flag that we pushed this key to prevent duplicates on stack
-                    _visit[n.first] = 1;
-
-                    // Calculate distance to destination
-                    _stack.push_back(n.first);
+                    stale_name = file_name + ".stale." + std::to_string(i);
+                }
+                if (std::rename(file_name.c_str(), stale_name.c_str()) == 0)
+                {
+                    std::cout << "cgrid: kept world file as '" << stale_name << "'" << std::endl;
+                }
+                else
+                {
+                    std::cout << "cgrid: could not keep world file as '" << stale_name << "'" << std::endl;
                 }
             }
-        }
-        else if (_visit[key] == 0)
-        {
-            // If we already visited this node, we must be unwinding so pop stack
-            _stack.pop_back();
 
-            // Every time we visit we push so we must pop here
-            _path.pop_back();
+            // Grid is wrong dimensions or generator changed so regenerate world
+            generate_world(opt);
+            return;
         }
 
-        // Keepp looking for a path
-        return false;
-    }
-    inline void world_create(const options &opt)
-    {
-        // Else generate world
-        generate_world(opt);
+        // Regenerate the world from its seed
+        generate_world(_delta_file.get_type(), _delta_file.get_seed());
 
-        // Reserve and update all chunks
-        const size_t chunks = _chunks.size();
-        for (size_t i = 0; i < chunks; i++)
+        // Replay the edits, they are still edits for the next save
+        const std::vector<size_t> &keys = _delta_file.get_keys();
+        const std::vector<block_id> &ids = _delta_file.get_ids();
+        const size_t size = keys.size();
+        for (size_t i = 0; i < size; i++)
         {
-            chunk_warm(i);
-            chunk_update(i);
+            _grid.set(keys[i], ids[i]);
+        }
+        _edit_keys = keys;
+        _edit_limit = std::max(static_cast<size_t>(4096), 2 * size);
+
+        // Shrink the palettes of edited chunks, the rest are generated when first used
+        std::vector<size_t> chunk_keys;
+        chunk_keys.reserve(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            chunk_keys.push_back(chunk_key_unsafe(grid_cell_center(keys[i])));
+        }
+        std::sort(chunk_keys.begin(), chunk_keys.end());
+        const auto last = std::unique(chunk_keys.begin(), chunk_keys.end());
+        for (auto i = chunk_keys.begin(); i != last; i++)
+        {
+            _grid.compact(*i);
         }
     }
-    inline void world_load(const options &opt)
+    inline void world_load_legacy(const options &opt, const std::string &file_name)
     {
         // Create output stream for loading world
         std::vector<uint8_t> stream;
 
         // Load data into stream from file
-        file::load_file(file::get_world_file(opt.get_save_slot()), stream);
+        file::load_file(file_name, stream);
 
         // If load failed dont try to parse stream data
         if (stream.size() != 0)
@@ -806,11 +942,15 @@ class cgrid
             const std::vector<block_id> grid = min::read_le_vector<block_id>(stream, next);
 
             // Check that grid load correctly
-            const size_t cubic_size = _grid_scale * _grid_scale * _grid_scale;
-            if (grid.size() == cubic_size)
+            if (grid.size() == _grid.size())
             {
-                // Copy grid from file
-                _grid = grid;
+                // Compress grid from file into chunks
+                _grid.load(work_queue::worker, grid);
+
+                // Migrate the flat world file to the chunked format
+                _world_file.save(file_name, _grid);
+                _save_all = false;
+                _delta = false;
             }
             else
             {
@@ -823,14 +963,6 @@ class cgrid
             // No file found
             generate_world(opt);
         }
-
-        // Reserve and update all chunks
-        const size_t chunks = _chunks.size();
-        for (size_t i = 0; i < chunks; i++)
-        {
-            chunk_warm(i);
-            chunk_update(i);
-        }
     }
 
   public:
@@ -839,26 +971,51 @@ class cgrid
     constexpr static float _player_dz = 0.45;
     cgrid(const options &opt)
         : _grid_scale(opt.grid() * 2),
-          _grid(_grid_scale * _grid_scale * _grid_scale, block_id::EMPTY),
-          _visit(_grid.size(), -1),
+          _grid(_grid_scale, opt.chunk()),
           _chunk_size(opt.chunk()),
           _chunk_cells(_chunk_size * _chunk_size * _chunk_size),
           _chunk_scale(_grid_scale / _chunk_size),
           _chunks(_chunk_scale * _chunk_scale * _chunk_scale, min::mesh<float, uint32_t>("chunk")),
+          _chunk_mesh(_chunks.size(), false),
+          _chunk_used(_chunks.size(), 0),
+          _chunk_version(_chunks.size(), 0),
+          _mesh_frame(0),
           _chunk_update(_chunks.size(), true),
+          _chunk_save(_chunks.size(), false),
+          _world_file(_grid_scale, _chunk_size, _chunks.size()),
+          _save_all(true),
+          _delta_file(_grid_scale, _chunk_size, cgrid_generator::_version),
+          _delta(false),
+          _edit_limit(4096),
           _recent_chunk(0),
           _view_chunk_size(opt.view()),
           _view_half_width(_view_chunk_size / 2),
+          _mesh_budget(2 * _view_chunk_size * _view_chunk_size * _view_chunk_size),
           _view_dist(calculate_view_distance()),
           _world(calculate_world_size(opt.grid())),
           _cell_extent(1.0, 1.0, 1.0),
-          _generator(_grid), _mesher(_chunk_size)
+          _generator(), _type(world_type::normal), _seed(0), _mesher(_chunk_size),
+          _batch(_chunk_size, opt.greedy()),
+          _remesher(_chunk_size, _world.get_min(), 1, opt.greedy()),
+          _flow(_grid_scale, 32),
+          _path_radius(20),
+          _path_copies(64),
+          _path_chunks(_chunks.size()),
+          _path_stamps(_chunks.size(), 0),
+          _path_edits(0),
+          _path_dirty(false),
+          _path_queue(_grid_scale, _chunk_size, _path_radius, 1)
     {
         // Check chunk size
         if (_grid_scale % _chunk_size != 0)
         {
             throw std::runtime_error("cgrid: chunk_size must evenly divide grid_scale");
         }
+        else if (_chunk_size > 127)
+        {
+            // Packed terrain vertices store 7 bits per axis
+            throw std::runtime_error("cgrid: chunk_size can't be greater than 127");
+        }
 
         // Check view size
         if (_view_chunk_size % 2 == 0 || _view_chunk_size == 1)
@@ -872,6 +1029,9 @@ class cgrid
             throw std::runtime_error("cgrid: view_chunk_size can't be greater than " + std::to_string(_chunk_scale * 2 + 1));
         }
 
+        // Select the chunk meshing mode
+        _mesher.set_greedy(opt.greedy());
+
         // Reserve memory
         reserve_memory();
     }
@@ -893,17 +1053,45 @@ class cgrid
     }
     inline void save(const options &opt)
     {
-        // Create output stream for saving world
-        std::vector<uint8_t> stream;
+        const std::string file_name = file::get_world_file(opt.get_save_slot());
 
-        // Reserve space for grid
-        stream.reserve(_grid.size() * sizeof(block_id));
+        // Flush edits that have not been remeshed yet
+        flush_chunk_updates();
 
-        // Write data into stream
-        min::write_le_vector<block_id>(stream, _grid);
+        // Generated worlds only store their seed and edits
+        if (_delta)
+        {
+            // Release the mapped world file before overwriting it
+            _world_file.close();
+            compact_edits();
+            _delta_file.save(file_name, _type, _seed, _grid, _edit_keys);
 
-        // Write data to file
-        file::save_file(file::get_world_file(opt.get_save_slot()), stream);
+            // A chunk file save must rewrite the whole world
+            _save_all = true;
+        }
+        else if (_save_all)
+        {
+            // Rewrite the whole world
+            _world_file.save(file_name, _grid);
+            _save_all = false;
+        }
+        else
+        {
+            // Sort chunk keys so records are written in file order
+            min::uint_sort<size_t>(_chunk_save_keys, _sort_chunk, [](const size_t i) {
+                return i;
+            });
+
+            // Write only the dirty chunks
+            _world_file.save(file_name, _grid, _chunk_save_keys);
+        }
+
+        // Clear out the dirty chunks
+        for (const auto k : _chunk_save_keys)
+        {
+            _chunk_save[k] = false;
+        }
+        _chunk_save_keys.clear();
     }
     static inline min::aabbox<float, min::vec3> grid_box(const min::vec3<float> &p)
     {
@@ -1065,11 +1253,28 @@ class cgrid
         // Update all modified chunks
         for (const auto k : _chunk_update_keys)
         {
-            chunk_update(k);
+            // Shrink the chunk palette after edits
+            _grid.compact(k);
+
+            // Mark the chunk for the next save
+            if (!_chunk_save[k])
+            {
+                _chunk_save[k] = true;
+                _chunk_save_keys.push_back(k);
+            }
+
+            // Remesh the chunk in the background if it has a mesh, else wait until it is viewed
+            if (_chunk_mesh[k])
+            {
+                chunk_remesh(k);
+            }
         }
 
         // Clear out chunk update keys
         _chunk_update_keys.clear();
+
+        // Collect chunks meshed in the background
+        chunk_swap_meshes();
     }
     inline min::tri<size_t> get_grid_index_unsafe(const min::vec3<float> &p) const
     {
@@ -1093,7 +1298,7 @@ class cgrid
     }
     inline block_id get_block_id(const size_t key) const
     {
-        return _grid[key];
+        return _grid.get(key);
     }
     inline void set_block_id(const size_t key, const block_id value)
     {
@@ -1103,6 +1308,10 @@ class cgrid
     {
         return _chunks[key];
     }
+    inline min::vec3<float> get_chunk_origin(const size_t key) const
+    {
+        return chunk_origin(key);
+    }
     inline size_t get_chunks() const
     {
         return _chunks.size();
@@ -1111,6 +1320,14 @@ class cgrid
     {
         return _chunk_scale;
     }
+    inline uint64_t get_seed() const
+    {
+        return _seed;
+    }
+    inline const path_queue &get_path_queue() const
+    {
+        return _path_queue;
+    }
     inline const std::vector<view_chunk> &get_view_chunks() const
     {
         return _view_chunks;
@@ -1150,7 +1367,7 @@ class cgrid
         // Create cubic function, for each cell in cubic space
         const auto f = [this, &sw, &out](const size_t i, const size_t j, const size_t k, const size_t key) {
             // Get the atlas of this grid point
-            const block_id atlas = this->_grid[key];
+            const block_id atlas = this->_grid.get(key);
 
             // Load atlas into swatch
             sw.set(i, j, k, atlas);
@@ -1167,8 +1384,9 @@ class cgrid
     }
     inline void preview_atlas(min::mesh<float, uint32_t> &mesh, const min::tri<int> &offset, const min::tri<unsigned> &length, const block_id atlas) const
     {
-        // Clear the mesher
+        // Clear the mesher, vertices are relative to the preview origin
         _mesher.clear();
+        _mesher.set_origin(terrain_mesher::preview_origin());
 
         // Convert atlas to a float
         const float float_atlas = static_cast<float>(atlas);
@@ -1201,8 +1419,9 @@ class cgrid
     }
     inline void preview_swatch(min::mesh<float, uint32_t> &mesh, const swatch &sw) const
     {
-        // Clear the mesher
+        // Clear the mesher, vertices are relative to the preview origin
         _mesher.clear();
+        _mesher.set_origin(terrain_mesher::preview_origin());
 
         // Calculate max edges
         const min::tri<unsigned> &length = sw.get_length();
@@ -1286,31 +1505,103 @@ class cgrid
         // return ray start point since it is not in the grid
         return r.get_origin();
     }
-    inline void path(std::vector<min::vec3<float>> &out, const min::vec3<float> &start, const min::vec3<float> &stop)
+    inline bool path_flow(std::vector<min::vec3<float>> &out, const min::vec3<float> &start, const min::vec3<float> &stop)
     {
         // Convert keys to points
         out.clear();
 
-        // Try to find a path between points
-        search(start, stop);
+        // Paths to the flow field goal walk down the shared field, one lookup per step
+        bool is_valid = true;
+        const size_t start_key = grid_key_safe(start, is_valid);
+        const size_t stop_key = grid_key_safe(stop, is_valid);
+        if (!is_valid || !_flow.path(_grid, start_key, stop_key))
+        {
+            return false;
+        }
 
         // For all keys in path
-        const size_t size = _path.size();
-        for (size_t i = 0; i < size; i++)
+        for (const size_t key : _flow.get_path())
         {
-            out.push_back(grid_cell_center(_path[i]));
+            out.push_back(grid_cell_center(key));
         }
+
+        return true;
     }
-    inline void portal()
+    inline bool path_request(const size_t id, const size_t ticket, const min::vec3<float> &start, const min::vec3<float> &stop)
     {
-        generate_portal();
+        // Get grid keys
+        bool is_valid = true;
+        const size_t start_key = grid_key_safe(start, is_valid);
+        const size_t stop_key = grid_key_safe(stop, is_valid);
 
-        // Update all chunks
-        const size_t chunks = _chunks.size();
-        for (size_t i = 0; i < chunks; i++)
+        // If points are not in grid
+        if (!is_valid)
         {
-            chunk_update(i);
+            return false;
         }
+
+        // Search on a worker thread against a snapshot of the chunks around the start
+        path_snapshot snapshot = path_snapshot_box(start_key);
+
+        // Goals out of the snapshot are routed on the worker over the chunk graph of the shared world
+        std::shared_ptr<const path_snapshot> world;
+        if (snapshot.clamp(stop_key) != stop_key)
+        {
+            world = path_world();
+        }
+        _path_queue.push(id, ticket, start_key, stop_key, std::move(snapshot), std::move(world));
+
+        return true;
+    }
+    template <typename F>
+    inline void path_results(const F &f)
+    {
+        // Hand finished searches to their paths as points
+        _path_queue.pop([this, &f](const size_t id, const size_t ticket, const std::vector<size_t> &keys) {
+            _path_points.clear();
+            for (const size_t key : keys)
+            {
+                _path_points.push_back(grid_cell_center(key));
+            }
+            f(id, ticket, _path_points);
+        });
+    }
+    inline void path_frame(const min::vec3<float> &goal)
+    {
+        // Copy a few chunks the routes could not see, paging them in is only safe on this thread
+        _path_queue.pop_missing(_path_missing);
+        size_t copies = 0;
+        for (const size_t k : _path_missing)
+        {
+            if (copies < _path_copies && !_path_chunks[k])
+            {
+                path_chunk(k);
+                copies++;
+            }
+        }
+
+        // Routes requested from now on see this frame's edits and copies
+        if (_path_dirty)
+        {
+            _path_world.reset();
+            _path_dirty = false;
+        }
+
+        // Move the flow field goal and continue building the field
+        bool is_valid = true;
+        const size_t goal_key = grid_key_safe(goal, is_valid);
+        if (is_valid)
+        {
+            _flow.set_goal(goal_key);
+            _flow.update(_grid);
+        }
+    }
+    inline void portal()
+    {
+        generate_portal();
+
+        // Chunks are remeshed when they enter the view
+        chunk_release_all();
     }
     inline void set_boundary_chunk(const size_t key)
     {
@@ -1557,9 +1848,35 @@ class cgrid
         });
 
         // Sorted indices based off distance from center of view frustum, ascending order
+        _mesh_frame++;
+        _batch_keys.clear();
         for (const view_chunk &vc : _view_chunks)
         {
-            out.push_back(vc.get_key());
+            const size_t key = vc.get_key();
+            out.push_back(key);
+
+            // Collect chunks viewed for the first time
+            if (!_chunk_mesh[key])
+            {
+                _batch_keys.push_back(key);
+            }
+            _chunk_used[key] = _mesh_frame;
+        }
+
+        // Mesh new chunks, many at once after loading a world or teleporting
+        if (_batch_keys.size() > 1)
+        {
+            chunk_update_batch(_batch_keys);
+        }
+        else if (_batch_keys.size() == 1)
+        {
+            chunk_update(_batch_keys[0]);
+        }
+
+        // Evict the least recently viewed meshes if over budget
+        if (_mesh_keys.size() > _mesh_budget)
+        {
+            chunk_evict();
         }
     }
 };
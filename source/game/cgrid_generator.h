@@ -18,9 +18,12 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_CGRID_GENERATOR_BDS_
 #define _BDS_CGRID_GENERATOR_BDS_
 
-#include <chrono>
+#include <algorithm>
 #include <cmath>
 #include <fstream>
+#include <game/chunk_noise.h>
+#include <game/chunk_store.h>
+#include <game/counter_rng.h>
 #include <game/id.h>
 #include <game/memory_map.h>
 #include <game/work_queue.h>
@@ -48,49 +51,18 @@ class cgrid_generator
     std::vector<std::pair<size_t, size_t>> _exp_lines;
     std::string _sym;
     std::vector<std::pair<size_t, size_t>> _sym_lines;
-    std::vector<block_id> _back;
     std::istringstream _ss;
     std::string _line;
-    std::mt19937 _gen;
 
-    inline void clear_grid(std::vector<block_id> &grid)
-    {
-        // Parallelize on copying buffers
-        const auto work = [&grid](std::mt19937 &gen, const size_t i) {
-            grid[i] = block_id::EMPTY;
-        };
-
-        // Convert cells to mesh in parallel
-        work_queue::worker.run(std::cref(work), 0, grid.size());
-    }
     inline void clear_stream(const std::string &str)
     {
         _ss.clear();
         _ss.str(str);
     }
-    inline size_t count_grid(std::vector<block_id> &grid)
-    {
-        // Out variable
-        size_t count = 0;
-
-        // Count all active cells in grid
-        const size_t size = grid.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            if (grid[i] != block_id::EMPTY)
-            {
-                count++;
-            }
-        }
-
-        // Return count;
-        return count;
-    }
-    inline kernel::mandelbulb_asym load_mandelbulb_asym(std::mt19937 &gen)
+    inline kernel::mandelbulb_asym load_mandelbulb_asym(counter_rng &rng)
     {
-        // Load uniform distribution for sym
-        std::uniform_int_distribution<unsigned> dist(0, _asym_lines.size() - 1);
-        const unsigned index = dist(gen);
+        // Pick a random line
+        const size_t index = rng.uniform(static_cast<size_t>(0), _asym_lines.size() - 1);
 
         // Get the line index and get the line string
         const auto &p = _asym_lines[index];
@@ -112,11 +84,10 @@ class cgrid_generator
         // Load the asymmetrical mandelbulb
         return kernel::mandelbulb_asym(a, b, c, d, e, f, g, h, i, j, k, l);
     }
-    inline kernel::mandelbulb_exp load_mandelbulb_exp(std::mt19937 &gen)
+    inline kernel::mandelbulb_exp load_mandelbulb_exp(counter_rng &rng)
     {
-        // Load uniform distribution for exp
-        std::uniform_int_distribution<unsigned> dist(0, _exp_lines.size() - 1);
-        const unsigned index = dist(gen);
+        // Pick a random line
+        const size_t index = rng.uniform(static_cast<size_t>(0), _exp_lines.size() - 1);
 
         // Get the line index and get the line string
         const auto &p = _exp_lines[index];
@@ -138,11 +109,10 @@ class cgrid_generator
         // Load the exponential mandelbulb
         return kernel::mandelbulb_exp(a, b, c, d);
     }
-    inline kernel::mandelbulb_sym load_mandelbulb_sym(std::mt19937 &gen)
+    inline kernel::mandelbulb_sym load_mandelbulb_sym(counter_rng &rng)
     {
-        // Load uniform distribution for sym
-        std::uniform_int_distribution<unsigned> dist(0, _sym_lines.size() - 1);
-        const unsigned index = dist(gen);
+        // Pick a random line
+        const size_t index = rng.uniform(static_cast<size_t>(0), _sym_lines.size() - 1);
 
         // Get the line index and get the line string
         const auto &p = _sym_lines[index];
@@ -175,105 +145,107 @@ class cgrid_generator
         _sym_lines = min::read_lines(_sym, 1001);
     }
 
+    template <typename F>
+    inline void page_chunks(chunk_store &grid, const size_t scale, const size_t chunk_size, F generate)
+    {
+        // Scratch cells of one chunk, reused for every chunk
+        const size_t chunk_scale = scale / chunk_size;
+        std::vector<block_id> cells(chunk_size * chunk_size * chunk_size);
+
+        // Generate each chunk from its start cell on first access, chunks never touched cost nothing
+        grid.set_pager([generate, chunk_size, chunk_scale, cells](const size_t key, palette_chunk &chunk) mutable {
+            const size_t cx = key / (chunk_scale * chunk_scale);
+            const size_t cy = (key / chunk_scale) % chunk_scale;
+            const size_t cz = key % chunk_scale;
+            const min::tri<size_t> start(cx * chunk_size, cy * chunk_size, cz * chunk_size);
+
+            // Generate the chunk cells
+            std::fill(cells.begin(), cells.end(), block_id::EMPTY);
+            generate(start, cells);
+
+            // Compress the chunk cells
+            chunk.load(cells.size(), [&cells](const size_t cell) -> block_id {
+                return cells[cell];
+            });
+        });
+    }
+
   public:
-    cgrid_generator(const std::vector<block_id> &grid)
-        : _back(grid.size(), block_id::EMPTY),
-          _gen(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+    // Bump when any generator stage changes the world a seed produces, saved seeds replay edits onto it
+    constexpr static uint32_t _version = 2;
+    cgrid_generator()
     {
         // Load the portal strings
         load_portal_strings();
     }
-    inline void copy(std::vector<block_id> &grid) const
+    inline void generate_creative(chunk_store &grid, const size_t scale, const size_t chunk_size, const uint64_t seed)
     {
-        // Parallelize on copying buffers
-        const auto work = [this, &grid](std::mt19937 &gen, const size_t i) {
-            grid[i] = _back[i];
-        };
-
-        // Convert cells to mesh in parallel
-        work_queue::worker.run(std::cref(work), 0, grid.size());
+        // Chunks are generated from the seed when first used
+        const kernel::terrain_creative creative(scale, chunk_size, seed);
+        page_chunks(grid, scale, chunk_size, [creative](const min::tri<size_t> &start, std::vector<block_id> &cells) {
+            creative.generate_chunk(start, cells);
+        });
     }
-    inline void generate_creative(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size)
+    inline void generate_normal(chunk_store &grid, const size_t scale, const size_t chunk_size, const uint64_t seed)
     {
-        // Reseed the generator
-        work_queue::worker.seed(std::chrono::high_resolution_clock::now().time_since_epoch().count());
-
-        // Wake up the threads for processing
-        work_queue::worker.wake();
-
-        // Clear out the old grid
-        clear_grid(_back);
-
-        // Calculates perlin noise
-        kernel::terrain_creative creative(scale);
-        creative.generate(work_queue::worker, _back);
-
-        // Copy data from back to front buffer
-        copy(grid);
-
-        // Put the threads back to sleep
-        work_queue::worker.sleep();
-    }
-    inline void generate_normal(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size)
-    {
-        // Reseed the generator
-        work_queue::worker.seed(std::chrono::high_resolution_clock::now().time_since_epoch().count());
-
-        // Wake up the threads for processing
-        work_queue::worker.wake();
-
-        // Clear out the old grid
-        clear_grid(_back);
-
-        // Calculates perlin noise
-        kernel::terrain_base base(scale, chunk_size, 0, scale / 2);
-        base.generate(work_queue::worker, _back);
-
-        // Calculates a height map
-        kernel::terrain_height height(scale, scale / 2, scale - 1);
-        height.generate(work_queue::worker, _gen, _back);
-
-        // Copy data from back to front buffer
-        copy(grid);
-
-        // Put the threads back to sleep
-        work_queue::worker.sleep();
+        // Height map, trees and plants are indexed by chunk column once per world
+        const kernel::terrain_base base(scale, chunk_size, 0, scale / 2, seed);
+        const kernel::terrain_height height(scale, chunk_size, scale / 2, scale - 1, seed);
+
+        // Noise layers are sampled once per chunk and shared by the terrain layers
+        kernel::chunk_noise noise(chunk_size);
+        const size_t ore = noise.add(base.get_noise());
+
+        // Chunks are generated from the seed when first used
+        page_chunks(grid, scale, chunk_size, [base, height, noise, ore](const min::tri<size_t> &start, std::vector<block_id> &cells) mutable {
+            noise.set_chunk(start);
+            base.generate_chunk(start, cells, noise, ore);
+            height.generate_chunk(start, cells);
+        });
     }
     template <typename F, typename G>
-    inline void generate_portal(std::vector<block_id> &grid, const size_t scale, const size_t chunk_size,
+    inline void generate_portal(chunk_store &grid, const size_t scale, const size_t chunk_size, const uint64_t seed,
                                 const F &grid_key_unpack, const G &grid_cell_center)
     {
         // Reseed the generator
-        work_queue::worker.seed(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        work_queue::worker.seed(seed);
+        counter_rng rng(counter_rng::derive(seed, seed_stream::portal), 0);
 
         // Wake up the threads for processing
         work_queue::worker.wake();
 
-        // Clear out the old grid
-        clear_grid(grid);
-
         // Choose between terrain generators
-        std::uniform_int_distribution<int> choose(1, 3);
-        const int type = choose(_gen);
+        const int type = rng.uniform(1, 3);
         if (type == 1)
         {
-            // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_sym(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
+            // Mandelbulb world with the empty cells filled in by a second mandelbulb
+            kernel::mandelbulb_sym sym = load_mandelbulb_sym(rng);
+            kernel::mandelbulb_exp exp = load_mandelbulb_exp(rng);
+            sym.prepare(work_queue::worker, scale, grid_cell_center);
+            exp.prepare(work_queue::worker, scale, grid_cell_center);
+
+            // Generate each chunk straight into the grid
+            grid.generate(work_queue::worker, [&sym, &exp, chunk_size, scale, &grid_cell_center](const min::tri<size_t> &start, std::vector<block_id> &cells) {
+                sym.generate_chunk(start, cells, chunk_size, scale, grid_cell_center);
+                exp.generate_chunk(start, cells, chunk_size, scale, grid_cell_center);
             });
         }
-        if (type == 2)
+        else if (type == 2)
         {
             // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_asym(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
+            kernel::mandelbulb_asym asym = load_mandelbulb_asym(rng);
+            asym.prepare(work_queue::worker, scale, grid_cell_center);
+            grid.generate(work_queue::worker, [&asym, chunk_size, scale, &grid_cell_center](const min::tri<size_t> &start, std::vector<block_id> &cells) {
+                asym.generate_chunk(start, cells, chunk_size, scale, grid_cell_center);
             });
         }
         else
         {
             // Generate mandelbulb world using mandelbulb generator
-            load_mandelbulb_exp(_gen).generate(work_queue::worker, grid, scale, [grid_cell_center](const size_t i) {
-                return grid_cell_center(i);
+            kernel::mandelbulb_exp exp = load_mandelbulb_exp(rng);
+            exp.prepare(work_queue::worker, scale, grid_cell_center);
+            grid.generate(work_queue::worker, [&exp, chunk_size, scale, &grid_cell_center](const min::tri<size_t> &start, std::vector<block_id> &cells) {
+                exp.generate_chunk(start, cells, chunk_size, scale, grid_cell_center);
             });
         }
 
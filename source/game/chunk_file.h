@@ -0,0 +1,393 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_CHUNK_FILE_BDS_
+#define _BDS_CHUNK_FILE_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <game/chunk_store.h>
+#include <game/file.h>
+#include <game/mapped_file.h>
+#include <iostream>
+#include <min/serial.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+class chunk_file
+{
+  private:
+    static constexpr uint32_t _magic = 0x57534442;
+    static constexpr uint32_t _version = 1;
+    static constexpr size_t _header_size = 5 * sizeof(uint32_t);
+    static constexpr size_t _entry_size = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    static constexpr size_t _align = 64;
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _chunk_count;
+    std::string _file_name;
+    std::vector<uint64_t> _offset;
+    std::vector<uint32_t> _capacity;
+    std::vector<uint32_t> _size;
+    std::vector<uint8_t> _record;
+    mapped_file _map;
+    uint64_t _end;
+    uint64_t _waste;
+
+    static inline size_t align(const size_t size)
+    {
+        return ((size + _align - 1) / _align) * _align;
+    }
+    inline size_t data_offset() const
+    {
+        return _header_size + _chunk_count * _entry_size;
+    }
+    inline void reset()
+    {
+        // Forget the index of the file on disk
+        _file_name.clear();
+        _offset.assign(_chunk_count, 0);
+        _capacity.assign(_chunk_count, 0);
+        _size.assign(_chunk_count, 0);
+        _end = data_offset();
+        _waste = 0;
+    }
+    inline void write_entry(std::vector<uint8_t> &stream, const size_t chunk_key) const
+    {
+        min::write_le<uint64_t>(stream, _offset[chunk_key]);
+        min::write_le<uint32_t>(stream, _capacity[chunk_key]);
+        min::write_le<uint32_t>(stream, _size[chunk_key]);
+    }
+    inline void write_record(const chunk_store &grid, const size_t chunk_key)
+    {
+        // Empty chunks are not stored in the file
+        _record.clear();
+        const palette_chunk &chunk = grid.get_chunk(chunk_key);
+        if (!chunk.is_empty())
+        {
+            chunk.serialize(_record);
+        }
+    }
+
+  public:
+    chunk_file(const size_t grid_scale, const size_t chunk_size, const size_t chunk_count)
+        : _grid_scale(grid_scale), _chunk_size(chunk_size), _chunk_count(chunk_count), _end(0), _waste(0)
+    {
+        reset();
+    }
+    inline void close()
+    {
+        // Release the mapped file, every chunk must already be resident
+        _map.close();
+        reset();
+    }
+    static inline bool is_chunk_file(const std::string &file_name)
+    {
+        // Check the magic number at the start of the file
+        std::ifstream file(file_name, std::ios::in | std::ios::binary);
+        uint8_t magic[sizeof(uint32_t)] = {};
+        file.read(reinterpret_cast<char *>(magic), sizeof(uint32_t));
+        if (!file)
+        {
+            return false;
+        }
+
+        // Decode the little endian magic number
+        std::vector<uint8_t> stream(magic, magic + sizeof(uint32_t));
+        size_t next = 0;
+        return min::read_le<uint32_t>(stream, next) == _magic;
+    }
+    inline void load_chunk(const size_t chunk_key, palette_chunk &chunk, const size_t cells)
+    {
+        // Empty chunks have no record
+        const size_t size = _size[chunk_key];
+        if (size == 0)
+        {
+            chunk.clear();
+            return;
+        }
+
+        // Check the record is inside the mapped file
+        const uint64_t offset = _offset[chunk_key];
+        if (!_map.is_open() || offset + size > _map.size())
+        {
+            throw std::runtime_error("chunk_file: could not read chunk " + std::to_string(chunk_key));
+        }
+
+        // Copy the chunk record out of the mapped file
+        const uint8_t *const data = _map.data() + offset;
+        _record.assign(data, data + size);
+
+        // Decode the chunk record
+        size_t next = 0;
+        chunk.deserialize(_record, next, cells);
+    }
+    inline bool load_index(const std::string &file_name)
+    {
+        // Forget any previous index
+        reset();
+
+        // Map the file, pages are only read when touched
+        if (!_map.open(file_name))
+        {
+            return false;
+        }
+
+        // Print diagnostic message
+        std::cout << "chunk_file: loading index from " << file_name << std::endl;
+
+        // Read and validate the header
+        const uint64_t file_size = _map.size();
+        if (file_size < data_offset())
+        {
+            std::cout << "chunk_file: truncated world file '" << file_name << "'" << std::endl;
+            _map.close();
+            return false;
+        }
+        std::vector<uint8_t> stream(_map.data(), _map.data() + _header_size);
+        size_t next = 0;
+        const uint32_t magic = min::read_le<uint32_t>(stream, next);
+        const uint32_t version = min::read_le<uint32_t>(stream, next);
+        const uint32_t grid_scale = min::read_le<uint32_t>(stream, next);
+        const uint32_t chunk_size = min::read_le<uint32_t>(stream, next);
+        const uint32_t chunk_count = min::read_le<uint32_t>(stream, next);
+        if (magic != _magic || version != _version)
+        {
+            std::cout << "chunk_file: unsupported world file '" << file_name << "'" << std::endl;
+            _map.close();
+            return false;
+        }
+        else if (grid_scale != _grid_scale || chunk_size != _chunk_size || chunk_count != _chunk_count)
+        {
+            std::cout << "chunk_file: world file '" << file_name << "' has wrong dimensions" << std::endl;
+            _map.close();
+            return false;
+        }
+
+        // Read the chunk index, chunk data is read on demand
+        stream.assign(_map.data() + _header_size, _map.data() + data_offset());
+
+        // Parse and validate the chunk index
+        next = 0;
+        const uint64_t start = data_offset();
+        for (size_t i = 0; i < _chunk_count; i++)
+        {
+            _offset[i] = min::read_le<uint64_t>(stream, next);
+            _capacity[i] = min::read_le<uint32_t>(stream, next);
+            _size[i] = min::read_le<uint32_t>(stream, next);
+
+            // Check the record lies inside the data section
+            if (_size[i] > _capacity[i] || (_capacity[i] > 0 && (_offset[i] < start || _offset[i] + _capacity[i] > file_size)))
+            {
+                std::cout << "chunk_file: corrupt chunk index in '" << file_name << "'" << std::endl;
+                _map.close();
+                reset();
+                return false;
+            }
+        }
+
+        // Calculate the wasted space in the file
+        uint64_t used = 0;
+        for (size_t i = 0; i < _chunk_count; i++)
+        {
+            used += _capacity[i];
+        }
+        _end = file_size;
+        _waste = file_size - start - std::min(used, file_size - start);
+
+        // Remember which file this index describes
+        _file_name = file_name;
+
+        return true;
+    }
+    inline void page_chunks(chunk_store &grid)
+    {
+        // Chunks are decoded from the mapped file on first access
+        const size_t cells = grid.get_chunk_cells();
+        grid.set_pager([this, cells](const size_t chunk_key, palette_chunk &chunk) {
+            try
+            {
+                load_chunk(chunk_key, chunk, cells);
+            }
+            catch (const std::exception &ex)
+            {
+                // A corrupt chunk is treated as empty
+                std::cout << ex.what() << std::endl;
+                chunk.clear();
+            }
+        });
+    }
+    inline void save(const std::string &file_name, const chunk_store &grid)
+    {
+        // Page in all chunks, then release the old file
+        grid.page_all();
+        _map.close();
+
+        // Build the new index aside, the old one still describes the file on disk
+        std::vector<uint64_t> offset(_chunk_count, 0);
+        std::vector<uint32_t> capacity(_chunk_count, 0);
+        std::vector<uint32_t> size(_chunk_count, 0);
+
+        // Write the header
+        std::vector<uint8_t> stream;
+        stream.reserve(data_offset() + grid.bytes());
+        min::write_le<uint32_t>(stream, _magic);
+        min::write_le<uint32_t>(stream, _version);
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(_grid_scale));
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(_chunk_size));
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(_chunk_count));
+
+        // Reserve space for the index, it is filled in after the records
+        stream.resize(data_offset(), 0);
+
+        // Write all chunk records aligned to the slot size
+        for (size_t i = 0; i < _chunk_count; i++)
+        {
+            write_record(grid, i);
+            const size_t record = _record.size();
+            if (record > 0)
+            {
+                offset[i] = stream.size();
+                capacity[i] = static_cast<uint32_t>(align(record));
+                size[i] = static_cast<uint32_t>(record);
+                stream.insert(stream.end(), _record.begin(), _record.end());
+                stream.resize(offset[i] + capacity[i], 0);
+            }
+        }
+
+        // Write the index
+        std::vector<uint8_t> index;
+        index.reserve(_chunk_count * _entry_size);
+        for (size_t i = 0; i < _chunk_count; i++)
+        {
+            min::write_le<uint64_t>(index, offset[i]);
+            min::write_le<uint32_t>(index, capacity[i]);
+            min::write_le<uint32_t>(index, size[i]);
+        }
+        std::copy(index.begin(), index.end(), stream.begin() + _header_size);
+
+        // Write data to a temporary file, the old world stays intact until it is complete
+        const std::string temp_name = file_name + ".tmp";
+        std::ofstream file(temp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(stream.data()), stream.size());
+        file.close();
+        if (!file)
+        {
+            std::cout << "chunk_file: could not save file '" << temp_name << "'" << std::endl;
+            std::remove(temp_name.c_str());
+            return;
+        }
+
+        // Replace the old world with the new one, the old world is kept until the new one is in place
+        if (!file::replace_file(temp_name, file_name))
+        {
+            std::cout << "chunk_file: could not replace file '" << file_name << "'" << std::endl;
+            return;
+        }
+
+        // Print diagnostic message
+        std::cout << "chunk_file: saved " << _chunk_count << " chunks to " << file_name << std::endl;
+
+        // The index now describes the new file
+        _offset.swap(offset);
+        _capacity.swap(capacity);
+        _size.swap(size);
+        _end = stream.size();
+        _waste = 0;
+        _file_name = file_name;
+    }
+    inline void save(const std::string &file_name, const chunk_store &grid, const std::vector<size_t> &keys)
+    {
+        // If the index does not describe this file, rewrite everything
+        if (_file_name != file_name || !file::exists_file(file_name))
+        {
+            save(file_name, grid);
+            return;
+        }
+
+        // Open the file to append records and update the index
+        std::fstream file(file_name, std::ios::in | std::ios::out | std::ios::binary);
+        if (!file.is_open())
+        {
+            save(file_name, grid);
+            return;
+        }
+
+        // Print diagnostic message
+        std::cout << "chunk_file: saving " << keys.size() << " chunks to " << file_name << std::endl;
+
+        // Append dirty chunk records, records the index on disk points to are never overwritten
+        for (const size_t k : keys)
+        {
+            write_record(grid, k);
+            const size_t size = _record.size();
+
+            // The old slot becomes garbage
+            _waste += _capacity[k];
+            _offset[k] = 0;
+            _capacity[k] = 0;
+            _size[k] = static_cast<uint32_t>(size);
+
+            // Write the record and pad the slot
+            if (size > 0)
+            {
+                _offset[k] = _end;
+                _capacity[k] = static_cast<uint32_t>(align(size));
+                _end += _capacity[k];
+                _record.resize(_capacity[k], 0);
+                file.seekp(_offset[k], std::ios::beg);
+                file.write(reinterpret_cast<const char *>(_record.data()), _record.size());
+            }
+        }
+
+        // Records must reach the disk before the index points at them
+        file.flush();
+
+        // Update the index entries
+        std::vector<uint8_t> entry;
+        for (const size_t k : keys)
+        {
+            entry.clear();
+            write_entry(entry, k);
+            file.seekp(_header_size + k * _entry_size, std::ios::beg);
+            file.write(reinterpret_cast<const char *>(entry.data()), entry.size());
+        }
+
+        // If writing failed, fall back to a full rewrite
+        file.close();
+        if (!file)
+        {
+            save(file_name, grid);
+            return;
+        }
+
+        // If more than half the data section is garbage, compact the file
+        if (_waste > (_end - data_offset()) / 2)
+        {
+            save(file_name, grid);
+        }
+    }
+};
+}
+
+#endif
@@ -0,0 +1,78 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_CHUNK_NOISE_BDS_
+#define _BDS_CHUNK_NOISE_BDS_
+
+#include <algorithm>
+#include <game/fractal_noise.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace kernel
+{
+
+class chunk_noise
+{
+  private:
+    const size_t _chunk_size;
+    const size_t _chunk_cells;
+    min::tri<size_t> _start;
+    std::vector<fractal_noise> _layers;
+    std::vector<std::vector<float>> _fields;
+    std::vector<bool> _ready;
+
+  public:
+    chunk_noise(const size_t chunk_size)
+        : _chunk_size(chunk_size), _chunk_cells(chunk_size * chunk_size * chunk_size), _start(0, 0, 0) {}
+
+    inline size_t add(const fractal_noise &layer)
+    {
+        // Register a noise layer, returns the layer id
+        _layers.push_back(layer);
+        _fields.emplace_back(_chunk_cells);
+        _ready.push_back(false);
+
+        return _layers.size() - 1;
+    }
+    inline const float *get(const size_t layer)
+    {
+        // Sample the layer over the whole chunk the first time it is asked for
+        if (!_ready[layer])
+        {
+            const size_t cs = _chunk_size;
+            _layers[layer].brick(_start, cs, cs, cs, _fields[layer].data());
+            _ready[layer] = true;
+        }
+
+        // Chunk cells are x major, rows along Z are contiguous
+        return _fields[layer].data();
+    }
+    inline const min::tri<size_t> &get_start() const
+    {
+        return _start;
+    }
+    inline void set_chunk(const min::tri<size_t> &start)
+    {
+        // Noise of the previous chunk is stale
+        _start = start;
+        std::fill(_ready.begin(), _ready.end(), false);
+    }
+};
+}
+
+#endif
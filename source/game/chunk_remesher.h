@@ -0,0 +1,261 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_CHUNK_REMESHER_BDS_
+#define _BDS_CHUNK_REMESHER_BDS_
+
+#include <algorithm>
+#include <condition_variable>
+#include <game/id.h>
+#include <game/terrain_mesher.h>
+#include <min/mesh.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+
+class remesh_job
+{
+  private:
+    size_t _key;
+    size_t _version;
+    float _priority;
+    min::tri<size_t> _start;
+    std::vector<block_id> _cells;
+
+  public:
+    remesh_job(const size_t key, const size_t version, const float priority, const min::tri<size_t> &start, std::vector<block_id> &&cells)
+        : _key(key), _version(version), _priority(priority), _start(start), _cells(std::move(cells)) {}
+
+    inline const std::vector<block_id> &get_cells() const
+    {
+        return _cells;
+    }
+    inline size_t get_key() const
+    {
+        return _key;
+    }
+    inline float get_priority() const
+    {
+        return _priority;
+    }
+    inline const min::tri<size_t> &get_start() const
+    {
+        return _start;
+    }
+    inline size_t get_version() const
+    {
+        return _version;
+    }
+};
+
+class remesh_result
+{
+  private:
+    size_t _key;
+    size_t _version;
+    min::mesh<float, uint32_t> _mesh;
+
+  public:
+    remesh_result(const size_t key, const size_t version, min::mesh<float, uint32_t> &&mesh)
+        : _key(key), _version(version), _mesh(std::move(mesh)) {}
+
+    inline size_t get_key() const
+    {
+        return _key;
+    }
+    inline min::mesh<float, uint32_t> &get_mesh()
+    {
+        return _mesh;
+    }
+    inline size_t get_version() const
+    {
+        return _version;
+    }
+};
+
+class chunk_remesher
+{
+  private:
+    static constexpr size_t _spare_limit = 16;
+    const size_t _chunk_size;
+    const min::vec3<float> _world_min;
+    std::vector<remesh_job> _jobs;
+    std::vector<remesh_result> _results;
+    std::vector<min::mesh<float, uint32_t>> _spare;
+    std::vector<std::thread> _threads;
+    std::mutex _lock;
+    std::condition_variable _wake;
+    size_t _busy;
+    bool _greedy;
+    bool _stop;
+
+    inline min::mesh<float, uint32_t> acquire_mesh()
+    {
+        // Reuse a swapped out front buffer if available
+        if (_spare.size() > 0)
+        {
+            min::mesh<float, uint32_t> out = std::move(_spare.back());
+            _spare.pop_back();
+            return out;
+        }
+
+        return min::mesh<float, uint32_t>("chunk");
+    }
+    inline void remesh(terrain_mesher &mesher, const remesh_job &job, min::mesh<float, uint32_t> &mesh) const
+    {
+        // Clear the mesh and mesher, vertices are relative to the chunk origin
+        const min::tri<size_t> &start = job.get_start();
+        mesh.clear();
+        mesher.clear();
+        mesher.set_origin(min::vec3<float>(start.x(), start.y(), start.z()) + _world_min);
+
+        // Generate cell faces from the padded snapshot
+        mesher.generate_chunk_padded(job.get_cells());
+
+        // Generate mesh on this thread, the shared worker pool belongs to the game thread
+        mesher.generate_chunk_serial(mesh);
+    }
+    inline void work()
+    {
+        // Each thread owns a mesher
+        terrain_mesher mesher(_chunk_size);
+        mesher.set_greedy(_greedy);
+
+        std::unique_lock<std::mutex> lock(_lock);
+        while (true)
+        {
+            // Wait for a job or shutdown
+            _wake.wait(lock, [this]() {
+                return _stop || _jobs.size() > 0;
+            });
+            if (_stop)
+            {
+                return;
+            }
+
+            // Take the job with the best priority
+            const auto best = std::min_element(_jobs.begin(), _jobs.end(), [](const remesh_job &a, const remesh_job &b) {
+                return a.get_priority() < b.get_priority();
+            });
+            remesh_job job = std::move(*best);
+            if (best != _jobs.end() - 1)
+            {
+                *best = std::move(_jobs.back());
+            }
+            _jobs.pop_back();
+            min::mesh<float, uint32_t> mesh = acquire_mesh();
+            _busy++;
+
+            // Mesh the chunk without holding the lock
+            lock.unlock();
+            remesh(mesher, job, mesh);
+            lock.lock();
+
+            // Hand the back buffer to the game thread
+            _results.emplace_back(job.get_key(), job.get_version(), std::move(mesh));
+            _busy--;
+        }
+    }
+
+  public:
+    chunk_remesher(const size_t chunk_size, const min::vec3<float> &world_min, const size_t threads, const bool greedy)
+        : _chunk_size(chunk_size), _world_min(world_min), _busy(0), _greedy(greedy), _stop(false)
+    {
+        // Launch the background threads
+        for (size_t i = 0; i < threads; i++)
+        {
+            _threads.emplace_back(&chunk_remesher::work, this);
+        }
+    }
+    ~chunk_remesher()
+    {
+        // Signal all threads to stop
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stop = true;
+        }
+        _wake.notify_all();
+
+        // Wait for all threads to finish
+        for (auto &t : _threads)
+        {
+            t.join();
+        }
+    }
+    chunk_remesher(const chunk_remesher &) = delete;
+    chunk_remesher &operator=(const chunk_remesher &) = delete;
+
+    inline void clear()
+    {
+        // Drop all jobs that have not started
+        std::lock_guard<std::mutex> lock(_lock);
+        _jobs.clear();
+    }
+    inline size_t pending()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _jobs.size() + _busy + _results.size();
+    }
+    template <typename F>
+    inline void pop(const F &f)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        // Hand finished meshes to the caller, swapped out meshes become spares
+        for (auto &r : _results)
+        {
+            min::mesh<float, uint32_t> &mesh = r.get_mesh();
+            f(r.get_key(), r.get_version(), mesh);
+            if (_spare.size() < _spare_limit)
+            {
+                _spare.push_back(std::move(mesh));
+            }
+        }
+        _results.clear();
+    }
+    inline void push(const size_t key, const size_t version, const float priority, const min::tri<size_t> &start, std::vector<block_id> &&cells)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            // Replace a job for this chunk that has not started yet
+            for (auto &j : _jobs)
+            {
+                if (j.get_key() == key)
+                {
+                    j = remesh_job(key, version, priority, start, std::move(cells));
+                    return;
+                }
+            }
+
+            // Queue a new job
+            _jobs.emplace_back(key, version, priority, start, std::move(cells));
+        }
+
+        // Wake a thread to mesh it
+        _wake.notify_one();
+    }
+};
+}
+
+#endif
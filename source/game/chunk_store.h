@@ -0,0 +1,733 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_CHUNK_STORE_BDS_
+#define _BDS_CHUNK_STORE_BDS_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <game/id.h>
+#include <min/serial.h>
+#include <min/thread_pool.h>
+#include <min/tri.h>
+#include <vector>
+
+namespace game
+{
+
+class palette_chunk
+{
+  private:
+    std::vector<block_id> _palette;
+    std::vector<uint64_t> _bits;
+    uint_fast8_t _width;
+
+    static inline uint_fast8_t calc_width(const size_t palette_size)
+    {
+        // Widths are powers of two so indices never straddle a word
+        if (palette_size <= 1)
+        {
+            return 0;
+        }
+        else if (palette_size <= 2)
+        {
+            return 1;
+        }
+        else if (palette_size <= 4)
+        {
+            return 2;
+        }
+        else if (palette_size <= 16)
+        {
+            return 4;
+        }
+
+        return 8;
+    }
+    static inline size_t calc_words(const size_t cells, const uint_fast8_t width)
+    {
+        return ((cells * width) + 63) / 64;
+    }
+    static inline uint8_t lookup_key(const block_id id)
+    {
+        return static_cast<uint8_t>(static_cast<int_fast8_t>(id));
+    }
+    inline size_t find(const block_id id) const
+    {
+        // Palettes are tiny so a linear search is fastest
+        const size_t size = _palette.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (_palette[i] == id)
+            {
+                return i;
+            }
+        }
+
+        return size;
+    }
+    inline size_t get_index(const size_t cell) const
+    {
+        // Calculate the bit offset of this cell
+        const size_t bit = cell * _width;
+        const uint64_t mask = (static_cast<uint64_t>(1) << _width) - 1;
+
+        // Extract the palette index
+        return (_bits[bit >> 6] >> (bit & 63)) & mask;
+    }
+    inline void set_index(const size_t cell, const size_t index)
+    {
+        // Calculate the bit offset of this cell
+        const size_t bit = cell * _width;
+        const size_t shift = bit & 63;
+        const uint64_t mask = ((static_cast<uint64_t>(1) << _width) - 1) << shift;
+
+        // Overwrite the palette index
+        uint64_t &word = _bits[bit >> 6];
+        word = (word & ~mask) | (static_cast<uint64_t>(index) << shift);
+    }
+    inline void repack(const size_t cells, const uint_fast8_t width)
+    {
+        // Copy the old indices into a wider bit array
+        std::vector<uint64_t> bits(calc_words(cells, width), 0);
+        if (_width > 0)
+        {
+            for (size_t i = 0; i < cells; i++)
+            {
+                const size_t index = get_index(i);
+                const size_t bit = i * width;
+                bits[bit >> 6] |= static_cast<uint64_t>(index) << (bit & 63);
+            }
+        }
+
+        // Swap in the new bit array
+        _bits.swap(bits);
+        _width = width;
+    }
+
+  public:
+    palette_chunk() : _width(0) {}
+
+    inline size_t bytes() const
+    {
+        return sizeof(palette_chunk) + _palette.capacity() * sizeof(block_id) + _bits.capacity() * sizeof(uint64_t);
+    }
+    inline void clear()
+    {
+        // Release all memory, an empty palette is an empty chunk
+        std::vector<block_id>().swap(_palette);
+        std::vector<uint64_t>().swap(_bits);
+        _width = 0;
+    }
+    inline void compact(const size_t cells)
+    {
+        // Uniform chunks are already compact
+        if (_width == 0)
+        {
+            if (_palette.size() == 1 && _palette[0] == block_id::EMPTY)
+            {
+                clear();
+            }
+
+            return;
+        }
+
+        // Find which palette entries are still in use
+        std::array<bool, 256> used = {};
+        for (size_t i = 0; i < cells; i++)
+        {
+            used[get_index(i)] = true;
+        }
+
+        // Build the new palette and the remapping table
+        std::vector<block_id> palette;
+        std::array<uint8_t, 256> remap = {};
+        const size_t size = _palette.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (used[i])
+            {
+                remap[i] = static_cast<uint8_t>(palette.size());
+                palette.push_back(_palette[i]);
+            }
+        }
+
+        // If only one block type remains, store it uniformly
+        if (palette.size() == 1)
+        {
+            fill(palette[0]);
+            return;
+        }
+
+        // If nothing changed, leave the chunk alone
+        if (palette.size() == size)
+        {
+            return;
+        }
+
+        // Rewrite indices using the smaller palette
+        const uint_fast8_t width = calc_width(palette.size());
+        std::vector<uint64_t> bits(calc_words(cells, width), 0);
+        for (size_t i = 0; i < cells; i++)
+        {
+            const size_t bit = i * width;
+            bits[bit >> 6] |= static_cast<uint64_t>(remap[get_index(i)]) << (bit & 63);
+        }
+
+        // Swap in the compacted chunk
+        _palette.swap(palette);
+        _bits.swap(bits);
+        _width = width;
+    }
+    inline void deserialize(const std::vector<uint8_t> &stream, size_t &next, const size_t cells)
+    {
+        // Check the record header fits in the stream
+        const size_t length = stream.size();
+        if (next + 1 > length)
+        {
+            throw std::runtime_error("palette_chunk: truncated chunk record");
+        }
+
+        // Read the palette
+        const size_t size = min::read_le<uint8_t>(stream, next);
+        if (next + size + 5 > length)
+        {
+            throw std::runtime_error("palette_chunk: truncated chunk record");
+        }
+        std::vector<block_id> palette(size);
+        for (size_t i = 0; i < size; i++)
+        {
+            palette[i] = static_cast<block_id>(static_cast<int8_t>(min::read_le<uint8_t>(stream, next)));
+        }
+
+        // Read the packed indices
+        const uint_fast8_t width = min::read_le<uint8_t>(stream, next);
+        const size_t words = min::read_le<uint32_t>(stream, next);
+        if (width != calc_width(size) || words != calc_words(cells, width))
+        {
+            throw std::runtime_error("palette_chunk: invalid chunk record");
+        }
+        else if (next + words * sizeof(uint64_t) > length)
+        {
+            throw std::runtime_error("palette_chunk: truncated chunk record");
+        }
+        std::vector<uint64_t> bits(words);
+        for (size_t i = 0; i < words; i++)
+        {
+            bits[i] = min::read_le<uint64_t>(stream, next);
+        }
+
+        // Swap in the loaded chunk
+        _palette.swap(palette);
+        _bits.swap(bits);
+        _width = width;
+
+        // Reject indices that point outside of the palette
+        if (_width > 0)
+        {
+            for (size_t i = 0; i < cells; i++)
+            {
+                if (get_index(i) >= size)
+                {
+                    clear();
+                    throw std::runtime_error("palette_chunk: invalid palette index");
+                }
+            }
+        }
+    }
+    inline void fill(const block_id id)
+    {
+        // Empty chunks cost nothing
+        clear();
+        if (id != block_id::EMPTY)
+        {
+            _palette.push_back(id);
+        }
+    }
+    inline block_id get(const size_t cell) const
+    {
+        if (_width > 0)
+        {
+            return _palette[get_index(cell)];
+        }
+        else if (_palette.size() > 0)
+        {
+            return _palette[0];
+        }
+
+        return block_id::EMPTY;
+    }
+    inline bool is_empty() const
+    {
+        return _palette.size() == 0;
+    }
+    inline bool is_uniform() const
+    {
+        return _width == 0;
+    }
+    template <typename F>
+    inline void load(const size_t cells, const F &f)
+    {
+        // Build the palette from the source cells
+        std::array<int_fast16_t, 256> lookup;
+        lookup.fill(-1);
+        std::vector<block_id> palette;
+        for (size_t i = 0; i < cells; i++)
+        {
+            const block_id id = f(i);
+            int_fast16_t &index = lookup[lookup_key(id)];
+            if (index == -1)
+            {
+                index = static_cast<int_fast16_t>(palette.size());
+                palette.push_back(id);
+            }
+        }
+
+        // Store uniform chunks as a single id
+        if (palette.size() <= 1)
+        {
+            fill(palette.size() == 0 ? block_id::EMPTY : palette[0]);
+            return;
+        }
+
+        // Pack the palette indices
+        const uint_fast8_t width = calc_width(palette.size());
+        std::vector<uint64_t> bits(calc_words(cells, width), 0);
+        for (size_t i = 0; i < cells; i++)
+        {
+            const size_t bit = i * width;
+            bits[bit >> 6] |= static_cast<uint64_t>(lookup[lookup_key(f(i))]) << (bit & 63);
+        }
+
+        // Swap in the packed chunk
+        _palette.swap(palette);
+        _bits.swap(bits);
+        _width = width;
+    }
+    inline void set(const size_t cell, const size_t cells, const block_id id)
+    {
+        if (_width == 0)
+        {
+            // Setting a uniform chunk to its own value is a no-op
+            const block_id uniform = (_palette.size() == 0) ? block_id::EMPTY : _palette[0];
+            if (uniform == id)
+            {
+                return;
+            }
+
+            // Promote uniform chunk to a two entry palette
+            _palette.clear();
+            _palette.push_back(uniform);
+            _palette.push_back(id);
+            repack(cells, 1);
+            set_index(cell, 1);
+            return;
+        }
+
+        // Add the id to the palette if needed
+        size_t index = find(id);
+        if (index == _palette.size())
+        {
+            // Widen the indices if the palette is full
+            if (index == (static_cast<size_t>(1) << _width))
+            {
+                repack(cells, calc_width(index + 1));
+            }
+
+            _palette.push_back(id);
+        }
+
+        // Store the palette index
+        set_index(cell, index);
+    }
+    inline void serialize(std::vector<uint8_t> &stream) const
+    {
+        // Write the palette
+        const size_t size = _palette.size();
+        min::write_le<uint8_t>(stream, static_cast<uint8_t>(size));
+        for (size_t i = 0; i < size; i++)
+        {
+            min::write_le<uint8_t>(stream, static_cast<uint8_t>(static_cast<int8_t>(_palette[i])));
+        }
+
+        // Write the packed indices
+        const size_t words = _bits.size();
+        min::write_le<uint8_t>(stream, _width);
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(words));
+        for (size_t i = 0; i < words; i++)
+        {
+            min::write_le<uint64_t>(stream, _bits[i]);
+        }
+    }
+};
+
+class chunk_store
+{
+  private:
+    const size_t _grid_scale;
+    const size_t _grid_scale2;
+    const size_t _chunk_size;
+    const size_t _chunk_cells;
+    const size_t _chunk_scale;
+    mutable std::vector<palette_chunk> _chunks;
+    mutable std::vector<bool> _resident;
+    std::function<void(const size_t, palette_chunk &)> _pager;
+
+    inline size_t chunk_key(const size_t x, const size_t y, const size_t z) const
+    {
+        const size_t cx = x / _chunk_size;
+        const size_t cy = y / _chunk_size;
+        const size_t cz = z / _chunk_size;
+
+        return (cx * _chunk_scale * _chunk_scale) + (cy * _chunk_scale) + cz;
+    }
+    inline size_t cell_key(const size_t x, const size_t y, const size_t z) const
+    {
+        const size_t rx = x % _chunk_size;
+        const size_t ry = y % _chunk_size;
+        const size_t rz = z % _chunk_size;
+
+        return (rx * _chunk_size * _chunk_size) + (ry * _chunk_size) + rz;
+    }
+    inline min::tri<size_t> grid_index(const size_t key) const
+    {
+        // Unpack grid key into components
+        const size_t x = key / _grid_scale2;
+        const size_t r = key - (x * _grid_scale2);
+        const size_t y = r / _grid_scale;
+        const size_t z = r - (y * _grid_scale);
+
+        return min::tri<size_t>(x, y, z);
+    }
+    inline size_t grid_key(const size_t cx, const size_t cy, const size_t cz, const size_t cell) const
+    {
+        // Unpack local cell components
+        const size_t rx = cell / (_chunk_size * _chunk_size);
+        const size_t ry = (cell / _chunk_size) % _chunk_size;
+        const size_t rz = cell % _chunk_size;
+
+        // Calculate world grid components
+        const size_t x = cx * _chunk_size + rx;
+        const size_t y = cy * _chunk_size + ry;
+        const size_t z = cz * _chunk_size + rz;
+
+        return (x * _grid_scale2) + (y * _grid_scale) + z;
+    }
+    inline void set_resident()
+    {
+        // All chunks live in memory, nothing left to page in
+        std::fill(_resident.begin(), _resident.end(), true);
+        _pager = nullptr;
+    }
+
+  public:
+    chunk_store(const size_t grid_scale, const size_t chunk_size)
+        : _grid_scale(grid_scale), _grid_scale2(grid_scale * grid_scale),
+          _chunk_size(chunk_size), _chunk_cells(chunk_size * chunk_size * chunk_size),
+          _chunk_scale(grid_scale / chunk_size),
+          _chunks(_chunk_scale * _chunk_scale * _chunk_scale),
+          _resident(_chunks.size(), true) {}
+
+    inline size_t bytes() const
+    {
+        // Calculate memory footprint of all chunks
+        size_t out = sizeof(chunk_store);
+        for (const auto &c : _chunks)
+        {
+            out += c.bytes();
+        }
+
+        return out;
+    }
+    inline void clear()
+    {
+        for (auto &c : _chunks)
+        {
+            c.clear();
+        }
+
+        // Cleared chunks are resident
+        set_resident();
+    }
+    inline void compact(const size_t chunk_key)
+    {
+        page(chunk_key);
+        _chunks[chunk_key].compact(_chunk_cells);
+    }
+    inline void copy(std::vector<block_id> &dense) const
+    {
+        // Page in all chunks
+        page_all();
+
+        // Expand all chunks into a dense grid
+        dense.resize(size());
+        const size_t chunks = _chunks.size();
+        for (size_t i = 0; i < chunks; i++)
+        {
+            const size_t cx = i / (_chunk_scale * _chunk_scale);
+            const size_t cy = (i / _chunk_scale) % _chunk_scale;
+            const size_t cz = i % _chunk_scale;
+            for (size_t j = 0; j < _chunk_cells; j++)
+            {
+                dense[grid_key(cx, cy, cz, j)] = _chunks[i].get(j);
+            }
+        }
+    }
+    inline void copy_apron(const size_t chunk_key, std::vector<block_id> &padded, const block_id outside) const
+    {
+        // Padded chunk has a one cell apron on each side, x major
+        const size_t cs = _chunk_size;
+        const size_t as = cs + 2;
+        const size_t as2 = as * as;
+        padded.assign(as2 * as, outside);
+
+        // Unpack the chunk components
+        const size_t cx = chunk_key / (_chunk_scale * _chunk_scale);
+        const size_t cy = (chunk_key / _chunk_scale) % _chunk_scale;
+        const size_t cz = chunk_key % _chunk_scale;
+
+        // Expand the chunk into the padded interior
+        const palette_chunk &chunk = get_chunk(chunk_key);
+        if (chunk.is_uniform())
+        {
+            const block_id id = chunk.get(0);
+            for (size_t x = 1; x <= cs; x++)
+            {
+                for (size_t y = 1; y <= cs; y++)
+                {
+                    std::fill_n(&padded[(x * as + y) * as + 1], cs, id);
+                }
+            }
+        }
+        else
+        {
+            size_t cell = 0;
+            for (size_t x = 1; x <= cs; x++)
+            {
+                for (size_t y = 1; y <= cs; y++)
+                {
+                    block_id *const row = &padded[(x * as + y) * as + 1];
+                    for (size_t z = 0; z < cs; z++, cell++)
+                    {
+                        row[z] = chunk.get(cell);
+                    }
+                }
+            }
+        }
+
+        // Function to copy one face of a neighbor chunk into the apron, cells outside the grid keep outside value
+        const auto face = [this, &padded, cs](const bool valid, const size_t neighbor, const size_t start, const size_t stride_a, const size_t stride_b,
+                                              const size_t cell_start, const size_t cell_a, const size_t cell_b) {
+            if (valid)
+            {
+                const palette_chunk &n = get_chunk(neighbor);
+                for (size_t a = 0; a < cs; a++)
+                {
+                    for (size_t b = 0; b < cs; b++)
+                    {
+                        padded[start + a * stride_a + b * stride_b] = n.get(cell_start + a * cell_a + b * cell_b);
+                    }
+                }
+            }
+        };
+
+        // Copy the six face neighbors, the apron edges and corners are never read
+        const size_t cs2 = cs * cs;
+        const size_t sc = _chunk_scale;
+        const size_t sc2 = sc * sc;
+        face(cx > 0, chunk_key - sc2, as + 1, as, 1, (cs - 1) * cs2, cs, 1);
+        face(cx + 1 < sc, chunk_key + sc2, (cs + 1) * as2 + as + 1, as, 1, 0, cs, 1);
+        face(cy > 0, chunk_key - sc, as2 + 1, as2, 1, (cs - 1) * cs, cs2, 1);
+        face(cy + 1 < sc, chunk_key + sc, as2 + (cs + 1) * as + 1, as2, 1, 0, cs2, 1);
+        face(cz > 0, chunk_key - 1, as2 + as, as2, as, cs - 1, cs2, cs);
+        face(cz + 1 < sc, chunk_key + 1, as2 + as + cs + 1, as2, as, 0, cs2, cs);
+    }
+    template <typename F>
+    inline void generate(min::thread_pool &pool, const F &f)
+    {
+        // Generate and compress each chunk in parallel, no dense grid is needed
+        const auto work = [this, &f](std::mt19937 &gen, const size_t i) {
+            const size_t cx = i / (_chunk_scale * _chunk_scale);
+            const size_t cy = (i / _chunk_scale) % _chunk_scale;
+            const size_t cz = i % _chunk_scale;
+            const min::tri<size_t> start(cx * _chunk_size, cy * _chunk_size, cz * _chunk_size);
+
+            // Generate the chunk cells into scratch, rows along Z are contiguous
+            std::vector<block_id> cells(_chunk_cells, block_id::EMPTY);
+            f(start, cells);
+
+            // Load the chunk from the scratch cells
+            _chunks[i].load(_chunk_cells, [&cells](const size_t cell) -> block_id {
+                return cells[cell];
+            });
+        };
+
+        // Run the job in parallel
+        pool.run(std::cref(work), 0, _chunks.size());
+
+        // Every chunk was overwritten
+        set_resident();
+    }
+    inline block_id get(const size_t key) const
+    {
+        return get(grid_index(key));
+    }
+    inline block_id get(const min::tri<size_t> &index) const
+    {
+        const size_t x = index.x();
+        const size_t y = index.y();
+        const size_t z = index.z();
+
+        // Page in the chunk if needed
+        const size_t ckey = chunk_key(x, y, z);
+        page(ckey);
+
+        return _chunks[ckey].get(cell_key(x, y, z));
+    }
+    inline palette_chunk &get_chunk(const size_t chunk_key)
+    {
+        page(chunk_key);
+        return _chunks[chunk_key];
+    }
+    inline const palette_chunk &get_chunk(const size_t chunk_key) const
+    {
+        page(chunk_key);
+        return _chunks[chunk_key];
+    }
+    inline size_t get_chunk_cells() const
+    {
+        return _chunk_cells;
+    }
+    inline size_t get_chunks() const
+    {
+        return _chunks.size();
+    }
+    inline void load(min::thread_pool &pool, const std::vector<block_id> &dense)
+    {
+        // Compress each chunk from the dense grid in parallel
+        generate(pool, [this, &dense](const min::tri<size_t> &start, std::vector<block_id> &cells) {
+            // Gather the chunk cells into contiguous memory
+            const size_t first = (start.x() * _grid_scale2) + (start.y() * _grid_scale) + start.z();
+            for (size_t x = 0, c = 0; x < _chunk_size; x++)
+            {
+                for (size_t y = 0; y < _chunk_size; y++, c += _chunk_size)
+                {
+                    const size_t row = first + (x * _grid_scale2) + (y * _grid_scale);
+                    std::copy(dense.begin() + row, dense.begin() + row + _chunk_size, cells.begin() + c);
+                }
+            }
+        });
+    }
+    inline bool is_resident(const size_t chunk_key) const
+    {
+        return _resident[chunk_key];
+    }
+    inline void page(const size_t chunk_key) const
+    {
+        // Load the chunk on first access, not thread safe
+        if (!_resident[chunk_key])
+        {
+            _resident[chunk_key] = true;
+            _pager(chunk_key, _chunks[chunk_key]);
+        }
+    }
+    inline void page_apron(const size_t chunk_key) const
+    {
+        // Unpack the chunk components
+        const size_t sc = _chunk_scale;
+        const size_t sc2 = sc * sc;
+        const size_t cx = chunk_key / sc2;
+        const size_t cy = (chunk_key / sc) % sc;
+        const size_t cz = chunk_key % sc;
+
+        // Load the chunk and the six face neighbors read by copy_apron
+        page(chunk_key);
+        if (cx > 0)
+        {
+            page(chunk_key - sc2);
+        }
+        if (cx + 1 < sc)
+        {
+            page(chunk_key + sc2);
+        }
+        if (cy > 0)
+        {
+            page(chunk_key - sc);
+        }
+        if (cy + 1 < sc)
+        {
+            page(chunk_key + sc);
+        }
+        if (cz > 0)
+        {
+            page(chunk_key - 1);
+        }
+        if (cz + 1 < sc)
+        {
+            page(chunk_key + 1);
+        }
+    }
+    inline void page_all() const
+    {
+        // Load every chunk that is not yet resident
+        const size_t chunks = _chunks.size();
+        for (size_t i = 0; i < chunks; i++)
+        {
+            page(i);
+        }
+    }
+    inline size_t resident() const
+    {
+        return static_cast<size_t>(std::count(_resident.begin(), _resident.end(), true));
+    }
+    inline void set(const size_t key, const block_id value)
+    {
+        set(grid_index(key), value);
+    }
+    inline void set(const min::tri<size_t> &index, const block_id value)
+    {
+        const size_t x = index.x();
+        const size_t y = index.y();
+        const size_t z = index.z();
+
+        // Page in the chunk if needed
+        const size_t ckey = chunk_key(x, y, z);
+        page(ckey);
+
+        _chunks[ckey].set(cell_key(x, y, z), _chunk_cells, value);
+    }
+    inline void set_pager(const std::function<void(const size_t, palette_chunk &)> &pager)
+    {
+        // Release all chunks, they will be loaded on first access
+        for (auto &c : _chunks)
+        {
+            c.clear();
+        }
+        std::fill(_resident.begin(), _resident.end(), false);
+        _pager = pager;
+    }
+    inline size_t size() const
+    {
+        return _grid_scale2 * _grid_scale;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,109 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_COUNTER_RNG_BDS_
+#define _BDS_COUNTER_RNG_BDS_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace game
+{
+
+// Random streams used by the world generators, every stream is derived from the world seed
+enum class seed_stream : uint64_t
+{
+    perlin = 1,
+    dope = 2,
+    creative = 3,
+    height_map = 4,
+    terrain = 5,
+    trees = 6,
+    plants = 7,
+    portal = 8,
+    next_world = 9
+};
+
+class counter_rng
+{
+  private:
+    uint64_t _key;
+    uint64_t _counter;
+
+    static inline uint64_t mix(uint64_t z)
+    {
+        // SplitMix64 finalizer
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+  public:
+    typedef uint32_t result_type;
+
+    counter_rng(const uint64_t seed, const uint64_t index)
+        : _key(mix(seed + mix(index + 0x9E3779B97F4A7C15ull))), _counter(0) {}
+
+    static inline uint64_t derive(const uint64_t seed, const seed_stream stream)
+    {
+        // Seed of a generator stream
+        return mix(seed ^ mix(static_cast<uint64_t>(stream) * 0x9E3779B97F4A7C15ull));
+    }
+    inline void discard(const uint64_t n)
+    {
+        // Skip draws, each draw only depends on its counter
+        _counter += n;
+    }
+    static constexpr result_type max()
+    {
+        return 0xFFFFFFFF;
+    }
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+    inline uint64_t next64()
+    {
+        // Hash the key with the draw counter, no state is shared between streams
+        return mix(_key + (++_counter) * 0x9E3779B97F4A7C15ull);
+    }
+    inline result_type operator()()
+    {
+        return static_cast<result_type>(next64() >> 32);
+    }
+    inline int uniform(const int low, const int high)
+    {
+        // Map 32 random bits onto [low, high], the bias is negligible for small ranges
+        const uint64_t range = static_cast<uint64_t>(high - low) + 1;
+        return low + static_cast<int>((static_cast<uint64_t>((*this)()) * range) >> 32);
+    }
+    inline size_t uniform(const size_t low, const size_t high)
+    {
+        // Map 32 random bits onto [low, high]
+        const uint64_t range = static_cast<uint64_t>(high - low) + 1;
+        return low + static_cast<size_t>((static_cast<uint64_t>((*this)()) * range) >> 32);
+    }
+    inline float uniform(const float low, const float high)
+    {
+        // 24 random bits convert to [0, 1) exactly, so the result only depends on float rounding
+        const float unit = static_cast<float>(next64() >> 40) * (1.0f / 16777216.0f);
+        return low + (high - low) * unit;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,278 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_DELTA_FILE_BDS_
+#define _BDS_DELTA_FILE_BDS_
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <game/chunk_store.h>
+#include <game/file.h>
+#include <game/id.h>
+#include <iostream>
+#include <min/serial.h>
+#include <string>
+#include <vector>
+
+namespace game
+{
+
+enum class world_type : uint8_t
+{
+    normal = 0,
+    creative = 1,
+    portal = 2
+};
+
+class delta_file
+{
+  private:
+    static constexpr uint32_t _magic = 0x44534442;
+    static constexpr uint32_t _version = 3;
+    static constexpr size_t _header_size = 6 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const uint32_t _generator;
+    world_type _type;
+    uint64_t _seed;
+    std::vector<size_t> _keys;
+    std::vector<block_id> _ids;
+    bool _stale;
+
+    static inline bool read_varint(const std::vector<uint8_t> &stream, size_t &next, uint64_t &value)
+    {
+        // Seven bits per byte, high bit set on all but the last byte
+        value = 0;
+        const size_t size = stream.size();
+        for (unsigned shift = 0; shift < 64 && next < size; shift += 7)
+        {
+            const uint8_t byte = stream[next++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+
+        // Truncated or overlong
+        return false;
+    }
+    static inline void write_varint(std::vector<uint8_t> &stream, uint64_t value)
+    {
+        // Seven bits per byte, high bit set on all but the last byte
+        while (value >= 0x80)
+        {
+            stream.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        stream.push_back(static_cast<uint8_t>(value));
+    }
+
+  public:
+    delta_file(const size_t grid_scale, const size_t chunk_size, const uint32_t generator)
+        : _grid_scale(grid_scale), _chunk_size(chunk_size), _generator(generator), _type(world_type::normal), _seed(0), _stale(false) {}
+
+    inline const std::vector<block_id> &get_ids() const
+    {
+        return _ids;
+    }
+    inline const std::vector<size_t> &get_keys() const
+    {
+        return _keys;
+    }
+    inline uint64_t get_seed() const
+    {
+        return _seed;
+    }
+    inline world_type get_type() const
+    {
+        return _type;
+    }
+    inline bool is_stale() const
+    {
+        // The last load found a world saved by another generator
+        return _stale;
+    }
+    static inline bool is_delta_file(const std::string &file_name)
+    {
+        // Check the magic number at the start of the file
+        std::ifstream file(file_name, std::ios::in | std::ios::binary);
+        uint8_t magic[sizeof(uint32_t)] = {};
+        file.read(reinterpret_cast<char *>(magic), sizeof(uint32_t));
+        if (!file)
+        {
+            return false;
+        }
+
+        // Decode the little endian magic number
+        std::vector<uint8_t> stream(magic, magic + sizeof(uint32_t));
+        size_t next = 0;
+        return min::read_le<uint32_t>(stream, next) == _magic;
+    }
+    inline bool load(const std::string &file_name)
+    {
+        // Forget any previous edits
+        _keys.clear();
+        _ids.clear();
+        _stale = false;
+
+        // Read the whole file, it only holds edits
+        std::vector<uint8_t> stream;
+        file::load_file(file_name, stream);
+        if (stream.size() < 2 * sizeof(uint32_t))
+        {
+            std::cout << "delta_file: truncated world file '" << file_name << "'" << std::endl;
+            return false;
+        }
+
+        // Files from older formats were written by an older generator, so the edits can't be trusted
+        size_t next = 0;
+        const uint32_t magic = min::read_le<uint32_t>(stream, next);
+        const uint32_t version = min::read_le<uint32_t>(stream, next);
+        if (magic == _magic && version < _version)
+        {
+            std::cout << "delta_file: world file '" << file_name << "' was saved by an older world generator" << std::endl;
+            _stale = true;
+            return false;
+        }
+        else if (stream.size() < _header_size)
+        {
+            std::cout << "delta_file: truncated world file '" << file_name << "'" << std::endl;
+            return false;
+        }
+
+        // Read and validate the header
+        const uint32_t grid_scale = min::read_le<uint32_t>(stream, next);
+        const uint32_t chunk_size = min::read_le<uint32_t>(stream, next);
+        const uint32_t type = min::read_le<uint32_t>(stream, next);
+        const uint32_t generator = min::read_le<uint32_t>(stream, next);
+        const uint64_t seed = min::read_le<uint64_t>(stream, next);
+        const uint64_t count = min::read_le<uint64_t>(stream, next);
+        if (magic != _magic || version != _version || type > static_cast<uint32_t>(world_type::portal))
+        {
+            std::cout << "delta_file: unsupported world file '" << file_name << "'" << std::endl;
+            return false;
+        }
+        else if (grid_scale != _grid_scale || chunk_size != _chunk_size)
+        {
+            std::cout << "delta_file: world file '" << file_name << "' has wrong dimensions" << std::endl;
+            return false;
+        }
+        else if (generator != _generator)
+        {
+            // The seed would regenerate different terrain under the stored edits
+            std::cout << "delta_file: world file '" << file_name << "' was saved by a different world generator" << std::endl;
+            _stale = true;
+            return false;
+        }
+
+        // Each edit takes at least two bytes
+        if (count > (stream.size() - next) / 2)
+        {
+            std::cout << "delta_file: corrupt world file '" << file_name << "'" << std::endl;
+            return false;
+        }
+
+        // Read the edits, keys are stored as gaps from the previous key
+        const uint64_t cells = static_cast<uint64_t>(_grid_scale) * _grid_scale * _grid_scale;
+        _keys.reserve(count);
+        _ids.reserve(count);
+        uint64_t key = 0;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            // Keys must be increasing and inside the grid
+            uint64_t gap;
+            const bool read = read_varint(stream, next, gap);
+            if (!read || next >= stream.size() || (i > 0 && gap == 0) || gap >= cells - key)
+            {
+                std::cout << "delta_file: corrupt world file '" << file_name << "'" << std::endl;
+                _keys.clear();
+                _ids.clear();
+                return false;
+            }
+
+            // Only known block ids can be written to the grid
+            const block_id id = static_cast<block_id>(static_cast<int8_t>(stream[next++]));
+            if (!valid_block(id))
+            {
+                std::cout << "delta_file: invalid block id in world file '" << file_name << "'" << std::endl;
+                _keys.clear();
+                _ids.clear();
+                return false;
+            }
+            key += gap;
+            _keys.push_back(static_cast<size_t>(key));
+            _ids.push_back(id);
+        }
+
+        // Remember how to regenerate the world
+        _type = static_cast<world_type>(type);
+        _seed = seed;
+
+        return true;
+    }
+    inline void save(const std::string &file_name, const world_type type, const uint64_t seed,
+                     const chunk_store &grid, const std::vector<size_t> &keys) const
+    {
+        // Write the header
+        std::vector<uint8_t> stream;
+        stream.reserve(_header_size + keys.size() * 3);
+        min::write_le<uint32_t>(stream, _magic);
+        min::write_le<uint32_t>(stream, _version);
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(_grid_scale));
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(_chunk_size));
+        min::write_le<uint32_t>(stream, static_cast<uint32_t>(type));
+        min::write_le<uint32_t>(stream, _generator);
+        min::write_le<uint64_t>(stream, seed);
+        min::write_le<uint64_t>(stream, keys.size());
+
+        // Write the current value of every edited cell, keys must be sorted and unique
+        size_t last = 0;
+        for (const size_t k : keys)
+        {
+            write_varint(stream, k - last);
+            stream.push_back(static_cast<uint8_t>(static_cast<int8_t>(grid.get(k))));
+            last = k;
+        }
+
+        // Write data to a temporary file, the old world stays intact until it is complete
+        const std::string temp_name = file_name + ".tmp";
+        std::ofstream file(temp_name, std::ios::out | std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(stream.data()), stream.size());
+        file.close();
+        if (!file)
+        {
+            std::cout << "delta_file: could not save file '" << temp_name << "'" << std::endl;
+            std::remove(temp_name.c_str());
+            return;
+        }
+
+        // Replace the old world with the new one, the old world is kept until the new one is in place
+        if (!file::replace_file(temp_name, file_name))
+        {
+            std::cout << "delta_file: could not replace file '" << file_name << "'" << std::endl;
+            return;
+        }
+
+        // Print diagnostic message
+        std::cout << "delta_file: saved " << keys.size() << " edits to " << file_name << std::endl;
+    }
+};
+}
+
+#endif
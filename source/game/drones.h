@@ -130,7 +130,7 @@ class drone
     }
     inline min::vec3<float> step(cgrid &grid, const float speed)
     {
-        return get_path().step(grid) * speed;
+        return get_path().step(grid, _path_id) * speed;
     }
 };
 
@@ -366,6 +366,17 @@ class drones
         // Update drone paths
         if (!_disable)
         {
+            // Path searches share a node budget per frame, drones share a flow field toward the destination
+            if (size > 0)
+            {
+                grid.path_frame(_dest);
+
+                // Hand paths searched on worker threads to their drones
+                grid.path_results([this](const size_t id, const size_t ticket, const std::vector<min::vec3<float>> &points) {
+                    _paths[id].set_path(ticket, points);
+                });
+            }
+
             for (size_t i = 0; i < size; i++)
             {
                 // Get the drone
@@ -180,6 +180,32 @@ class file
             std::cout << "file: could not load file '" << file_name << "'" << std::endl;
         }
     }
+    static inline bool replace_file(const std::string &temp_name, const std::string &file_name)
+    {
+        // Most platforms rename over an existing file in one step
+        if (std::rename(temp_name.c_str(), file_name.c_str()) == 0)
+        {
+            return true;
+        }
+
+        // Else move the old file aside, it is put back if the new file can't take its place
+        const std::string backup_name = file_name + ".bak";
+        std::remove(backup_name.c_str());
+        if (std::rename(file_name.c_str(), backup_name.c_str()) != 0)
+        {
+            std::remove(temp_name.c_str());
+            return false;
+        }
+        if (std::rename(temp_name.c_str(), file_name.c_str()) != 0)
+        {
+            std::rename(backup_name.c_str(), file_name.c_str());
+            std::remove(temp_name.c_str());
+            return false;
+        }
+        std::remove(backup_name.c_str());
+
+        return true;
+    }
     static inline void save_file(const std::string &file_name, const std::vector<uint8_t> &stream)
     {
         // Save bytes to file
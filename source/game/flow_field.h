@@ -0,0 +1,343 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_FLOW_FIELD_BDS_
+#define _BDS_FLOW_FIELD_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <game/chunk_store.h>
+#include <game/id.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace game
+{
+
+class flow_field
+{
+  private:
+    constexpr static size_t _path_limit = 20;
+    constexpr static uint16_t _unreached = 0xFFFF;
+    const size_t _grid_scale;
+    const size_t _grid_scale2;
+    const size_t _radius;
+    const size_t _width;
+    const size_t _width2;
+    std::vector<uint16_t> _dist;
+    std::vector<uint16_t> _back;
+    std::vector<uint32_t> _queue;
+    std::vector<size_t> _path;
+    min::tri<size_t> _origin;
+    min::tri<size_t> _back_origin;
+    size_t _goal_key;
+    size_t _field_goal;
+    size_t _back_goal;
+    size_t _head;
+    size_t _budget;
+    bool _ready;
+    bool _building;
+    bool _dirty;
+
+    inline bool inside(const min::tri<size_t> &index, const min::tri<size_t> &origin) const
+    {
+        // Is the grid index inside the field region starting at origin
+        return index.x() >= origin.x() && index.x() < origin.x() + _width
+               && index.y() >= origin.y() && index.y() < origin.y() + _width
+               && index.z() >= origin.z() && index.z() < origin.z() + _width;
+    }
+    inline size_t local(const min::tri<size_t> &index, const min::tri<size_t> &origin) const
+    {
+        return (index.x() - origin.x()) * _width2 + (index.y() - origin.y()) * _width + (index.z() - origin.z());
+    }
+    inline size_t region_start(const size_t goal) const
+    {
+        // Keep the whole region inside the grid
+        return std::min(goal - std::min(goal, _radius), _grid_scale - _width);
+    }
+    inline void relax(const chunk_store &grid, const size_t key, const size_t cell, const uint16_t d)
+    {
+        // Skip cells already reached, the queue reaches them in distance order
+        if (_back[cell] != _unreached)
+        {
+            return;
+        }
+
+        // Only fly through empty cells
+        if (grid.get(key) != block_id::EMPTY)
+        {
+            return;
+        }
+
+        _back[cell] = d;
+        _queue.push_back(static_cast<uint32_t>(cell));
+    }
+    inline void start(const chunk_store &grid)
+    {
+        // The goal can't be reached if it is inside terrain
+        _dirty = false;
+        if (grid.get(_goal_key) != block_id::EMPTY)
+        {
+            _ready = false;
+            return;
+        }
+
+        // Center the region on the goal
+        _back_goal = _goal_key;
+        const min::tri<size_t> goal = min::vec3<float>::grid_index(_goal_key, _grid_scale);
+        _back_origin = min::tri<size_t>(region_start(goal.x()), region_start(goal.y()), region_start(goal.z()));
+
+        // Seed the breadth first search with the goal
+        std::fill(_back.begin(), _back.end(), static_cast<uint16_t>(_unreached));
+        _queue.clear();
+        _head = 0;
+        const size_t cell = local(goal, _back_origin);
+        _back[cell] = 0;
+        _queue.push_back(static_cast<uint32_t>(cell));
+        _building = true;
+    }
+    inline void step(const chunk_store &grid)
+    {
+        // Spread the search over frames, drones read the last finished field meanwhile
+        const size_t stop = _head + _budget;
+        const size_t edge = _width - 1;
+        const min::tri<size_t> &o = _back_origin;
+        while (_head < _queue.size() && _head < stop)
+        {
+            // Pop the nearest cell
+            const size_t cell = _queue[_head++];
+            const uint16_t d = static_cast<uint16_t>(_back[cell] + 1);
+
+            // Distances past the limit are left unreached
+            if (d == _unreached)
+            {
+                continue;
+            }
+
+            // Open the six face neighbors inside the region
+            const size_t lx = cell / _width2;
+            const size_t ly = (cell / _width) % _width;
+            const size_t lz = cell % _width;
+            const size_t key = (o.x() + lx) * _grid_scale2 + (o.y() + ly) * _grid_scale + (o.z() + lz);
+            if (lx != 0)
+            {
+                relax(grid, key - _grid_scale2, cell - _width2, d);
+            }
+            if (lx != edge)
+            {
+                relax(grid, key + _grid_scale2, cell + _width2, d);
+            }
+            if (ly != 0)
+            {
+                relax(grid, key - _grid_scale, cell - _width, d);
+            }
+            if (ly != edge)
+            {
+                relax(grid, key + _grid_scale, cell + _width, d);
+            }
+            if (lz != 0)
+            {
+                relax(grid, key - 1, cell - 1, d);
+            }
+            if (lz != edge)
+            {
+                relax(grid, key + 1, cell + 1, d);
+            }
+        }
+
+        // Swap in the finished field
+        if (_head == _queue.size())
+        {
+            _dist.swap(_back);
+            _origin = _back_origin;
+            _field_goal = _back_goal;
+            _ready = true;
+            _building = false;
+        }
+    }
+
+  public:
+    flow_field(const size_t grid_scale, const size_t radius)
+        : _grid_scale(grid_scale), _grid_scale2(grid_scale * grid_scale),
+          _radius(radius), _width(std::min(2 * radius + 1, grid_scale)), _width2(_width * _width),
+          _dist(_width2 * _width, static_cast<uint16_t>(_unreached)), _back(_width2 * _width, static_cast<uint16_t>(_unreached)),
+          _origin(0, 0, 0), _back_origin(0, 0, 0),
+          _goal_key(0), _field_goal(0), _back_goal(0), _head(0), _budget(16384), _ready(false), _building(false), _dirty(false)
+    {
+        // Reserve memory for a search
+        _queue.reserve(_width2 * _width);
+        _path.reserve(_path_limit + 1);
+    }
+    inline void clear()
+    {
+        // Forget the field, the next frame starts a new one
+        _path.clear();
+        _queue.clear();
+        _head = 0;
+        _ready = false;
+        _building = false;
+        _dirty = true;
+    }
+    inline void edit(const min::tri<size_t> &index)
+    {
+        // Rebuild if terrain changed inside the field
+        if ((_ready && inside(index, _origin)) || (_building && inside(index, _back_origin)))
+        {
+            _dirty = true;
+        }
+    }
+    inline uint16_t get_distance(const size_t key) const
+    {
+        // Steps from the cell to the goal of the last finished field
+        const min::tri<size_t> index = min::vec3<float>::grid_index(key, _grid_scale);
+        if (!_ready || !inside(index, _origin))
+        {
+            return _unreached;
+        }
+
+        return _dist[local(index, _origin)];
+    }
+    inline const std::vector<size_t> &get_path() const
+    {
+        return _path;
+    }
+    inline bool is_building() const
+    {
+        return _building;
+    }
+    inline bool is_ready() const
+    {
+        return _ready;
+    }
+    inline bool path(const chunk_store &grid, const size_t start_key, const size_t stop_key)
+    {
+        // Only drones heading for the goal the finished field was built for can use it
+        _path.clear();
+        if (!_ready || stop_key != _field_goal)
+        {
+            return false;
+        }
+
+        // The start must be reached by the field and not already at its goal
+        const min::tri<size_t> start = min::vec3<float>::grid_index(start_key, _grid_scale);
+        if (!inside(start, _origin))
+        {
+            return false;
+        }
+        size_t cell = local(start, _origin);
+        if (_dist[cell] == _unreached || _dist[cell] == 0)
+        {
+            return false;
+        }
+
+        // Walk downhill, cells filled in since the field was built are avoided
+        const size_t edge = _width - 1;
+        size_t key = start_key;
+        _path.push_back(key);
+        while (_dist[cell] != 0 && _path.size() <= _path_limit)
+        {
+            // Find a face neighbor one step closer to the goal
+            const uint16_t next = _dist[cell] - 1;
+            const size_t lx = cell / _width2;
+            const size_t ly = (cell / _width) % _width;
+            const size_t lz = cell % _width;
+            size_t step_key = key;
+            size_t step_cell = cell;
+            const auto downhill = [&grid, next, &step_key, &step_cell, key, this](const size_t k, const size_t c) -> void {
+                if (step_key == key && _dist[c] == next && grid.get(k) == block_id::EMPTY)
+                {
+                    step_key = k;
+                    step_cell = c;
+                }
+            };
+            if (lx != 0)
+            {
+                downhill(key - _grid_scale2, cell - _width2);
+            }
+            if (lx != edge)
+            {
+                downhill(key + _grid_scale2, cell + _width2);
+            }
+            if (ly != 0)
+            {
+                downhill(key - _grid_scale, cell - _width);
+            }
+            if (ly != edge)
+            {
+                downhill(key + _grid_scale, cell + _width);
+            }
+            if (lz != 0)
+            {
+                downhill(key - 1, cell - 1);
+            }
+            if (lz != edge)
+            {
+                downhill(key + 1, cell + 1);
+            }
+
+            // Stop if the way down was filled in
+            if (step_key == key)
+            {
+                break;
+            }
+
+            key = step_key;
+            cell = step_cell;
+            _path.push_back(key);
+        }
+
+        // Fall back to searching if the field gives no step
+        if (_path.size() < 2)
+        {
+            _path.clear();
+            return false;
+        }
+
+        return true;
+    }
+    inline void set_budget(const size_t cells)
+    {
+        _budget = cells;
+    }
+    inline void set_goal(const size_t goal_key)
+    {
+        // Rebuild when the goal moves to another cell
+        if (goal_key != _goal_key)
+        {
+            _goal_key = goal_key;
+            _dirty = true;
+        }
+    }
+    inline void update(const chunk_store &grid)
+    {
+        // Start a new field when the goal moved or terrain changed, and no field is being built
+        if (_dirty && !_building)
+        {
+            start(grid);
+        }
+
+        // Continue building the field
+        if (_building)
+        {
+            step(grid);
+        }
+    }
+};
+}
+
+#endif
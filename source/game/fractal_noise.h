@@ -0,0 +1,203 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_FRACTAL_NOISE_BDS_
+#define _BDS_FRACTAL_NOISE_BDS_
+
+#include <cmath>
+#include <game/perlin.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace kernel
+{
+
+enum class fractal_type
+{
+    fbm,
+    ridged
+};
+
+class fractal_noise
+{
+  private:
+    perlin_noise _noise;
+    float _frequency;
+    fractal_type _type;
+    size_t _octaves;
+    float _warp;
+    std::vector<float> _amplitude;
+    std::vector<float> _scale;
+    std::vector<float> _offset;
+    float _norm;
+
+    inline float shape(const float p) const
+    {
+        // Ridged noise folds the signal around its mean
+        if (_type == fractal_type::ridged)
+        {
+            const float r = 1.0f - std::abs(2.0f * p - 1.0f);
+            return r * r;
+        }
+
+        return p;
+    }
+    inline void accumulate(const size_t octave, const float *row, const size_t n, float *out) const
+    {
+        // First octave overwrites the output, the rest add to it
+        const float a = _amplitude[octave];
+        if (octave == 0)
+        {
+            for (size_t k = 0; k < n; k++)
+            {
+                out[k] = a * shape(row[k]);
+            }
+        }
+        else
+        {
+            for (size_t k = 0; k < n; k++)
+            {
+                out[k] += a * shape(row[k]);
+            }
+        }
+    }
+
+  public:
+    fractal_noise(const uint64_t seed, const float frequency, const fractal_type type, const size_t octaves,
+                  const float lacunarity = 2.0, const float gain = 0.5, const float warp = 0.0)
+        : _noise(seed), _frequency(frequency), _type(type), _octaves(octaves), _warp(warp),
+          _amplitude(octaves), _scale(octaves), _offset(octaves), _norm(0.0)
+    {
+        // Each octave is scaled by lacunarity, weighted by gain and shifted off the lattice of the previous octave
+        float a = 1.0;
+        float s = 1.0;
+        float sum = 0.0;
+        for (size_t o = 0; o < octaves; o++)
+        {
+            _amplitude[o] = a;
+            _scale[o] = s;
+            _offset[o] = o * 19.37f;
+            sum += a;
+            a *= gain;
+            s *= lacunarity;
+        }
+
+        // Normalize the weighted sum back to [0, 1]
+        _norm = 1.0f / sum;
+    }
+    inline void brick(const min::tri<size_t> &start, const size_t nx, const size_t ny, const size_t nz, float *out) const
+    {
+        // Lattice coordinates of the brick cells
+        std::vector<float> x(nx);
+        std::vector<float> y(ny);
+        std::vector<float> z(nz);
+        for (size_t i = 0; i < nx; i++)
+        {
+            x[i] = (start.x() + i) * _frequency;
+        }
+        for (size_t j = 0; j < ny; j++)
+        {
+            y[j] = (start.y() + j) * _frequency;
+        }
+        for (size_t k = 0; k < nz; k++)
+        {
+            z[k] = (start.z() + k) * _frequency;
+        }
+
+        // Z coordinates of every octave are shared by all rows
+        std::vector<float> zo(_octaves * nz);
+        for (size_t o = 0; o < _octaves; o++)
+        {
+            for (size_t k = 0; k < nz; k++)
+            {
+                zo[o * nz + k] = z[k] * _scale[o] + _offset[o];
+            }
+        }
+
+        // Scratch rows for the samples of one octave and the warped coordinates
+        std::vector<float> row(nz);
+        std::vector<float> wx;
+        std::vector<float> wy;
+        std::vector<float> wz;
+        std::vector<float> px;
+        std::vector<float> py;
+        std::vector<float> pz;
+        if (_warp > 0.0)
+        {
+            wx.resize(nz);
+            wy.resize(nz);
+            wz.resize(nz);
+            px.resize(nz);
+            py.resize(nz);
+            pz.resize(nz);
+        }
+
+        // All octaves of a row are summed while the row is in cache
+        for (size_t i = 0; i < nx; i++)
+        {
+            for (size_t j = 0; j < ny; j++)
+            {
+                float *const dst = &out[(i * ny + j) * nz];
+                if (_warp > 0.0)
+                {
+                    // Displace the row by three decorrelated noise fields, always forward so coordinates stay positive
+                    _noise.perlin_row(x[i] + 101.3f, y[j] + 101.3f, &zo[0], nz, wx.data());
+                    _noise.perlin_row(x[i] + 203.7f, y[j] + 203.7f, &zo[0], nz, wy.data());
+                    _noise.perlin_row(x[i] + 307.1f, y[j] + 307.1f, &zo[0], nz, wz.data());
+                    for (size_t o = 0; o < _octaves; o++)
+                    {
+                        for (size_t k = 0; k < nz; k++)
+                        {
+                            px[k] = (x[i] + _warp * wx[k]) * _scale[o] + _offset[o];
+                            py[k] = (y[j] + _warp * wy[k]) * _scale[o] + _offset[o];
+                            pz[k] = (z[k] + _warp * wz[k]) * _scale[o] + _offset[o];
+                        }
+                        _noise.perlin_points(px.data(), py.data(), pz.data(), nz, row.data());
+                        accumulate(o, row.data(), nz, dst);
+                    }
+                }
+                else
+                {
+                    for (size_t o = 0; o < _octaves; o++)
+                    {
+                        const float xs = x[i] * _scale[o] + _offset[o];
+                        const float ys = y[j] * _scale[o] + _offset[o];
+                        _noise.perlin_row(xs, ys, &zo[o * nz], nz, row.data());
+                        accumulate(o, row.data(), nz, dst);
+                    }
+                }
+
+                // Normalize the octave sum
+                for (size_t k = 0; k < nz; k++)
+                {
+                    dst[k] *= _norm;
+                }
+            }
+        }
+    }
+    inline size_t get_octaves() const
+    {
+        return _octaves;
+    }
+    inline void set_simd(const simd_level level)
+    {
+        _noise.set_simd(level);
+    }
+};
+}
+
+#endif
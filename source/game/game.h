@@ -223,6 +223,8 @@ class bds
         const float energy = stat.get_energy();
         const size_t chunks = _world.get_chunks_in_view();
         const size_t insts = _world.get_inst_in_view();
+        const size_t paths = _world.get_path_depth();
+        const double latency = _world.get_path_latency();
 
         // Check if player gave damage
         if (stat.is_crit())
@@ -260,7 +262,7 @@ class bds
         _ui.set_draw_timer((time > 0.0) && !_ui.is_focused());
 
         // Update the ui overlay, process timer and upload changes
-        _ui.update(p, f, health, energy, _fps, _idle, chunks, insts, *info.first, time, dt);
+        _ui.update(p, f, health, energy, _fps, _idle, chunks, insts, paths, latency, *info.first, time, dt);
     }
     void update_uniforms(min::camera<float> &camera, const bool update_bones)
     {
@@ -18,6 +18,8 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_GEOMETRY_BDS_
 #define _BDS_GEOMETRY_BDS_
 
+#include <cassert>
+#include <cstdint>
 #include <min/vec2.h>
 #include <min/vec3.h>
 #include <min/vec4.h>
@@ -151,172 +153,78 @@ inline void block_index(std::vector<T> &index, size_t i, const T vertex_start)
     index[i++] = 23 + vertex_start;
     index[i++] = 16 + vertex_start;
 }
-inline void face_vertex(std::vector<min::vec4<float>> &vertex, size_t i, const min::vec3<float> &min, const min::vec3<float> &max, const int_fast8_t face_type)
+inline float face_code(const int_fast8_t face_type, const int_fast8_t atlas_id)
 {
-    switch (face_type)
-    {
-    case 0:
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), 1.0);
-        break;
-    case 1:
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), 1.0);
-        break;
-    case 2:
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), 1.0);
-        break;
-    case 3:
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), 1.0);
-        break;
-    case 4:
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), min.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), 1.0);
-        break;
-    case 5:
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), 1.0);
-        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), 1.0);
-        break;
-    }
+    // Face type in the low three bits, atlas id above
+    return face_type + (atlas_id << 3);
 }
-inline void face_uv(std::vector<min::vec2<float>> &uv, size_t i, const int_fast8_t face_type, const int_fast8_t atlas_id)
+inline uint32_t face_pack(const min::vec4<float> &v)
 {
-    // Calculate grid index
-    const size_t col = atlas_id % 8;
-    const size_t row = atlas_id / 8;
-    const float x_offset = 0.001 + 0.125 * col;
-    const float y_offset = 0.001 + (1.0 - 0.125 * (row + 1));
+    // Positions are chunk local corners in [0, 127], face codes hold a 3 bit face and a 6 bit atlas id
+    assert(v.x() >= 0.0 && v.x() < 128.0 && v.y() >= 0.0 && v.y() < 128.0 && v.z() >= 0.0 && v.z() < 128.0);
+    assert(v.w() >= 0.0 && v.w() < 512.0);
 
-    switch (face_type)
-    {
-    case 0:
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        break;
-    case 1:
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        break;
-    case 2:
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        break;
-    case 3:
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        break;
-    case 4:
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        break;
-    case 5:
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.0) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.124, 0.124) + min::vec2<float>(x_offset, y_offset);
-        uv[i++] = min::vec2<float>(0.0, 0.124) + min::vec2<float>(x_offset, y_offset);
-        break;
-    }
+    // Bits 0-6 x, 7-13 y, 14-20 z, 21-23 face, 24-29 atlas, as unpacked by data/shader/terrain.vertex
+    // Convert through int32_t, a negative float converted to unsigned is undefined
+    const uint32_t x = static_cast<uint32_t>(static_cast<int32_t>(v.x())) & 0x7F;
+    const uint32_t y = (static_cast<uint32_t>(static_cast<int32_t>(v.y())) & 0x7F) << 7;
+    const uint32_t z = (static_cast<uint32_t>(static_cast<int32_t>(v.z())) & 0x7F) << 14;
+    const uint32_t code = (static_cast<uint32_t>(static_cast<int32_t>(v.w())) & 0x1FF) << 21;
+
+    return x | y | z | code;
 }
-inline void face_normal(std::vector<min::vec3<float>> &normal, size_t i, const int_fast8_t face_type)
+inline void face_vertex(std::vector<min::vec4<float>> &vertex, size_t i, const min::vec3<float> &min, const min::vec3<float> &max, const int_fast8_t face_type, const float code)
 {
-
+    // The face code is stored in w
     switch (face_type)
     {
     case 0:
-        normal[i++] = min::vec3<float>(-1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(-1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(-1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(-1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(-1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(-1.0, 0.0, 0.0);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), code);
         break;
     case 1:
-        normal[i++] = min::vec3<float>(1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(1.0, 0.0, 0.0);
-        normal[i++] = min::vec3<float>(1.0, 0.0, 0.0);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), code);
         break;
     case 2:
-        normal[i++] = min::vec3<float>(0.0, -1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, -1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, -1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, -1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, -1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, -1.0, 0.0);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), code);
         break;
     case 3:
-        normal[i++] = min::vec3<float>(0.0, 1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, 1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, 1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, 1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, 1.0, 0.0);
-        normal[i++] = min::vec3<float>(0.0, 1.0, 0.0);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), code);
         break;
     case 4:
-        normal[i++] = min::vec3<float>(0.0, 0.0, -1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, -1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, -1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, -1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, -1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, -1.0);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), min.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), min.z(), code);
         break;
     case 5:
-        normal[i++] = min::vec3<float>(0.0, 0.0, 1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, 1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, 1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, 1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, 1.0);
-        normal[i++] = min::vec3<float>(0.0, 0.0, 1.0);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), max.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(min.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), min.y(), max.z(), code);
+        vertex[i++] = min::vec4<float>(max.x(), max.y(), max.z(), code);
         break;
     }
 }
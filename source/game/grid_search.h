@@ -0,0 +1,253 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_GRID_SEARCH_BDS_
+#define _BDS_GRID_SEARCH_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <game/chunk_store.h>
+#include <game/id.h>
+#include <game/search_map.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace game
+{
+
+struct search_node
+{
+    size_t parent;
+    uint32_t g;
+    bool closed;
+};
+
+struct search_open
+{
+    uint32_t f;
+    uint32_t h;
+    size_t key;
+};
+
+class grid_search
+{
+  private:
+    constexpr static size_t _path_limit = 20;
+    const size_t _grid_scale;
+    const size_t _grid_scale2;
+    search_map<search_node> _nodes;
+    std::vector<search_open> _open;
+    std::vector<size_t> _path;
+    size_t _budget;
+    size_t _expanded;
+    bool _found;
+
+    static inline bool open_greater(const search_open &a, const search_open &b)
+    {
+        // Lowest cost first, ties go to the node closest to the goal
+        return (a.f > b.f) || (a.f == b.f && a.h > b.h);
+    }
+    static inline uint32_t distance(const size_t a, const size_t b)
+    {
+        return static_cast<uint32_t>((a > b) ? a - b : b - a);
+    }
+    inline uint32_t heuristic(const min::tri<size_t> &index, const min::tri<size_t> &stop) const
+    {
+        // Manhattan distance never overestimates with six unit cost moves
+        return distance(index.x(), stop.x()) + distance(index.y(), stop.y()) + distance(index.z(), stop.z());
+    }
+    inline void push(const size_t key, const size_t parent, const uint32_t g, const uint32_t h)
+    {
+        // Open the node, stale heap entries are skipped when popped
+        _nodes.insert(key, search_node{parent, g, false});
+        _open.push_back(search_open{g + h, h, key});
+        std::push_heap(_open.begin(), _open.end(), open_greater);
+    }
+    template <typename G>
+    inline void relax(const G &grid, const size_t key, const size_t parent, const uint32_t g, const min::tri<size_t> &stop)
+    {
+        // Skip closed nodes and nodes already reached as cheaply
+        const search_node *node = _nodes.find(key);
+        if (node && (node->closed || node->g <= g))
+        {
+            return;
+        }
+
+        // Only fly through empty cells
+        if (grid.get(key) != block_id::EMPTY)
+        {
+            return;
+        }
+
+        push(key, parent, g, heuristic(min::vec3<float>::grid_index(key, _grid_scale), stop));
+    }
+    inline void trace(size_t key, const size_t start_key)
+    {
+        // Walk back to the start and keep the first steps of the route
+        _path.clear();
+        _path.push_back(key);
+        while (key != start_key)
+        {
+            key = _nodes.find(key)->parent;
+            _path.push_back(key);
+        }
+        std::reverse(_path.begin(), _path.end());
+
+        // Drones follow a short horizon and search again from there
+        if (_path.size() > _path_limit + 1)
+        {
+            _path.resize(_path_limit + 1);
+        }
+    }
+
+  public:
+    grid_search(const size_t grid_scale)
+        : _grid_scale(grid_scale), _grid_scale2(grid_scale * grid_scale), _nodes(1024),
+          _budget(4096), _expanded(0), _found(false)
+    {
+        // Reserve memory for a search
+        _open.reserve(1024);
+        _path.reserve(_path_limit + 1);
+    }
+    inline void clear()
+    {
+        // Clear out the last search, nodes are reset without touching the table
+        _nodes.clear();
+        _open.clear();
+        _path.clear();
+        _expanded = 0;
+        _found = false;
+    }
+    inline size_t get_budget() const
+    {
+        return _budget;
+    }
+    inline size_t get_expanded() const
+    {
+        return _expanded;
+    }
+    inline const std::vector<size_t> &get_path() const
+    {
+        return _path;
+    }
+    inline size_t get_visited() const
+    {
+        return _nodes.size();
+    }
+    inline bool is_found() const
+    {
+        return _found;
+    }
+    template <typename G>
+    inline void search(const G &grid, const size_t start_key, const size_t stop_key)
+    {
+        // Clear the last search
+        clear();
+
+        // If the start key is inside terrain or we are already there
+        if (grid.get(start_key) != block_id::EMPTY || start_key == stop_key)
+        {
+            return;
+        }
+
+        // Open the start node
+        const min::tri<size_t> stop = min::vec3<float>::grid_index(stop_key, _grid_scale);
+        const uint32_t start_h = heuristic(min::vec3<float>::grid_index(start_key, _grid_scale), stop);
+        push(start_key, start_key, 0, start_h);
+
+        // Track the closed node nearest the goal in case the goal can't be reached
+        size_t best_key = start_key;
+        uint32_t best_h = start_h;
+
+        // Expand nodes until the goal or the budget is reached
+        const size_t edge = _grid_scale - 1;
+        while (!_open.empty() && _expanded < _budget)
+        {
+            // Pop the cheapest open node
+            std::pop_heap(_open.begin(), _open.end(), open_greater);
+            const search_open top = _open.back();
+            _open.pop_back();
+
+            // Skip stale entries of nodes that were reached more cheaply
+            search_node &node = *_nodes.find(top.key);
+            const uint32_t g = top.f - top.h;
+            if (node.closed || g != node.g)
+            {
+                continue;
+            }
+
+            // Close the node, the reference may move when neighbors are opened
+            node.closed = true;
+            _expanded++;
+
+            // Check if we made it to the mother lands!
+            if (top.key == stop_key)
+            {
+                _found = true;
+                best_key = stop_key;
+                break;
+            }
+            else if (top.h < best_h)
+            {
+                best_key = top.key;
+                best_h = top.h;
+            }
+
+            // Open the six face neighbors inside the grid
+            const size_t key = top.key;
+            const min::tri<size_t> index = min::vec3<float>::grid_index(key, _grid_scale);
+            if (index.x() != 0)
+            {
+                relax(grid, key - _grid_scale2, key, g + 1, stop);
+            }
+            if (index.x() != edge)
+            {
+                relax(grid, key + _grid_scale2, key, g + 1, stop);
+            }
+            if (index.y() != 0)
+            {
+                relax(grid, key - _grid_scale, key, g + 1, stop);
+            }
+            if (index.y() != edge)
+            {
+                relax(grid, key + _grid_scale, key, g + 1, stop);
+            }
+            if (index.z() != 0)
+            {
+                relax(grid, key - 1, key, g + 1, stop);
+            }
+            if (index.z() != edge)
+            {
+                relax(grid, key + 1, key, g + 1, stop);
+            }
+        }
+
+        // Route to the goal, or toward the nearest reachable cell if the goal is walled off or over budget
+        if (best_key != start_key)
+        {
+            trace(best_key, start_key);
+        }
+    }
+    inline void set_budget(const size_t query)
+    {
+        _budget = query;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,169 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_HEIGHT_MAP_BDS_
+#define _BDS_HEIGHT_MAP_BDS_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <game/counter_rng.h>
+#include <vector>
+
+namespace game
+{
+
+class height_map
+{
+  private:
+    const size_t _size;
+    std::vector<float> _map;
+
+    inline float &at(const size_t i, const size_t k)
+    {
+        return _map[i * _size + k];
+    }
+    inline float at(const size_t i, const size_t k) const
+    {
+        return _map[i * _size + k];
+    }
+    inline float edge_average(const size_t i, const size_t k, const size_t half) const
+    {
+        // Average the neighbors of an edge midpoint that lie inside the map
+        float sum = 0.0;
+        float count = 0.0;
+        if (i >= half)
+        {
+            sum += at(i - half, k);
+            count++;
+        }
+        if (i + half < _size)
+        {
+            sum += at(i + half, k);
+            count++;
+        }
+        if (k >= half)
+        {
+            sum += at(i, k - half);
+            count++;
+        }
+        if (k + half < _size)
+        {
+            sum += at(i, k + half);
+            count++;
+        }
+
+        return sum / count;
+    }
+    inline void diamond_square(counter_rng &rng, const float lower, const float upper)
+    {
+        // Seed the corners
+        const size_t last = _size - 1;
+        at(0, 0) = rng.uniform(lower, upper);
+        at(0, last) = rng.uniform(lower, upper);
+        at(last, 0) = rng.uniform(lower, upper);
+        at(last, last) = rng.uniform(lower, upper);
+
+        // Halve the displacement every level
+        float range = (upper - lower) * 0.5f;
+        for (size_t step = last; step > 1; step /= 2, range *= 0.5f)
+        {
+            // Diamond step, the center of every square
+            const size_t half = step / 2;
+            for (size_t i = half; i < _size; i += step)
+            {
+                for (size_t k = half; k < _size; k += step)
+                {
+                    const float sum = at(i - half, k - half) + at(i - half, k + half) + at(i + half, k - half) + at(i + half, k + half);
+                    at(i, k) = sum * 0.25f + rng.uniform(-range, range);
+                }
+            }
+
+            // Square step, the midpoint of every edge
+            for (size_t i = 0; i < _size; i += half)
+            {
+                for (size_t k = (i + half) % step; k < _size; k += step)
+                {
+                    at(i, k) = edge_average(i, k, half) + rng.uniform(-range, range);
+                }
+            }
+        }
+
+        // Keep heights inside the requested range
+        for (float &h : _map)
+        {
+            h = std::min(std::max(h, lower), upper);
+        }
+    }
+
+  public:
+    height_map(const uint64_t seed, const size_t level, const float lower, const float upper)
+        : _size((static_cast<size_t>(1) << level) + 1), _map(_size * _size, 0.0)
+    {
+        // Heights only depend on the seed, draws are made in a fixed order
+        counter_rng rng(seed, 0);
+        diamond_square(rng, lower, upper);
+    }
+    inline float get(const size_t i, const size_t k) const
+    {
+        return at(i, k);
+    }
+    inline void gauss_blur_5x5()
+    {
+        // Separable binomial kernel 1 4 6 4 1, edges are clamped
+        const float weight[5] = {1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f};
+        const size_t last = _size - 1;
+        std::vector<float> temp(_map.size());
+
+        // Blur along K
+        for (size_t i = 0; i < _size; i++)
+        {
+            for (size_t k = 0; k < _size; k++)
+            {
+                float sum = 0.0;
+                for (size_t w = 0; w < 5; w++)
+                {
+                    const size_t n = std::min(std::max(k + w, static_cast<size_t>(2)) - 2, last);
+                    sum += at(i, n) * weight[w];
+                }
+                temp[i * _size + k] = sum;
+            }
+        }
+
+        // Blur along I
+        for (size_t i = 0; i < _size; i++)
+        {
+            for (size_t k = 0; k < _size; k++)
+            {
+                float sum = 0.0;
+                for (size_t w = 0; w < 5; w++)
+                {
+                    const size_t n = std::min(std::max(i + w, static_cast<size_t>(2)) - 2, last);
+                    sum += temp[n * _size + k] * weight[w];
+                }
+                at(i, k) = sum;
+            }
+        }
+    }
+    inline size_t size() const
+    {
+        return _size;
+    }
+};
+}
+
+#endif
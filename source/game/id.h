@@ -189,6 +189,14 @@ inline constexpr int_fast8_t id_value(const block_id id)
 {
     return static_cast<int_fast8_t>(id);
 }
+inline constexpr bool valid_block(const block_id id)
+{
+    // Empty or one of the block atlas ids
+    return id == block_id::EMPTY
+           || (id_value(id) >= id_value(block_id::SAND1) && id_value(id) <= id_value(block_id::GREEN_PEPPER))
+           || (id_value(id) >= id_value(block_id::CALCIUM) && id_value(id) <= id_value(block_id::IRIDIUM))
+           || (id_value(id) >= id_value(block_id::SILVER) && id_value(id) <= id_value(block_id::CRYSTAL_G));
+}
 inline constexpr uint_fast8_t id_value(const item_id id)
 {
     return static_cast<uint_fast8_t>(id);
@@ -0,0 +1,112 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_MESH_BATCH_BDS_
+#define _BDS_MESH_BATCH_BDS_
+
+#include <functional>
+#include <game/chunk_store.h>
+#include <game/id.h>
+#include <game/terrain_mesher.h>
+#include <min/mesh.h>
+#include <min/thread_pool.h>
+#include <min/vec3.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace game
+{
+
+class mesh_batch
+{
+  private:
+    std::vector<terrain_mesher> _mesher;
+    std::vector<std::vector<block_id>> _padded;
+
+    static inline size_t default_workers()
+    {
+        // Hardware concurrency may be unknown
+        const size_t threads = std::thread::hardware_concurrency();
+        return (threads > 0) ? threads : 1;
+    }
+
+  public:
+    mesh_batch(const size_t chunk_size, const bool greedy)
+        : mesh_batch(chunk_size, default_workers(), greedy) {}
+    mesh_batch(const size_t chunk_size, const size_t workers, const bool greedy)
+        : _mesher(workers, terrain_mesher(chunk_size)), _padded(workers)
+    {
+        // Check worker count
+        if (workers == 0)
+        {
+            throw std::runtime_error("mesh_batch: workers must be greater than zero");
+        }
+
+        // Select the chunk meshing mode
+        for (auto &m : _mesher)
+        {
+            m.set_greedy(greedy);
+        }
+    }
+    template <typename F>
+    inline void generate(min::thread_pool &pool, const chunk_store &store, const std::vector<size_t> &keys,
+                         std::vector<min::mesh<float, uint32_t>> &meshes, const F &origin)
+    {
+        // Page in every chunk and neighbor up front, paging is not thread safe
+        for (const size_t key : keys)
+        {
+            store.page_apron(key);
+        }
+
+        // Each worker owns a mesher and padded scratch buffer and meshes whole chunks
+        const size_t workers = _mesher.size();
+        const size_t size = keys.size();
+        const auto work = [this, &store, &keys, &meshes, &origin, workers, size](std::mt19937 &gen, const size_t w) {
+            terrain_mesher &mesher = this->_mesher[w];
+            std::vector<block_id> &padded = this->_padded[w];
+
+            // Interleave chunks between workers to balance empty and full chunks
+            for (size_t i = w; i < size; i += workers)
+            {
+                const size_t key = keys[i];
+
+                // Clear the mesh and mesher, vertices are relative to the chunk origin
+                meshes[key].clear();
+                mesher.clear();
+                mesher.set_origin(origin(key));
+
+                // Copy the chunk and its neighbor faces, cells outside the world never expose faces
+                store.copy_apron(key, padded, block_id::INVALID);
+
+                // Generate mesh without touching the worker pool
+                mesher.generate_chunk_padded(padded);
+                mesher.generate_chunk_serial(meshes[key]);
+            }
+        };
+
+        // Run the batch in parallel
+        pool.run(std::cref(work), 0, workers);
+    }
+    inline size_t get_workers() const
+    {
+        return _mesher.size();
+    }
+};
+}
+
+#endif
@@ -0,0 +1,569 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_NAV_GRAPH_BDS_
+#define _BDS_NAV_GRAPH_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <game/grid_search.h>
+#include <game/id.h>
+#include <game/path_snapshot.h>
+#include <game/search_map.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace game
+{
+
+struct nav_chunk
+{
+    // Portals of face f are portal[face[f]] up to portal[face[f + 1]], dist is a portal by portal matrix
+    std::vector<size_t> portal;
+    std::vector<uint16_t> dist;
+    size_t face[7];
+    uint64_t stamp;
+};
+
+class nav_graph
+{
+  private:
+    constexpr static size_t _none = static_cast<size_t>(-1);
+    constexpr static uint16_t _unreached = 0xFFFF;
+    const size_t _grid_scale;
+    const size_t _grid_scale2;
+    const size_t _chunk_size;
+    const size_t _chunk_cells;
+    const size_t _chunk_scale;
+    const size_t _face_slots;
+    const size_t _goal_node;
+    const size_t _start_node;
+    search_map<nav_chunk> _chunks;
+    search_map<search_node> _nodes;
+    std::vector<search_open> _open;
+    std::vector<bool> _cells;
+    std::vector<uint16_t> _cell_dist;
+    std::vector<uint32_t> _queue;
+    std::vector<bool> _face_open;
+    std::vector<uint32_t> _face_queue;
+    std::vector<size_t> _route;
+    std::vector<uint16_t> _start_dist;
+    std::vector<uint16_t> _goal_dist;
+    std::vector<size_t> _missing;
+    size_t _budget;
+    size_t _build_budget;
+    size_t _builds;
+    size_t _built;
+    size_t _expanded;
+
+    static inline bool open_greater(const search_open &a, const search_open &b)
+    {
+        // Lowest cost first, ties go to the node closest to the goal
+        return (a.f > b.f) || (a.f == b.f && a.h > b.h);
+    }
+    static inline uint32_t distance(const size_t a, const size_t b)
+    {
+        return static_cast<uint32_t>((a > b) ? a - b : b - a);
+    }
+    inline uint32_t heuristic(const size_t key, const min::tri<size_t> &stop) const
+    {
+        // Manhattan distance never overestimates with six unit cost moves
+        const min::tri<size_t> index = min::vec3<float>::grid_index(key, _grid_scale);
+        return distance(index.x(), stop.x()) + distance(index.y(), stop.y()) + distance(index.z(), stop.z());
+    }
+    inline min::tri<size_t> chunk_index(const size_t chunk_key) const
+    {
+        const size_t sc = _chunk_scale;
+        return min::tri<size_t>(chunk_key / (sc * sc), (chunk_key / sc) % sc, chunk_key % sc);
+    }
+    inline size_t chunk_key(const min::tri<size_t> &index) const
+    {
+        return (index.x() / _chunk_size) * _chunk_scale * _chunk_scale + (index.y() / _chunk_size) * _chunk_scale + (index.z() / _chunk_size);
+    }
+    inline size_t cell_local(const min::tri<size_t> &index) const
+    {
+        return ((index.x() % _chunk_size) * _chunk_size + (index.y() % _chunk_size)) * _chunk_size + (index.z() % _chunk_size);
+    }
+    inline size_t cell_local(const size_t key) const
+    {
+        return cell_local(min::vec3<float>::grid_index(key, _grid_scale));
+    }
+    inline size_t node_key(const size_t chunk_key, const size_t face, const size_t run) const
+    {
+        // Both chunks number the runs of a shared face alike, so a neighbor node is keyed without building it
+        return (chunk_key * 6 + face) * _face_slots + run;
+    }
+    inline bool has_neighbor(const min::tri<size_t> &c, const size_t face) const
+    {
+        // Faces are -X, +X, -Y, +Y, -Z, +Z
+        const size_t axis = face / 2;
+        const size_t v = (axis == 0) ? c.x() : (axis == 1) ? c.y() : c.z();
+        return (face % 2 == 0) ? v > 0 : v + 1 < _chunk_scale;
+    }
+    inline size_t across(const size_t key, const size_t face) const
+    {
+        // Key of the cell on the other side of a face
+        const size_t axis = face / 2;
+        const size_t step = (axis == 0) ? _grid_scale2 : (axis == 1) ? _grid_scale : 1;
+        return (face % 2 == 0) ? key - step : key + step;
+    }
+    inline size_t across_chunk(const size_t chunk_key, const size_t face) const
+    {
+        // Key of the chunk on the other side of a face
+        const size_t axis = face / 2;
+        const size_t step = (axis == 0) ? _chunk_scale * _chunk_scale : (axis == 1) ? _chunk_scale : 1;
+        return (face % 2 == 0) ? chunk_key - step : chunk_key + step;
+    }
+    inline size_t face_key(const min::tri<size_t> &c, const size_t face, const size_t u, const size_t v) const
+    {
+        // Cell of the face plane inside this chunk
+        const size_t axis = face / 2;
+        const size_t plane = (face % 2 == 0) ? 0 : _chunk_size - 1;
+        const size_t x = c.x() * _chunk_size;
+        const size_t y = c.y() * _chunk_size;
+        const size_t z = c.z() * _chunk_size;
+        const min::tri<size_t> index = (axis == 0) ? min::tri<size_t>(x + plane, y + u, z + v)
+                                       : (axis == 1) ? min::tri<size_t>(x + u, y + plane, z + v)
+                                                     : min::tri<size_t>(x + u, y + v, z + plane);
+
+        return min::vec3<float>::grid_key(index, _grid_scale);
+    }
+    inline void face_portals(const path_snapshot &grid, const min::tri<size_t> &c, const size_t face, std::vector<size_t> &out)
+    {
+        // Chunks on the world edge have no portals there
+        if (!has_neighbor(c, face))
+        {
+            return;
+        }
+
+        // Flag the open pairs of cells across the face, both chunks see the same pairs
+        const size_t cs = _chunk_size;
+        const size_t last = cs - 1;
+        for (size_t u = 0; u < cs; u++)
+        {
+            for (size_t v = 0; v < cs; v++)
+            {
+                const size_t key = face_key(c, face, u, v);
+                _face_open[u * cs + v] = _cells[cell_local(key)] && grid.get(across(key, face)) == block_id::EMPTY;
+            }
+        }
+
+        // Every connected run of open pairs is an entrance, both chunks find the runs in the same order
+        const size_t cells = cs * cs;
+        for (size_t i = 0; i < cells; i++)
+        {
+            if (!_face_open[i])
+            {
+                continue;
+            }
+
+            // Flood the run across the face plane
+            size_t lu = last;
+            size_t hu = 0;
+            size_t lv = last;
+            size_t hv = 0;
+            _face_queue.clear();
+            _face_queue.push_back(static_cast<uint32_t>(i));
+            _face_open[i] = false;
+            for (size_t head = 0; head < _face_queue.size(); head++)
+            {
+                const size_t cell = _face_queue[head];
+                const size_t u = cell / cs;
+                const size_t v = cell % cs;
+                lu = std::min(lu, u);
+                hu = std::max(hu, u);
+                lv = std::min(lv, v);
+                hv = std::max(hv, v);
+
+                const size_t next[4] = {cell - cs, cell + cs, cell - 1, cell + 1};
+                const bool inside[4] = {u != 0, u != last, v != 0, v != last};
+                for (size_t j = 0; j < 4; j++)
+                {
+                    if (inside[j] && _face_open[next[j]])
+                    {
+                        _face_open[next[j]] = false;
+                        _face_queue.push_back(static_cast<uint32_t>(next[j]));
+                    }
+                }
+            }
+
+            // The portal is the cell of the run closest to the center of its bounds
+            size_t best = _none;
+            size_t pick = i;
+            for (const uint32_t cell : _face_queue)
+            {
+                const size_t u = 2 * (cell / cs);
+                const size_t v = 2 * (cell % cs);
+                const size_t du = (u > lu + hu) ? u - (lu + hu) : (lu + hu) - u;
+                const size_t dv = (v > lv + hv) ? v - (lv + hv) : (lv + hv) - v;
+                const size_t score = du * du + dv * dv;
+                if (score < best)
+                {
+                    best = score;
+                    pick = cell;
+                }
+            }
+            out.push_back(face_key(c, face, pick / cs, pick % cs));
+        }
+    }
+    inline void load_cells(const path_snapshot &grid, const size_t chunk_key)
+    {
+        // Flag the open cells of the chunk
+        const palette_chunk &chunk = *grid.get_chunk(chunk_key);
+        for (size_t i = 0; i < _chunk_cells; i++)
+        {
+            _cells[i] = chunk.get(i) == block_id::EMPTY;
+        }
+    }
+    inline void flood(const size_t start)
+    {
+        // Breadth first search through the open cells of the loaded chunk
+        std::fill(_cell_dist.begin(), _cell_dist.end(), static_cast<uint16_t>(_unreached));
+        _queue.clear();
+        _cell_dist[start] = 0;
+        _queue.push_back(static_cast<uint32_t>(start));
+
+        const size_t cs = _chunk_size;
+        const size_t cs2 = cs * cs;
+        const size_t last = cs - 1;
+        for (size_t head = 0; head < _queue.size(); head++)
+        {
+            const size_t cell = _queue[head];
+            const uint16_t d = static_cast<uint16_t>(std::min(_cell_dist[cell] + 1, _unreached - 1));
+
+            // Open the six face neighbors inside the chunk
+            const size_t x = cell / cs2;
+            const size_t y = (cell / cs) % cs;
+            const size_t z = cell % cs;
+            const size_t next[6] = {cell - cs2, cell + cs2, cell - cs, cell + cs, cell - 1, cell + 1};
+            const bool inside[6] = {x != 0, x != last, y != 0, y != last, z != 0, z != last};
+            for (size_t i = 0; i < 6; i++)
+            {
+                if (inside[i] && _cells[next[i]] && _cell_dist[next[i]] == _unreached)
+                {
+                    _cell_dist[next[i]] = d;
+                    _queue.push_back(static_cast<uint32_t>(next[i]));
+                }
+            }
+        }
+    }
+    inline void build(const path_snapshot &grid, const size_t chunk_key, nav_chunk &out)
+    {
+        // Find the portals on each face
+        const min::tri<size_t> c = chunk_index(chunk_key);
+        load_cells(grid, chunk_key);
+        out.portal.clear();
+        for (size_t f = 0; f < 6; f++)
+        {
+            out.face[f] = out.portal.size();
+            face_portals(grid, c, f, out.portal);
+        }
+        out.face[6] = out.portal.size();
+
+        // Distances between portals through the chunk
+        const size_t size = out.portal.size();
+        out.dist.resize(size * size);
+        for (size_t i = 0; i < size; i++)
+        {
+            flood(cell_local(out.portal[i]));
+            for (size_t j = 0; j < size; j++)
+            {
+                out.dist[i * size + j] = _cell_dist[cell_local(out.portal[j])];
+            }
+        }
+    }
+    inline uint64_t chunk_stamp(const path_snapshot &grid, const size_t chunk_key) const
+    {
+        // Portals change with edits to the chunk or to the cells across its faces
+        const min::tri<size_t> c = chunk_index(chunk_key);
+        uint64_t out = grid.get_stamp(chunk_key);
+        for (size_t f = 0; f < 6; f++)
+        {
+            if (has_neighbor(c, f))
+            {
+                out = std::max(out, grid.get_stamp(across_chunk(chunk_key, f)));
+            }
+        }
+
+        return out;
+    }
+    inline const nav_chunk *chunk(const path_snapshot &grid, const size_t chunk_key)
+    {
+        // Chunks are built the first time a route reaches them and after they or a neighbor are edited
+        const uint64_t stamp = chunk_stamp(grid, chunk_key);
+        nav_chunk *nav = _chunks.find(chunk_key);
+        if (nav && nav->stamp == stamp)
+        {
+            return nav;
+        }
+
+        // The chunk and its neighbors must be in the snapshot, report the ones that are not
+        const min::tri<size_t> c = chunk_index(chunk_key);
+        const size_t missing = _missing.size();
+        if (!grid.get_chunk(chunk_key))
+        {
+            _missing.push_back(chunk_key);
+        }
+        for (size_t f = 0; f < 6; f++)
+        {
+            if (has_neighbor(c, f) && !grid.get_chunk(across_chunk(chunk_key, f)))
+            {
+                _missing.push_back(across_chunk(chunk_key, f));
+            }
+        }
+        if (_missing.size() > missing)
+        {
+            return nullptr;
+        }
+
+        // Defer if this route built its share of chunks
+        if (_builds >= _build_budget)
+        {
+            return nullptr;
+        }
+        _builds++;
+        _built++;
+
+        // Build the chunk in place
+        nav_chunk &out = (nav) ? *nav : _chunks.insert(chunk_key, nav_chunk());
+        build(grid, chunk_key, out);
+        out.stamp = stamp;
+
+        return &out;
+    }
+    inline void ends(const size_t key, const nav_chunk &nav, std::vector<uint16_t> &out)
+    {
+        // Distances from a cell to the portals of the loaded chunk
+        flood(cell_local(key));
+        out.clear();
+        for (const size_t p : nav.portal)
+        {
+            out.push_back(_cell_dist[cell_local(p)]);
+        }
+    }
+    inline void push(const size_t node, const size_t parent, const uint32_t g, const uint32_t h)
+    {
+        // Skip closed nodes and nodes already reached as cheaply
+        const search_node *n = _nodes.find(node);
+        if (n && (n->closed || n->g <= g))
+        {
+            return;
+        }
+
+        // Open the node, stale heap entries are skipped when popped
+        _nodes.insert(node, search_node{parent, g, false});
+        _open.push_back(search_open{g + h, h, node});
+        std::push_heap(_open.begin(), _open.end(), open_greater);
+    }
+    inline void trace(const size_t start_key, const size_t reach)
+    {
+        // Walk back from the goal collecting the portal cells
+        _route.clear();
+        for (size_t node = _nodes.find(_goal_node)->parent; node != _start_node; node = _nodes.find(node)->parent)
+        {
+            const nav_chunk &nav = *_chunks.find(node / (6 * _face_slots));
+            _route.push_back(nav.portal[nav.face[(node / _face_slots) % 6] + node % _face_slots]);
+        }
+        std::reverse(_route.begin(), _route.end());
+
+        // Keep the route up to the last portal within reach of the start
+        const min::tri<size_t> start = min::vec3<float>::grid_index(start_key, _grid_scale);
+        size_t size = 1;
+        for (size_t i = 1; i < _route.size(); i++)
+        {
+            if (heuristic(_route[i], start) <= reach)
+            {
+                size = i + 1;
+            }
+        }
+        _route.resize(std::min(size, _route.size()));
+    }
+
+  public:
+    nav_graph(const size_t grid_scale, const size_t chunk_size)
+        : _grid_scale(grid_scale), _grid_scale2(grid_scale * grid_scale),
+          _chunk_size(chunk_size), _chunk_cells(chunk_size * chunk_size * chunk_size), _chunk_scale(grid_scale / chunk_size),
+          _face_slots(chunk_size * chunk_size), _goal_node(_chunk_scale * _chunk_scale * _chunk_scale * 6 * _face_slots), _start_node(_goal_node + 1),
+          _chunks(1024), _nodes(1024), _cells(_chunk_cells), _cell_dist(_chunk_cells), _face_open(_face_slots),
+          _budget(2048), _build_budget(64), _builds(0), _built(0), _expanded(0)
+    {
+        // Reserve memory for a route
+        _open.reserve(1024);
+        _queue.reserve(_chunk_cells);
+        _face_queue.reserve(_face_slots);
+    }
+    inline void clear()
+    {
+        // Forget every chunk, they belong to the last world
+        _chunks.clear();
+        _nodes.clear();
+        _open.clear();
+        _route.clear();
+    }
+    inline size_t get_built() const
+    {
+        return _built;
+    }
+    inline size_t get_expanded() const
+    {
+        return _expanded;
+    }
+    inline const std::vector<size_t> &get_missing() const
+    {
+        return _missing;
+    }
+    inline const std::vector<size_t> &get_route() const
+    {
+        return _route;
+    }
+    inline size_t get_waypoint() const
+    {
+        return _route.back();
+    }
+    inline bool route(const path_snapshot &grid, const size_t start_key, const size_t stop_key, const size_t reach)
+    {
+        // Clear the last route
+        _nodes.clear();
+        _open.clear();
+        _route.clear();
+        _missing.clear();
+        _builds = 0;
+        _expanded = 0;
+
+        // Routes inside one chunk are left to the cell search
+        const min::tri<size_t> start = min::vec3<float>::grid_index(start_key, _grid_scale);
+        const min::tri<size_t> stop = min::vec3<float>::grid_index(stop_key, _grid_scale);
+        const size_t start_chunk = chunk_key(start);
+        const size_t stop_chunk = chunk_key(stop);
+        if (start_chunk == stop_chunk)
+        {
+            return false;
+        }
+
+        // Distances from the goal to the portals of its chunk
+        const nav_chunk *nav = chunk(grid, stop_chunk);
+        if (!nav || grid.get(stop_key) != block_id::EMPTY)
+        {
+            return false;
+        }
+        load_cells(grid, stop_chunk);
+        ends(stop_key, *nav, _goal_dist);
+
+        // Distances from the start to the portals of its chunk
+        nav = chunk(grid, start_chunk);
+        if (!nav || grid.get(start_key) != block_id::EMPTY)
+        {
+            return false;
+        }
+        load_cells(grid, start_chunk);
+        ends(start_key, *nav, _start_dist);
+
+        // Open the portals reachable from the start
+        bool deferred = false;
+        for (size_t f = 0; f < 6; f++)
+        {
+            for (size_t p = nav->face[f]; p < nav->face[f + 1]; p++)
+            {
+                if (_start_dist[p] != _unreached)
+                {
+                    push(node_key(start_chunk, f, p - nav->face[f]), _start_node, _start_dist[p], heuristic(nav->portal[p], stop));
+                }
+            }
+        }
+
+        // Expand portals until the goal or the budget is reached
+        while (!_open.empty() && _expanded < _budget)
+        {
+            // Pop the cheapest open node
+            std::pop_heap(_open.begin(), _open.end(), open_greater);
+            const search_open top = _open.back();
+            _open.pop_back();
+
+            // Skip stale entries of nodes that were reached more cheaply
+            search_node &node = *_nodes.find(top.key);
+            const uint32_t g = top.f - top.h;
+            if (node.closed || g != node.g)
+            {
+                continue;
+            }
+            node.closed = true;
+            _expanded++;
+
+            // The route is found when the goal is closed, unless a cheaper one could pass through a deferred chunk
+            if (top.key == _goal_node)
+            {
+                if (deferred)
+                {
+                    return false;
+                }
+                trace(start_key, reach);
+                return true;
+            }
+
+            // No other chunk is built while this one is expanded
+            const size_t c = top.key / (6 * _face_slots);
+            const size_t f = (top.key / _face_slots) % 6;
+            const nav_chunk *found = chunk(grid, c);
+            if (!found)
+            {
+                // Keep expanding to report every chunk this route is missing
+                deferred = true;
+                continue;
+            }
+            const nav_chunk &here = *found;
+            const size_t p = here.face[f] + top.key % _face_slots;
+            if (p >= here.face[f + 1])
+            {
+                continue;
+            }
+
+            // Step across the face into the same run of the neighbor chunk
+            push(node_key(across_chunk(c, f), f ^ 1, top.key % _face_slots), top.key, g + 1, heuristic(across(here.portal[p], f), stop));
+
+            // Travel through the chunk to its other portals
+            const size_t size = here.portal.size();
+            for (size_t i = 0; i < 6; i++)
+            {
+                for (size_t q = here.face[i]; q < here.face[i + 1]; q++)
+                {
+                    const uint16_t d = here.dist[p * size + q];
+                    if (q != p && d != _unreached)
+                    {
+                        push(node_key(c, i, q - here.face[i]), top.key, g + d, heuristic(here.portal[q], stop));
+                    }
+                }
+            }
+
+            // Enter the goal from its chunk
+            if (c == stop_chunk && _goal_dist[p] != _unreached)
+            {
+                push(_goal_node, top.key, g + _goal_dist[p], 0);
+            }
+        }
+
+        return false;
+    }
+    inline void set_budget(const size_t route, const size_t builds)
+    {
+        _budget = route;
+        _build_budget = builds;
+    }
+};
+}
+
+#endif
@@ -58,13 +58,17 @@ class options
     key_map_type _map;
     bool _persist;
     bool _resize;
+    bool _greedy;
+    uint64_t _seed;
+    bool _seeded;
 
   public:
     options()
         : _chunk(8), _frames(60), _grid(64),
           _mode(game_type::NORMAL), _slot(0), _view(5),
           _width(1024), _height(768),
-          _map(key_map_type::QWERTY), _persist(true), _resize(true) {}
+          _map(key_map_type::QWERTY), _persist(true), _resize(true), _greedy(false),
+          _seed(0), _seeded(false) {}
 
     inline bool check_error() const
     {
@@ -79,6 +83,11 @@ class options
             std::cout << "bds: '-chunk' must be atleast 2" << std::endl;
             return true;
         }
+        else if (_chunk > 127)
+        {
+            std::cout << "bds: '-chunk' must be atmost 127" << std::endl;
+            return true;
+        }
         else if (_view < 3)
         {
             std::cout << "bds: '-view' must be atleast 3" << std::endl;
@@ -104,10 +113,18 @@ class options
     {
         return _slot;
     }
+    inline bool greedy() const
+    {
+        return _greedy;
+    }
     inline size_t grid() const
     {
         return _grid;
     }
+    inline bool has_seed() const
+    {
+        return _seeded;
+    }
     inline size_t view() const
     {
         return _view;
@@ -136,6 +153,10 @@ class options
     {
         return _resize;
     }
+    inline uint64_t seed() const
+    {
+        return _seed;
+    }
     inline void set_chunk(const size_t chunk)
     {
         _chunk = chunk;
@@ -144,6 +165,10 @@ class options
     {
         _frames = frames;
     }
+    inline void set_greedy(const bool flag)
+    {
+        _greedy = flag;
+    }
     inline void set_grid(const size_t grid)
     {
         _grid = grid;
@@ -160,6 +185,11 @@ class options
     {
         _slot = slot;
     }
+    inline void set_seed(const uint64_t seed)
+    {
+        _seed = seed;
+        _seeded = true;
+    }
     inline void set_view(const size_t view)
     {
         _view = view;
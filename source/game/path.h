@@ -89,8 +89,10 @@ class path
     float _curve_dist;
     float _curve_interp;
     size_t _path_index;
+    size_t _ticket;
     bool _is_dead;
     bool _is_stuck;
+    bool _pending;
 
     inline min::vec3<float> calculate_direction() const
     {
@@ -194,20 +196,41 @@ class path
         // Reset the target position
         _target = _path[_path_index];
     }
+    inline void start_path(const min::vec3<float> &p)
+    {
+        // Reset path index
+        _path_index = 0;
+
+        // Reset last point
+        _last = p;
+
+        // Reset the bezier curve if have enough points
+        if (_path.size() >= 3)
+        {
+            set_bezier_interpolation(p);
+        }
+        else
+        {
+            set_linear_interpolation();
+        }
+    }
 
   public:
     path()
         : _bezier_interp(false),
           _curve_dist(0.0), _curve_interp(0.0),
-          _path_index(0),
-          _is_dead(true), _is_stuck(false)
+          _path_index(0), _ticket(0),
+          _is_dead(true), _is_stuck(false), _pending(false)
     {
         // Reserve space for path
         _path.reserve(100);
     }
     inline void clear()
     {
+        // Paths requested before clearing are ignored when they arrive
         _path.clear();
+        _pending = false;
+        _ticket++;
     }
     inline void clear_stuck()
     {
@@ -221,6 +244,10 @@ class path
     {
         return _is_dead;
     }
+    inline bool is_pending() const
+    {
+        return _pending;
+    }
     inline bool is_stuck() const
     {
         return _is_stuck;
@@ -229,7 +256,28 @@ class path
     {
         _is_dead = flag;
     }
-    inline const min::vec3<float> step(cgrid &grid)
+    inline void set_path(const size_t ticket, const std::vector<min::vec3<float>> &path)
+    {
+        // Drop paths for requests that were cleared
+        if (!_pending || ticket != _ticket)
+        {
+            return;
+        }
+        _pending = false;
+
+        // If we got a path from grid
+        _path = path;
+        if (_path.size() > 0)
+        {
+            start_path(_data.position());
+        }
+        else
+        {
+            // Flag that we are stuck
+            _is_stuck = true;
+        }
+    }
+    inline const min::vec3<float> step(cgrid &grid, const size_t id)
     {
         // Get data points
         const min::vec3<float> &p = _data.position();
@@ -238,35 +286,24 @@ class path
         // If we need to compute a path
         if (_path.size() == 0)
         {
-            // Update path vector
-            grid.path(_path, p, dest);
-
-            // If we got a path from grid
-            if (_path.size() > 0)
+            // Paths to the flow field goal are read straight from the grid
+            if (grid.path_flow(_path, p, dest))
             {
-                // Reset path index
-                _path_index = 0;
-
-                // Reset last point
-                _last = p;
-
-                // Reset the bezier curve if have enough points
-                if (_path.size() >= 3)
-                {
-                    set_bezier_interpolation(p);
-                }
-                else
-                {
-                    set_linear_interpolation();
-                }
+                start_path(p);
 
                 // Calculate direction
                 return calculate_direction();
             }
-            else
+
+            // Else search on a worker thread and keep heading for the destination until the path arrives
+            if (!_pending)
             {
-                // Flag that we are stuck
-                _is_stuck = true;
+                _pending = grid.path_request(id, ++_ticket, p, dest);
+                if (!_pending)
+                {
+                    // Flag that we are stuck
+                    _is_stuck = true;
+                }
             }
         }
         else
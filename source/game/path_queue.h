@@ -0,0 +1,311 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_PATH_QUEUE_BDS_
+#define _BDS_PATH_QUEUE_BDS_
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <game/grid_search.h>
+#include <game/nav_graph.h>
+#include <game/path_snapshot.h>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace game
+{
+
+class path_job
+{
+  private:
+    size_t _id;
+    size_t _ticket;
+    size_t _start;
+    size_t _stop;
+    path_snapshot _snapshot;
+    std::shared_ptr<const path_snapshot> _world;
+    std::chrono::steady_clock::time_point _time;
+
+  public:
+    path_job(const size_t id, const size_t ticket, const size_t start, const size_t stop,
+             path_snapshot &&snapshot, std::shared_ptr<const path_snapshot> &&world)
+        : _id(id), _ticket(ticket), _start(start), _stop(stop), _snapshot(std::move(snapshot)),
+          _world(std::move(world)), _time(std::chrono::steady_clock::now()) {}
+
+    inline size_t get_id() const
+    {
+        return _id;
+    }
+    inline const path_snapshot &get_snapshot() const
+    {
+        return _snapshot;
+    }
+    inline size_t get_start() const
+    {
+        return _start;
+    }
+    inline size_t get_stop() const
+    {
+        return _stop;
+    }
+    inline size_t get_ticket() const
+    {
+        return _ticket;
+    }
+    inline const std::chrono::steady_clock::time_point &get_time() const
+    {
+        return _time;
+    }
+    inline const std::shared_ptr<const path_snapshot> &get_world() const
+    {
+        return _world;
+    }
+};
+
+class path_result
+{
+  private:
+    size_t _id;
+    size_t _ticket;
+    std::vector<size_t> _keys;
+    std::chrono::steady_clock::time_point _time;
+
+  public:
+    path_result(const size_t id, const size_t ticket, const std::vector<size_t> &keys, const std::chrono::steady_clock::time_point &time)
+        : _id(id), _ticket(ticket), _keys(keys), _time(time) {}
+
+    inline size_t get_id() const
+    {
+        return _id;
+    }
+    inline const std::vector<size_t> &get_keys() const
+    {
+        return _keys;
+    }
+    inline size_t get_ticket() const
+    {
+        return _ticket;
+    }
+    inline const std::chrono::steady_clock::time_point &get_time() const
+    {
+        return _time;
+    }
+};
+
+class path_queue
+{
+  private:
+    const size_t _grid_scale;
+    const size_t _chunk_size;
+    const size_t _reach;
+    std::vector<path_job> _jobs;
+    std::vector<path_result> _results;
+    std::vector<size_t> _missing;
+    std::vector<std::thread> _threads;
+    mutable std::mutex _lock;
+    std::condition_variable _wake;
+    size_t _busy;
+    bool _stop;
+    size_t _completed;
+    size_t _max_depth;
+    double _latency_sum;
+    double _latency_max;
+
+    inline void work()
+    {
+        // Each thread owns a search and a chunk graph, the snapshots are the only grids they read
+        grid_search search(_grid_scale);
+        nav_graph nav(_grid_scale, _chunk_size);
+
+        std::unique_lock<std::mutex> lock(_lock);
+        while (true)
+        {
+            // Wait for a job or shutdown
+            _wake.wait(lock, [this]() {
+                return _stop || _jobs.size() > 0;
+            });
+            if (_stop)
+            {
+                return;
+            }
+
+            // Take the oldest job
+            path_job job = std::move(_jobs.front());
+            _jobs.erase(_jobs.begin());
+            _busy++;
+
+            // Route and search without holding the lock
+            lock.unlock();
+            const path_snapshot &snapshot = job.get_snapshot();
+            const std::shared_ptr<const path_snapshot> &world = job.get_world();
+
+            // Goals out of the snapshot are routed over the chunk graph of the world, the search runs up to the last portal in reach
+            size_t goal = job.get_stop();
+            const bool routed = world && snapshot.clamp(goal) != goal;
+            if (routed && nav.route(*world, job.get_start(), goal, _reach))
+            {
+                goal = nav.get_waypoint();
+            }
+
+            // Goals still outside the snapshot are searched for at its edge
+            search.search(snapshot, job.get_start(), snapshot.clamp(goal));
+            lock.lock();
+
+            // Hand the path and the chunks the route could not see to the game thread
+            _results.emplace_back(job.get_id(), job.get_ticket(), search.get_path(), job.get_time());
+            if (routed)
+            {
+                _missing.insert(_missing.end(), nav.get_missing().begin(), nav.get_missing().end());
+            }
+            _busy--;
+        }
+    }
+
+  public:
+    path_queue(const size_t grid_scale, const size_t chunk_size, const size_t reach, const size_t threads)
+        : _grid_scale(grid_scale), _chunk_size(chunk_size), _reach(reach), _busy(0), _stop(false),
+          _completed(0), _max_depth(0), _latency_sum(0.0), _latency_max(0.0)
+    {
+        // Launch the background threads
+        for (size_t i = 0; i < threads; i++)
+        {
+            _threads.emplace_back(&path_queue::work, this);
+        }
+    }
+    ~path_queue()
+    {
+        // Signal all threads to stop
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+            _stop = true;
+        }
+        _wake.notify_all();
+
+        // Wait for all threads to finish
+        for (auto &t : _threads)
+        {
+            t.join();
+        }
+    }
+    path_queue(const path_queue &) = delete;
+    path_queue &operator=(const path_queue &) = delete;
+
+    inline void clear()
+    {
+        // Drop all jobs that have not started, all unclaimed paths and missing chunks
+        std::lock_guard<std::mutex> lock(_lock);
+        _jobs.clear();
+        _results.clear();
+        _missing.clear();
+    }
+    inline size_t get_completed() const
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _completed;
+    }
+    inline size_t get_depth() const
+    {
+        // Jobs waiting or being searched
+        std::lock_guard<std::mutex> lock(_lock);
+        return _jobs.size() + _busy;
+    }
+    inline double get_latency_avg() const
+    {
+        // Average milliseconds from request to delivery
+        std::lock_guard<std::mutex> lock(_lock);
+        return (_completed > 0) ? _latency_sum / _completed : 0.0;
+    }
+    inline double get_latency_max() const
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _latency_max;
+    }
+    inline size_t get_max_depth() const
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        return _max_depth;
+    }
+    template <typename F>
+    inline void pop(const F &f)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        // Hand finished paths to the caller and time the round trip
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        for (const auto &r : _results)
+        {
+            const double ms = std::chrono::duration<double, std::milli>(now - r.get_time()).count();
+            _latency_sum += ms;
+            _latency_max = std::max(_latency_max, ms);
+            _completed++;
+
+            f(r.get_id(), r.get_ticket(), r.get_keys());
+        }
+        _results.clear();
+    }
+    inline void pop_missing(std::vector<size_t> &out)
+    {
+        // Chunks routes needed that were not in their world snapshot
+        std::lock_guard<std::mutex> lock(_lock);
+        out.clear();
+        out.swap(_missing);
+    }
+    inline void push(const size_t id, const size_t ticket, const size_t start, const size_t stop,
+                     path_snapshot &&snapshot, std::shared_ptr<const path_snapshot> &&world)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_lock);
+
+            // Replace a job for this path that has not started yet
+            bool replaced = false;
+            for (auto &j : _jobs)
+            {
+                if (j.get_id() == id)
+                {
+                    j = path_job(id, ticket, start, stop, std::move(snapshot), std::move(world));
+                    replaced = true;
+                    break;
+                }
+            }
+
+            // Queue a new job
+            if (!replaced)
+            {
+                _jobs.emplace_back(id, ticket, start, stop, std::move(snapshot), std::move(world));
+            }
+            _max_depth = std::max(_max_depth, _jobs.size() + _busy);
+        }
+
+        // Wake a thread to search it
+        _wake.notify_one();
+    }
+    inline void reset_stats()
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _completed = 0;
+        _max_depth = 0;
+        _latency_sum = 0.0;
+        _latency_max = 0.0;
+    }
+};
+}
+
+#endif
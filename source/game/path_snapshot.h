@@ -0,0 +1,135 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_PATH_SNAPSHOT_BDS_
+#define _BDS_PATH_SNAPSHOT_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <game/chunk_store.h>
+#include <game/id.h>
+#include <memory>
+#include <min/tri.h>
+#include <vector>
+
+namespace game
+{
+
+class path_snapshot
+{
+  private:
+    size_t _grid_scale;
+    size_t _grid_scale2;
+    size_t _chunk_size;
+    min::tri<size_t> _lower;
+    min::tri<size_t> _upper;
+    std::vector<std::shared_ptr<const palette_chunk>> _chunks;
+    std::vector<uint64_t> _stamps;
+
+    inline size_t box_index(const size_t cx, const size_t cy, const size_t cz) const
+    {
+        // Chunks outside the snapshot have no index
+        if (cx < _lower.x() || cx >= _upper.x() || cy < _lower.y() || cy >= _upper.y() || cz < _lower.z() || cz >= _upper.z())
+        {
+            return static_cast<size_t>(-1);
+        }
+
+        const size_t sy = _upper.y() - _lower.y();
+        const size_t sz = _upper.z() - _lower.z();
+        return ((cx - _lower.x()) * sy + (cy - _lower.y())) * sz + (cz - _lower.z());
+    }
+    inline size_t box_index(const size_t chunk_key) const
+    {
+        // Chunk keys are X major, Z minor over the whole world
+        const size_t cs = _grid_scale / _chunk_size;
+        return box_index(chunk_key / (cs * cs), (chunk_key / cs) % cs, chunk_key % cs);
+    }
+
+  public:
+    path_snapshot(const size_t grid_scale, const size_t chunk_size, const min::tri<size_t> &lower, const min::tri<size_t> &upper)
+        : _grid_scale(grid_scale), _grid_scale2(grid_scale * grid_scale), _chunk_size(chunk_size), _lower(lower), _upper(upper)
+    {
+        // Reserve space for the chunks in the box
+        const size_t size = (upper.x() - lower.x()) * (upper.y() - lower.y()) * (upper.z() - lower.z());
+        _chunks.reserve(size);
+        _stamps.reserve(size);
+    }
+    inline block_id get(const size_t key) const
+    {
+        // Unpack grid key into components
+        const size_t x = key / _grid_scale2;
+        const size_t r = key - (x * _grid_scale2);
+        const size_t y = r / _grid_scale;
+        const size_t z = r - (y * _grid_scale);
+
+        // Cells outside the snapshot or in chunks it has no copy of can't be searched
+        const size_t chunk = box_index(x / _chunk_size, y / _chunk_size, z / _chunk_size);
+        if (chunk == static_cast<size_t>(-1) || !_chunks[chunk])
+        {
+            return block_id::INVALID;
+        }
+
+        // Look up the cell in its chunk
+        const size_t cell = ((x % _chunk_size) * _chunk_size + (y % _chunk_size)) * _chunk_size + (z % _chunk_size);
+
+        return _chunks[chunk]->get(cell);
+    }
+    inline size_t clamp(const size_t key) const
+    {
+        // Unpack grid key into components
+        const size_t x = key / _grid_scale2;
+        const size_t r = key - (x * _grid_scale2);
+        const size_t y = r / _grid_scale;
+        const size_t z = r - (y * _grid_scale);
+
+        // Nearest cell inside the snapshot
+        const size_t cx = std::min(std::max(x, _lower.x() * _chunk_size), _upper.x() * _chunk_size - 1);
+        const size_t cy = std::min(std::max(y, _lower.y() * _chunk_size), _upper.y() * _chunk_size - 1);
+        const size_t cz = std::min(std::max(z, _lower.z() * _chunk_size), _upper.z() * _chunk_size - 1);
+
+        return (cx * _grid_scale2) + (cy * _grid_scale) + cz;
+    }
+    inline const palette_chunk *get_chunk(const size_t chunk_key) const
+    {
+        // Null if the chunk is outside the snapshot or was not copied
+        const size_t chunk = box_index(chunk_key);
+        return (chunk != static_cast<size_t>(-1)) ? _chunks[chunk].get() : nullptr;
+    }
+    inline const min::tri<size_t> &get_lower() const
+    {
+        return _lower;
+    }
+    inline uint64_t get_stamp(const size_t chunk_key) const
+    {
+        // Stamp of the last edit of the chunk when the snapshot was taken
+        const size_t chunk = box_index(chunk_key);
+        return (chunk != static_cast<size_t>(-1)) ? _stamps[chunk] : 0;
+    }
+    inline const min::tri<size_t> &get_upper() const
+    {
+        return _upper;
+    }
+    inline void push_back(const std::shared_ptr<const palette_chunk> &chunk, const uint64_t stamp)
+    {
+        // Chunks are added X major, Z minor, a null chunk was not copied yet
+        _chunks.push_back(chunk);
+        _stamps.push_back(stamp);
+    }
+};
+}
+
+#endif
@@ -25,7 +25,6 @@
 #include <min/cubic.h>
 #include <min/dds.h>
 #include <min/emitter_buffer.h>
-#include <min/height_map.h>
 #include <min/intersect.h>
 #include <min/loop_sync.h>
 #include <min/mat4.h>
@@ -77,7 +76,6 @@ extern template class min::body<float, min::vec3>;
 extern template class min::camera<float>;
 extern template class min::tree<float, uint_fast16_t, uint_fast32_t, min::vec3, min::aabbox, min::aabbox>;
 extern template class min::frustum<float>;
-extern template class min::height_map<float>;
 extern template class min::mat3<float>;
 extern template class min::mat4<float>;
 extern template class min::md5_model<float, uint32_t, min::vec4, min::aabbox>;
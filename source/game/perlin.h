@@ -19,96 +19,178 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define _BDS_PERLIN_NOISE_BDS_
 
 #include <array>
-#include <chrono>
+#include <cstddef>
+#include <game/counter_rng.h>
+#include <kernel/simd.h>
 #include <min/vec3.h>
-#include <random>
 
 namespace kernel
 {
 
+// Gradient of each hash, g = x * gx + y * gy + z * gz replaces a 16 way switch
+constexpr float perlin_gx[16] = {1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 1, 0, -1, 0};
+constexpr float perlin_gy[16] = {1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1, 1, -1, 1, -1};
+constexpr float perlin_gz[16] = {0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1, 0, 1, 0, -1};
+
 class perlin_noise
 {
   private:
     std::array<uint_fast8_t, 512> _p;
+    simd_level _simd;
 
-    inline void calc_random_hash_table()
+    inline void calc_random_hash_table(const uint64_t seed)
     {
-        std::uniform_int_distribution<unsigned> idist(0, 255);
-        std::mt19937 gen(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+        // Hash table only depends on the seed
+        game::counter_rng gen(game::counter_rng::derive(seed, game::seed_stream::perlin), 0);
 
         const size_t size = _p.size();
         for (size_t i = 0; i < size; i++)
         {
-            _p[i] = idist(gen);
+            _p[i] = gen.uniform(0, 255);
         }
     }
-    inline float fade(float t) const
+    static inline float fade(float t)
     {
         return t * t * t * (t * (t * 6 - 15) + 10);
     }
-    inline float lerp(const float a, const float b, const float x) const
+    static inline float lerp(const float a, const float b, const float x)
     {
         return (b - a) * x + a;
     }
-    inline float g(const uint_fast8_t index, const float x, const float y, const float z) const
+    static inline float g(const uint_fast8_t index, const float x, const float y, const float z)
     {
         // Get a random gradient dot product
-        switch (index & 15)
+        const uint_fast8_t i = index & 15;
+        return x * perlin_gx[i] + y * perlin_gy[i] + z * perlin_gz[i];
+    }
+    BDS_SIMD_INLINE void row(const float x, const float y, const float *z, const size_t n, float *out) const
+    {
+        // Lattice cell of the row, hash tables wrap every 256 cells
+        const size_t xi = static_cast<size_t>(x);
+        const size_t yi = static_cast<size_t>(y);
+        const uint_fast8_t xim = xi & 255;
+        const uint_fast8_t yim = yi & 255;
+        const uint_fast8_t xip = (xi + 1) & 255;
+        const uint_fast8_t yip = (yi + 1) & 255;
+
+        // Hash the four X/Y corners once for the whole row
+        const size_t hmm = _p[_p[xim] + yim];
+        const size_t hmp = _p[_p[xim] + yip];
+        const size_t hpm = _p[_p[xip] + yim];
+        const size_t hpp = _p[_p[xip] + yip];
+
+        // Distance vector and interpolation constants along X and Y
+        const float xp = x - xi;
+        const float yp = y - yi;
+        const float xm = xp - 1.0f;
+        const float ym = yp - 1.0f;
+        const float t = fade(xp);
+        const float u = fade(yp);
+
+        // Walk the row one Z lattice cell at a time, Z increases along the row
+        size_t i = 0;
+        while (i < n)
         {
-        case 0:
-            return x + y;
-        case 1:
-            return -x + y;
-        case 2:
-            return x - y;
-        case 3:
-            return -x - y;
-        case 4:
-            return x + z;
-        case 5:
-            return -x + z;
-        case 6:
-            return x - z;
-        case 7:
-            return -x - z;
-        case 8:
-            return y + z;
-        case 9:
-            return -y + z;
-        case 10:
-            return y - z;
-        case 11:
-            return -y - z;
-        case 12:
-            return y + x;
-        case 13:
-            return -y + z;
-        case 14:
-            return y - x;
-        case 15:
-            return -y - z;
-        default:
-            return 0;
+            // Find all samples in this lattice cell
+            const size_t zi = static_cast<size_t>(z[i]);
+            size_t end = i + 1;
+            while (end < n && static_cast<size_t>(z[end]) == zi)
+            {
+                end++;
+            }
+
+            // Hash the 8 corners of the cell
+            const uint_fast8_t zim = zi & 255;
+            const uint_fast8_t zip = (zi + 1) & 255;
+            const uint_fast8_t mmm = _p[hmm + zim] & 15;
+            const uint_fast8_t mpm = _p[hmp + zim] & 15;
+            const uint_fast8_t mmp = _p[hmm + zip] & 15;
+            const uint_fast8_t mpp = _p[hmp + zip] & 15;
+            const uint_fast8_t pmm = _p[hpm + zim] & 15;
+            const uint_fast8_t ppm = _p[hpp + zim] & 15;
+            const uint_fast8_t pmp = _p[hpm + zip] & 15;
+            const uint_fast8_t ppp = _p[hpp + zip] & 15;
+
+            // Split corner gradients into the X/Y part that is constant in this cell and the Z slope
+            const float a_mmm = xm * perlin_gx[mmm] + ym * perlin_gy[mmm];
+            const float a_mpm = xm * perlin_gx[mpm] + yp * perlin_gy[mpm];
+            const float a_mmp = xm * perlin_gx[mmp] + ym * perlin_gy[mmp];
+            const float a_mpp = xm * perlin_gx[mpp] + yp * perlin_gy[mpp];
+            const float a_pmm = xp * perlin_gx[pmm] + ym * perlin_gy[pmm];
+            const float a_ppm = xp * perlin_gx[ppm] + yp * perlin_gy[ppm];
+            const float a_pmp = xp * perlin_gx[pmp] + ym * perlin_gy[pmp];
+            const float a_ppp = xp * perlin_gx[ppp] + yp * perlin_gy[ppp];
+            const float b_mmm = perlin_gz[mmm];
+            const float b_mpm = perlin_gz[mpm];
+            const float b_mmp = perlin_gz[mmp];
+            const float b_mpp = perlin_gz[mpp];
+            const float b_pmm = perlin_gz[pmm];
+            const float b_ppm = perlin_gz[ppm];
+            const float b_pmp = perlin_gz[pmp];
+            const float b_ppp = perlin_gz[ppp];
+
+            // Same steps as the scalar sample, without lookups this loop vectorizes
+            const float zf = static_cast<float>(zi);
+            for (size_t j = i; j < end; j++)
+            {
+                const float zp = z[j] - zf;
+                const float zm = zp - 1.0f;
+                const float v = fade(zp);
+
+                // Interpolate along X
+                const float x_ym_zm = lerp(a_mmm + zm * b_mmm, a_pmm + zm * b_pmm, t);
+                const float x_yp_zm = lerp(a_mpm + zm * b_mpm, a_ppm + zm * b_ppm, t);
+                const float x_ym_zp = lerp(a_mmp + zp * b_mmp, a_pmp + zp * b_pmp, t);
+                const float x_yp_zp = lerp(a_mpp + zp * b_mpp, a_ppp + zp * b_ppp, t);
+
+                // Interpolate along Y
+                const float y_zm = lerp(x_ym_zm, x_yp_zm, u);
+                const float y_zp = lerp(x_ym_zp, x_yp_zp, u);
+
+                // Interpolate along Z, map [-2, 2] to [0, 1]
+                out[j] = lerp(y_zm, y_zp, v) * 0.25f + 0.5f;
+            }
+
+            // Next lattice cell
+            i = end;
         }
     }
+#ifdef BDS_SIMD_DISPATCH
+    __attribute__((target("avx2"))) inline void row_avx2(const float x, const float y, const float *z, const size_t n, float *out) const
+    {
+        row(x, y, z, n, out);
+    }
+    __attribute__((target("avx512f"))) inline void row_avx512(const float x, const float y, const float *z, const size_t n, float *out) const
+    {
+        row(x, y, z, n, out);
+    }
+#endif
 
   public:
-    perlin_noise()
+    perlin_noise(const uint64_t seed)
+        : _simd(simd_support())
     {
         // Calculate random numbers
-        calc_random_hash_table();
+        calc_random_hash_table(seed);
+    }
+    inline simd_level get_simd() const
+    {
+        return _simd;
     }
     inline float perlin(const float x, const float y, const float z) const
     {
-        // Calculate hash table indices
-        const uint_fast8_t xim = static_cast<uint_fast8_t>(x) & 255;
-        const uint_fast8_t yim = static_cast<uint_fast8_t>(y) & 255;
-        const uint_fast8_t zim = static_cast<uint_fast8_t>(z) & 255;
+        // Lattice cell of the sample
+        const size_t xi = static_cast<size_t>(x);
+        const size_t yi = static_cast<size_t>(y);
+        const size_t zi = static_cast<size_t>(z);
 
-        // Unsigned overflow is well defined here!
-        const uint_fast8_t xip = xim + 1;
-        const uint_fast8_t yip = yim + 1;
-        const uint_fast8_t zip = zim + 1;
+        // Calculate hash table indices, hash tables wrap every 256 cells
+        const uint_fast8_t xim = xi & 255;
+        const uint_fast8_t yim = yi & 255;
+        const uint_fast8_t zim = zi & 255;
+        const uint_fast8_t xip = (xi + 1) & 255;
+        const uint_fast8_t yip = (yi + 1) & 255;
+        const uint_fast8_t zip = (zi + 1) & 255;
 
         // Hash 8 corners on local unit cube
         const uint_fast8_t mmm = _p[_p[_p[xim] + yim] + zim];
@@ -121,14 +203,14 @@ class perlin_noise
         const uint_fast8_t ppp = _p[_p[_p[xip] + yip] + zip];
 
         // Calculate distance vector within local unit cube
-        const float xp = x - static_cast<uint_fast8_t>(x);
-        const float yp = y - static_cast<uint_fast8_t>(y);
-        const float zp = z - static_cast<uint_fast8_t>(z);
+        const float xp = x - xi;
+        const float yp = y - yi;
+        const float zp = z - zi;
 
         // Calculate the inverse distance vector
-        const float xm = xp - 1.0;
-        const float ym = yp - 1.0;
-        const float zm = zp - 1.0;
+        const float xm = xp - 1.0f;
+        const float ym = yp - 1.0f;
+        const float zm = zp - 1.0f;
 
         // Calculate interpolation constants
         const float t = fade(xp);
@@ -146,7 +228,49 @@ class perlin_noise
         const float y_zp = lerp(x_ym_zp, x_yp_zp, u);
 
         // Interpolate along Z, map [-2, 2] to [0, 1]
-        return lerp(y_zm, y_zp, v) * 0.25 + 0.5;
+        return lerp(y_zm, y_zp, v) * 0.25f + 0.5f;
+    }
+    inline void perlin_brick(const float *x, const size_t nx, const float *y, const size_t ny, const float *z, const size_t nz, float *out) const
+    {
+        // Sample every (x, y, z) of the brick, x major with rows along Z contiguous
+        for (size_t i = 0; i < nx; i++)
+        {
+            for (size_t j = 0; j < ny; j++)
+            {
+                perlin_row(x[i], y[j], z, nz, &out[(i * ny + j) * nz]);
+            }
+        }
+    }
+    inline void perlin_points(const float *x, const float *y, const float *z, const size_t n, float *out) const
+    {
+        // Scattered samples share no lattice cells, sample one at a time
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = perlin(x[i], y[i], z[i]);
+        }
+    }
+    inline void perlin_row(const float x, const float y, const float *z, const size_t n, float *out) const
+    {
+#ifdef BDS_SIMD_DISPATCH
+        // Call the row kernel compiled for this instruction set
+        if (_simd == simd_level::avx512)
+        {
+            row_avx512(x, y, z, n, out);
+            return;
+        }
+        else if (_simd == simd_level::avx2)
+        {
+            row_avx2(x, y, z, n, out);
+            return;
+        }
+#endif
+
+        // Baseline instruction set
+        row(x, y, z, n, out);
+    }
+    inline void set_simd(const simd_level level)
+    {
+        _simd = level;
     }
 };
 }
@@ -0,0 +1,163 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_SEARCH_MAP_BDS_
+#define _BDS_SEARCH_MAP_BDS_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace game
+{
+
+template <typename T>
+class search_map
+{
+  private:
+    std::vector<size_t> _keys;
+    std::vector<uint32_t> _stamps;
+    std::vector<T> _values;
+    uint32_t _stamp;
+    size_t _mask;
+    size_t _size;
+
+    inline size_t slot(const size_t key) const
+    {
+        // Fibonacci hash, neighbor grid keys land far apart
+        return static_cast<size_t>((static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> 32) & _mask;
+    }
+    inline void grow()
+    {
+        // Double the table and reinsert the entries of this search
+        std::vector<size_t> keys(_keys.size() * 2);
+        std::vector<uint32_t> stamps(_stamps.size() * 2, 0);
+        std::vector<T> values(_values.size() * 2);
+        keys.swap(_keys);
+        stamps.swap(_stamps);
+        values.swap(_values);
+        _mask = _keys.size() - 1;
+
+        // Reinsert the live entries
+        const size_t size = keys.size();
+        for (size_t i = 0; i < size; i++)
+        {
+            if (stamps[i] == _stamp)
+            {
+                size_t s = slot(keys[i]);
+                while (_stamps[s] == _stamp)
+                {
+                    s = (s + 1) & _mask;
+                }
+                _keys[s] = keys[i];
+                _stamps[s] = _stamp;
+                _values[s] = values[i];
+            }
+        }
+    }
+
+  public:
+    search_map(const size_t capacity)
+        : _stamp(1), _size(0)
+    {
+        // Round capacity up to a power of two for masking
+        size_t size = 16;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        _keys.resize(size);
+        _stamps.resize(size, 0);
+        _values.resize(size);
+        _mask = size - 1;
+    }
+    inline size_t capacity() const
+    {
+        return _keys.size();
+    }
+    inline void clear()
+    {
+        // Entries from older searches are stale, only wrap around needs to touch the table
+        _size = 0;
+        if (++_stamp == 0)
+        {
+            std::fill(_stamps.begin(), _stamps.end(), 0);
+            _stamp = 1;
+        }
+    }
+    inline T *find(const size_t key)
+    {
+        // Probe until an empty or stale slot
+        for (size_t s = slot(key); _stamps[s] == _stamp; s = (s + 1) & _mask)
+        {
+            if (_keys[s] == key)
+            {
+                return &_values[s];
+            }
+        }
+
+        return nullptr;
+    }
+    inline const T *find(const size_t key) const
+    {
+        // Probe until an empty or stale slot
+        for (size_t s = slot(key); _stamps[s] == _stamp; s = (s + 1) & _mask)
+        {
+            if (_keys[s] == key)
+            {
+                return &_values[s];
+            }
+        }
+
+        return nullptr;
+    }
+    inline T &insert(const size_t key, const T &value)
+    {
+        // Keep the load factor under one half, references from before may be invalidated
+        if ((_size + 1) * 2 > _keys.size())
+        {
+            grow();
+        }
+
+        // Overwrite the key if it is in this search
+        size_t s = slot(key);
+        for (; _stamps[s] == _stamp; s = (s + 1) & _mask)
+        {
+            if (_keys[s] == key)
+            {
+                _values[s] = value;
+                return _values[s];
+            }
+        }
+
+        // Claim the empty or stale slot
+        _keys[s] = key;
+        _stamps[s] = _stamp;
+        _values[s] = value;
+        _size++;
+
+        return _values[s];
+    }
+    inline size_t size() const
+    {
+        return _size;
+    }
+};
+}
+
+#endif
@@ -19,6 +19,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define _BDS_TERRAIN_GEOMETRY_BDS_
 
 #include <game/memory_map.h>
+#include <game/terrain_mesher.h>
 #include <game/terrain_vertex.h>
 #include <min/array_buffer.h>
 #include <min/dds.h>
@@ -26,6 +27,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #include <min/shader.h>
 #include <min/texture_buffer.h>
 #include <stdexcept>
+#include <vector>
 
 namespace game
 {
@@ -47,6 +49,8 @@ class terrain
     min::texture_buffer _tbuffer;
     GLuint _dds_id;
     GLint _pre_loc;
+    GLint _origin_loc;
+    std::vector<min::vec3<float>> _origin;
 
     inline void load_texture()
     {
@@ -86,7 +90,7 @@ class terrain
           _tf(memory_map::memory.get_file("data/shader/terrain.fragment"), GL_FRAGMENT_SHADER),
           _prog(_tv, _tf),
 #endif
-          _gb(chunks)
+          _gb(chunks), _origin(chunks)
     {
         // Load texture
         load_texture();
@@ -101,6 +105,13 @@ class terrain
             throw std::runtime_error("terrain: could not find uniform 'preview'");
         }
 
+        // Get the origin uniform location
+        _origin_loc = glGetUniformLocation(_prog.id(), "origin");
+        if (_origin_loc == -1)
+        {
+            throw std::runtime_error("terrain: could not find uniform 'origin'");
+        }
+
         // Load the uniform buffer with program we will use
         uniforms.set_program_lights(_prog);
         uniforms.set_program_matrix(_prog);
@@ -121,6 +132,10 @@ class terrain
         // Update to use preview
         glUniform1i(_pre_loc, 1);
 
+        // Preview vertices are relative to the preview origin
+        const min::vec3<float> origin = terrain_mesher::preview_origin();
+        glUniform3f(_origin_loc, origin.x(), origin.y(), origin.z());
+
         // Draw placemarker
         _pb.draw_all(TERRAIN_DRAW_TYPE);
     }
@@ -138,12 +153,19 @@ class terrain
             // Bind array buffer
             _gb.bind_buffer(i);
 
+            // Chunk vertices are relative to the chunk origin
+            const min::vec3<float> &origin = _origin[i];
+            glUniform3f(_origin_loc, origin.x(), origin.y(), origin.z());
+
             // Draw graph-mesh
             _gb.draw_all(TERRAIN_DRAW_TYPE);
         }
     }
-    inline void upload_geometry(const size_t index, min::mesh<float, uint32_t> &child)
+    inline void upload_geometry(const size_t index, min::mesh<float, uint32_t> &child, const min::vec3<float> &origin)
     {
+        // Store the chunk origin for drawing
+        _origin[index] = origin;
+
         // Swap buffer index for this chunk
         _gb.set_buffer(index);
 
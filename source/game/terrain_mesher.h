@@ -18,10 +18,15 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_TERRAIN_MESHER_BDS_
 #define _BDS_TERRAIN_MESHER_BDS_
 
+#include <algorithm>
+#include <cstdint>
 #include <game/def.h>
 #include <game/geometry.h>
 #include <game/id.h>
 #include <game/work_queue.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #include <min/mesh.h>
 #include <min/tri.h>
 #include <min/vec3.h>
@@ -32,49 +37,196 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 namespace game
 {
 
+class greedy_quad
+{
+  private:
+    min::vec3<float> _min;
+    min::vec3<float> _max;
+    int_fast8_t _face;
+    int_fast8_t _atlas;
+
+  public:
+    greedy_quad(const min::vec3<float> &min, const min::vec3<float> &max, const int_fast8_t face, const int_fast8_t atlas)
+        : _min(min), _max(max), _face(face), _atlas(atlas) {}
+
+    inline int_fast8_t get_atlas() const
+    {
+        return _atlas;
+    }
+    inline int_fast8_t get_face() const
+    {
+        return _face;
+    }
+    inline const min::vec3<float> &get_max() const
+    {
+        return _max;
+    }
+    inline const min::vec3<float> &get_min() const
+    {
+        return _min;
+    }
+};
+
+inline size_t trailing_zeros(const uint64_t bits)
+{
+#ifdef _MSC_VER
+    // Bits must not be zero
+    unsigned long out;
+    _BitScanForward64(&out, bits);
+    return out;
+#else
+    // Bits must not be zero
+    return __builtin_ctzll(bits);
+#endif
+}
+
 class terrain_mesher
 {
   private:
     mutable std::vector<min::vec4<float>> _cells;
+    mutable std::vector<uint8_t> _faces;
+    mutable std::vector<uint64_t> _occupied;
+    mutable std::vector<uint64_t> _exposed;
+    mutable std::vector<greedy_quad> _quads;
+    mutable min::vec3<float> _origin;
+    const size_t _chunk_size;
+    bool _greedy;
 
     inline void allocate_mesh_vbo(min::mesh<float, uint32_t> &mesh) const
     {
         // Resize the mesh from cell size
         const size_t cell_size = _cells.size() * 6;
 
-        // Vertex sizes
+        // Vertex sizes, uv and normal are derived from the face code in the shader
         const size_t size = cell_size;
         mesh.vertex.resize(size);
-        mesh.uv.resize(size);
-        mesh.normal.resize(size);
-    }
-    static inline min::aabbox<float, min::vec3> create_box(const min::vec3<float> &center)
-    {
-        // Create box at center
-        const min::vec3<float> min = center - min::vec3<float>(0.5, 0.5, 0.5);
-        const min::vec3<float> max = center + min::vec3<float>(0.5, 0.5, 0.5);
-
-        // return the box
-        return min::aabbox<float, min::vec3>(min, max);
     }
     inline void generate_chunk_gs(min::mesh<float, uint32_t> &mesh) const
     {
-        // Copy vertices into mesh
+        // Copy chunk local cells into mesh
         const size_t size = _cells.size();
         mesh.vertex.resize(size);
         for (size_t i = 0; i < size; i++)
         {
-            mesh.vertex[i] = _cells[i];
+            mesh.vertex[i] = local_cell(_cells[i]);
         }
     }
     inline void generate_preview_gs(min::mesh<float, uint32_t> &mesh) const
     {
-        // Copy vertices into mesh
+        // Copy chunk local cells into mesh
         const size_t size = _cells.size();
         mesh.vertex.resize(size);
         for (size_t i = 0; i < size; i++)
         {
-            mesh.vertex[i] = _cells[i];
+            mesh.vertex[i] = local_cell(_cells[i]);
+        }
+    }
+    inline void generate_chunk_greedy(min::mesh<float, uint32_t> &mesh) const
+    {
+        // Nothing to merge
+        const size_t cell_size = _cells.size();
+        if (cell_size == 0)
+        {
+            return;
+        }
+
+        // Bin faces by face type and slice into 2D masks, storing atlas + 1
+        const size_t s = _chunk_size;
+        const size_t s2 = s * s;
+        const size_t s3 = s2 * s;
+        _faces.assign(6 * s3, 0);
+        for (const auto &c : _cells)
+        {
+            // Unpack the face type and atlas
+            const int_fast8_t face_type = static_cast<int>(c.w()) / 255;
+            const int_fast8_t atlas_id = static_cast<int>(c.w()) % 255;
+
+            // Calculate chunk local cell coordinates
+            const min::vec4<float> local = local_cell(c);
+            const size_t l[3] = {
+                static_cast<size_t>(local.x()),
+                static_cast<size_t>(local.y()),
+                static_cast<size_t>(local.z())};
+
+            // Slice along the face normal, mask along the other two axes
+            const size_t n = face_type / 2;
+            const size_t a = (n == 0) ? 1 : 0;
+            const size_t b = (n == 2) ? 1 : 2;
+            _faces[face_type * s3 + l[n] * s2 + l[a] * s + l[b]] = static_cast<uint8_t>(atlas_id + 1);
+        }
+
+        // Merge each mask into maximal rectangles
+        _quads.clear();
+        for (int_fast8_t face_type = 0; face_type < 6; face_type++)
+        {
+            const size_t n = face_type / 2;
+            const size_t a = (n == 0) ? 1 : 0;
+            const size_t b = (n == 2) ? 1 : 2;
+            for (size_t slice = 0; slice < s; slice++)
+            {
+                uint8_t *const mask = &_faces[face_type * s3 + slice * s2];
+                for (size_t i = 0; i < s; i++)
+                {
+                    for (size_t j = 0; j < s; j++)
+                    {
+                        const uint8_t id = mask[i * s + j];
+                        if (id == 0)
+                        {
+                            continue;
+                        }
+
+                        // Grow the rectangle along the mask row
+                        size_t w = 1;
+                        while (j + w < s && mask[i * s + j + w] == id)
+                        {
+                            w++;
+                        }
+
+                        // Grow the rectangle across rows while the whole row matches
+                        size_t h = 1;
+                        for (; i + h < s; h++)
+                        {
+                            const uint8_t *const row = &mask[(i + h) * s + j];
+                            if (std::any_of(row, row + w, [id](const uint8_t v) { return v != id; }))
+                            {
+                                break;
+                            }
+                        }
+
+                        // Clear the merged faces
+                        for (size_t k = 0; k < h; k++)
+                        {
+                            std::fill_n(&mask[(i + k) * s + j], w, 0);
+                        }
+
+                        // Calculate the merged box in chunk local space
+                        float lo[3];
+                        float ext[3];
+                        lo[n] = slice;
+                        lo[a] = i;
+                        lo[b] = j;
+                        ext[n] = 1.0;
+                        ext[a] = h;
+                        ext[b] = w;
+                        const min::vec3<float> min(lo[0], lo[1], lo[2]);
+                        const min::vec3<float> max = min + min::vec3<float>(ext[0], ext[1], ext[2]);
+                        _quads.emplace_back(min, max, face_type, static_cast<int_fast8_t>(id - 1));
+                    }
+                }
+            }
+        }
+
+        // Allocate the mesh for the merged quads
+        const size_t size = _quads.size() * 6;
+        mesh.vertex.resize(size);
+
+        // Convert quads to mesh
+        const size_t quads = _quads.size();
+        for (size_t i = 0; i < quads; i++)
+        {
+            const greedy_quad &q = _quads[i];
+            const size_t vertex_start = i * 6;
+            face_vertex(mesh.vertex, vertex_start, q.get_min(), q.get_max(), q.get_face(), face_code(q.get_face(), q.get_atlas()));
         }
     }
     inline void generate_chunk_vbo(min::mesh<float, uint32_t> &mesh) const
@@ -111,6 +263,19 @@ class terrain_mesher
             }
         }
     }
+    inline min::vec4<float> local_cell(const min::vec4<float> &cell) const
+    {
+        // Convert the cell center to the chunk local cell corner
+        const float x = cell.x() - 0.5 - _origin.x();
+        const float y = cell.y() - 0.5 - _origin.y();
+        const float z = cell.z() - 0.5 - _origin.z();
+
+        // Repack the face type and atlas
+        const int_fast8_t face_type = static_cast<int>(cell.w()) / 255;
+        const int_fast8_t atlas_id = static_cast<int>(cell.w()) % 255;
+
+        return min::vec4<float>(x, y, z, face_code(face_type, atlas_id));
+    }
     inline void reserve_memory(const size_t chunk_size) const
     {
         // Reserve maximum number of cells in a chunk
@@ -119,34 +284,25 @@ class terrain_mesher
     }
     inline void set_face(const size_t index, min::mesh<float, uint32_t> &mesh) const
     {
-        // Unpack the point and the atlas
-        const min::vec4<float> &unpack = _cells[index];
+        // Unpack the chunk local cell and the face code
+        const min::vec4<float> unpack = local_cell(_cells[index]);
 
         // Calculate vertex start position
         const size_t vertex_start = index * 6;
 
-        // Create bounding box of face and get box dimensions
-        const min::vec3<float> p = min::vec3<float>(unpack.x(), unpack.y(), unpack.z());
-        const min::aabbox<float, min::vec3> b = create_box(p);
-        const min::vec3<float> &min = b.get_min();
-        const min::vec3<float> &max = b.get_max();
+        // Create unit box of face
+        const min::vec3<float> min(unpack.x(), unpack.y(), unpack.z());
+        const min::vec3<float> max = min + min::vec3<float>(1.0, 1.0, 1.0);
 
-        // Extract the face type and atlas
-        const int_fast8_t face_type = static_cast<int>(unpack.w()) / 255;
-        const int_fast8_t atlas_id = static_cast<int>(unpack.w()) % 255;
+        // Extract the face type
+        const int_fast8_t face_type = static_cast<int>(unpack.w()) & 7;
 
         // Calculate face vertices
-        face_vertex(mesh.vertex, vertex_start, min, max, face_type);
-
-        // Calculate face uv's
-        face_uv(mesh.uv, vertex_start, face_type, atlas_id);
-
-        // Calculate face normals
-        face_normal(mesh.normal, vertex_start, face_type);
+        face_vertex(mesh.vertex, vertex_start, min, max, face_type, unpack.w());
     }
 
   public:
-    terrain_mesher(const size_t chunk_size)
+    terrain_mesher(const size_t chunk_size) : _chunk_size(chunk_size), _greedy(false)
     {
         reserve_memory(chunk_size);
     }
@@ -154,6 +310,29 @@ class terrain_mesher
     {
         _cells.clear();
     }
+    inline const min::vec3<float> &get_origin() const
+    {
+        return _origin;
+    }
+    inline bool is_greedy() const
+    {
+        return _greedy;
+    }
+    inline void set_greedy(const bool flag)
+    {
+        _greedy = flag;
+    }
+    inline void set_origin(const min::vec3<float> &origin) const
+    {
+        // Mesh vertices are stored relative to this corner
+        _origin = origin;
+    }
+    inline static min::vec3<float> preview_origin()
+    {
+        // Previews are built around the world origin, extend at most 6 cells along each axis,
+        // and place cell centers on grid corners so the origin is offset by half a cell
+        return min::vec3<float>(-8.5, -8.5, -8.5);
+    }
     template <typename GB>
     inline void generate_chunk_faces(
         const min::vec3<float> &p,
@@ -227,6 +406,171 @@ class terrain_mesher
             }
         }
     }
+    inline void generate_chunk_strided(const std::vector<block_id> &padded) const
+    {
+        // Padded chunk has a one cell apron on each side, x major, see chunk_store::copy_apron
+        const size_t s = _chunk_size;
+        const size_t as = s + 2;
+        const size_t as2 = as * as;
+
+        // Neighbors are at fixed strides, the apron removes all edge checks
+        for (size_t x = 1; x <= s; x++)
+        {
+            for (size_t y = 1; y <= s; y++)
+            {
+                // Cell center of the first cell in this row
+                const float px = _origin.x() + x - 0.5;
+                const float py = _origin.y() + y - 0.5;
+                const float pz = _origin.z() + 0.5;
+
+                const size_t row = (x * as + y) * as + 1;
+                for (size_t z = 0; z < s; z++)
+                {
+                    const size_t i = row + z;
+                    const block_id atlas = padded[i];
+                    if (atlas == block_id::EMPTY)
+                    {
+                        continue;
+                    }
+
+                    // Generate faces in the same order as generate_chunk_faces
+                    const float float_atlas = static_cast<float>(atlas);
+                    const float fz = pz + z;
+                    if (padded[i - as2] == block_id::EMPTY)
+                    {
+                        _cells.push_back(min::vec4<float>(px, py, fz, float_atlas + 0.1));
+                    }
+                    if (padded[i + as2] == block_id::EMPTY)
+                    {
+                        _cells.push_back(min::vec4<float>(px, py, fz, float_atlas + 255.1));
+                    }
+                    if (padded[i - as] == block_id::EMPTY)
+                    {
+                        _cells.push_back(min::vec4<float>(px, py, fz, float_atlas + 510.1));
+                    }
+                    if (padded[i + as] == block_id::EMPTY)
+                    {
+                        _cells.push_back(min::vec4<float>(px, py, fz, float_atlas + 765.1));
+                    }
+                    if (padded[i - 1] == block_id::EMPTY)
+                    {
+                        _cells.push_back(min::vec4<float>(px, py, fz, float_atlas + 1020.1));
+                    }
+                    if (padded[i + 1] == block_id::EMPTY)
+                    {
+                        _cells.push_back(min::vec4<float>(px, py, fz, float_atlas + 1275.1));
+                    }
+                }
+            }
+        }
+    }
+    inline void generate_chunk_masked(const std::vector<block_id> &padded) const
+    {
+        // Padded rows along z must fit in one 64 bit word
+        const size_t s = _chunk_size;
+        const size_t as = s + 2;
+        const size_t as2 = as * as;
+
+        // Build occupancy rows, one bit per cell, cells outside the world count as occupied
+        _occupied.resize(as2);
+        for (size_t r = 0; r < as2; r++)
+        {
+            const block_id *const cells = &padded[r * as];
+            uint64_t bits = 0;
+            for (size_t z = 0; z < as; z++)
+            {
+                bits |= static_cast<uint64_t>(cells[z] != block_id::EMPTY) << z;
+            }
+            _occupied[r] = bits;
+        }
+
+        // Only interior cells generate faces
+        const uint64_t inner = ((static_cast<uint64_t>(1) << s) - 1) << 1;
+
+        // Exposed face masks for one x slice, six masks per row
+        _exposed.resize(6 * as);
+        uint64_t *const nx = &_exposed[0];
+        uint64_t *const px = nx + as;
+        uint64_t *const ny = px + as;
+        uint64_t *const py = ny + as;
+        uint64_t *const nz = py + as;
+        uint64_t *const pz = nz + as;
+        for (size_t x = 1; x <= s; x++)
+        {
+            const uint64_t *const prev = &_occupied[(x - 1) * as];
+            const uint64_t *const curr = &_occupied[x * as];
+            const uint64_t *const next = &_occupied[(x + 1) * as];
+
+            // Shifts and ANDs over whole rows, this loop has no branches and vectorizes
+            for (size_t y = 1; y <= s; y++)
+            {
+                const uint64_t solid = curr[y] & inner;
+                nx[y] = solid & ~prev[y];
+                px[y] = solid & ~next[y];
+                ny[y] = solid & ~curr[y - 1];
+                py[y] = solid & ~curr[y + 1];
+                nz[y] = solid & ~(curr[y] << 1);
+                pz[y] = solid & ~(curr[y] >> 1);
+            }
+
+            // Expand only the set bits into faces
+            for (size_t y = 1; y <= s; y++)
+            {
+                const float fx = _origin.x() + x - 0.5;
+                const float fy = _origin.y() + y - 0.5;
+                const float fz0 = _origin.z() + 0.5;
+                const size_t row = (x * as + y) * as;
+                uint64_t any = nx[y] | px[y] | ny[y] | py[y] | nz[y] | pz[y];
+                while (any)
+                {
+                    // Generate faces in the same order as generate_chunk_faces
+                    const size_t z = trailing_zeros(any);
+                    const uint64_t bit = static_cast<uint64_t>(1) << z;
+                    const float float_atlas = static_cast<float>(padded[row + z]);
+                    const float fz = fz0 + (z - 1);
+                    if (nx[y] & bit)
+                    {
+                        _cells.push_back(min::vec4<float>(fx, fy, fz, float_atlas + 0.1));
+                    }
+                    if (px[y] & bit)
+                    {
+                        _cells.push_back(min::vec4<float>(fx, fy, fz, float_atlas + 255.1));
+                    }
+                    if (ny[y] & bit)
+                    {
+                        _cells.push_back(min::vec4<float>(fx, fy, fz, float_atlas + 510.1));
+                    }
+                    if (py[y] & bit)
+                    {
+                        _cells.push_back(min::vec4<float>(fx, fy, fz, float_atlas + 765.1));
+                    }
+                    if (nz[y] & bit)
+                    {
+                        _cells.push_back(min::vec4<float>(fx, fy, fz, float_atlas + 1020.1));
+                    }
+                    if (pz[y] & bit)
+                    {
+                        _cells.push_back(min::vec4<float>(fx, fy, fz, float_atlas + 1275.1));
+                    }
+
+                    // Clear the lowest set bit
+                    any &= any - 1;
+                }
+            }
+        }
+    }
+    inline void generate_chunk_padded(const std::vector<block_id> &padded) const
+    {
+        // Use occupancy bitmasks when a padded row fits in 64 bits
+        if (_chunk_size + 2 <= 64)
+        {
+            generate_chunk_masked(padded);
+        }
+        else
+        {
+            generate_chunk_strided(padded);
+        }
+    }
     inline void generate_place_faces_rotated(
         const min::vec3<float> &p, const min::tri<int> &offset,
         const min::tri<size_t> &index,
@@ -374,7 +718,30 @@ class terrain_mesher
 #ifdef MGL_GS_RENDER
         generate_chunk_gs(mesh);
 #else
-        generate_chunk_vbo(mesh);
+        if (_greedy)
+        {
+            generate_chunk_greedy(mesh);
+        }
+        else
+        {
+            generate_chunk_vbo(mesh);
+        }
+#endif
+    }
+    inline void generate_chunk_serial(min::mesh<float, uint32_t> &mesh) const
+    {
+#ifdef MGL_GS_RENDER
+        generate_chunk_gs(mesh);
+#else
+        // Does not touch the shared worker pool
+        if (_greedy)
+        {
+            generate_chunk_greedy(mesh);
+        }
+        else
+        {
+            generate_preview_vbo(mesh);
+        }
 #endif
     }
     inline void generate_preview(min::mesh<float, uint32_t> &mesh) const
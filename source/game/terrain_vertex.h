@@ -18,7 +18,9 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_TERRAIN_VERTEX_BDS_
 #define _BDS_TERRAIN_VERTEX_BDS_
 
+#include <cstdint>
 #include <cstring>
+#include <game/geometry.h>
 #include <min/mesh.h>
 #include <min/vec4.h>
 #include <min/window.h>
@@ -27,14 +29,21 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 namespace game
 {
 
-#ifdef MGL_GS_RENDER
-
+// Each terrain vertex is packed into one 32 bit word, see face_pack()
+// bits 0-6: chunk local x, bits 7-13: chunk local y, bits 14-20: chunk local z
+// bits 21-23: face type, bits 24-29: atlas id
+// With MGL_GS_RENDER a vertex is one face and the position is the cell corner,
+// otherwise a face is six vertices and the position is the face corner.
+// The shader adds the chunk origin and derives uv and normal from the face type.
 template <typename T, typename K, GLenum FLOAT_TYPE>
 class terrain_vertex
 {
   private:
+    // Packed vertices are stored in the float buffer bit for bit
+    static_assert(sizeof(T) == sizeof(uint32_t), "terrain_vertex: packed vertex must be the size of T");
+
     // These are the struct member sizes
-    static constexpr size_t vertex_size = sizeof(min::vec4<T>);
+    static constexpr size_t vertex_size = sizeof(uint32_t);
 
     // Compute the size of struct in bytes
     static constexpr size_t width_bytes = vertex_size;
@@ -56,11 +65,11 @@ class terrain_vertex
     inline static void create_vertex_attributes()
     {
 #ifdef MGL_VB43
-        // Specify the vertex attributes in location = 0, no offset
-        glVertexAttribFormat(0, 4, FLOAT_TYPE, GL_FALSE, 0);
+        // Specify the packed vertex attribute in location = 0, no offset
+        glVertexAttribIFormat(0, 1, GL_UNSIGNED_INT, 0);
 #else
-        // Specify the vertex attributes in location = 0, no offset
-        glVertexAttribPointer(0, 4, FLOAT_TYPE, GL_FALSE, width_bytes, nullptr);
+        // Specify the packed vertex attribute in location = 0, no offset
+        glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, width_bytes, nullptr);
 #endif
     }
     inline static void create_buffer_binding(const GLuint vbo, const GLuint bind_point)
@@ -95,136 +104,11 @@ class terrain_vertex
         const auto vert_size = m.vertex.size();
         for (size_t i = 0, j = mesh_offset; i < vert_size; i++, j += width_size)
         {
-            // Copy the vertex data, 4 floats
-            std::memcpy(&data[j], &m.vertex[i], vertex_size);
-        }
-    }
-    inline static void destroy()
-    {
-        // Disable the vertex attributes before destruction
-        disable_attributes();
-    }
-    inline static void disable_attributes()
-    {
-        // Disable the vertex attributes
-        glDisableVertexAttribArray(0);
-    }
-    inline static void enable_attributes()
-    {
-        glEnableVertexAttribArray(0);
-    }
-    inline static constexpr size_t width()
-    {
-        return width_size;
-    }
-    inline static constexpr GLenum buffer_type()
-    {
-        return GL_DYNAMIC_DRAW;
-    }
-};
-
-#else
-
-template <typename T, typename K, GLenum FLOAT_TYPE>
-class terrain_vertex
-{
-  private:
-    // Turn the Struct of Array (SoA) data into Array of Structs (AoS)
-
-    // These are the struct member sizes
-    static constexpr size_t vertex_size = sizeof(min::vec4<T>);
-    static constexpr size_t uv_size = sizeof(min::vec2<T>);
-    static constexpr size_t normal_size = sizeof(min::vec3<T>);
+            // Pack the chunk local vertex into one word
+            const uint32_t packed = face_pack(m.vertex[i]);
 
-    // These are the struct member offsets in floats, not bytes
-    static constexpr size_t uv_off = vertex_size / sizeof(T);
-    static constexpr size_t normal_off = uv_off + (uv_size / sizeof(T));
-
-    // Compute the size of struct in bytes
-    static constexpr size_t width_bytes = vertex_size + uv_size + normal_size;
-
-    // Compute the size of struct in floats
-    static constexpr size_t width_size = width_bytes / sizeof(T);
-
-  public:
-    inline static void change_bind_buffer(const GLuint vbo)
-    {
-#ifdef MGL_VB43
-        // No offset, standard stride, binding point 0
-        glBindVertexBuffer(0, vbo, 0, width_bytes);
-#else
-        // Redundantly recreate the vertex attributes
-        create_vertex_attributes();
-#endif
-    }
-    inline static void create_vertex_attributes()
-    {
-#ifdef MGL_VB43
-        // Specify the vertex attributes in location = 0, no offset
-        glVertexAttribFormat(0, 4, FLOAT_TYPE, GL_FALSE, 0);
-        // Specify the uv attributes in location = 1, offset is in bytes
-        glVertexAttribFormat(1, 2, FLOAT_TYPE, GL_FALSE, uv_off * sizeof(T));
-        // Specify the normal attributes in location = 2, offset is in bytes
-        glVertexAttribFormat(2, 3, FLOAT_TYPE, GL_FALSE, normal_off * sizeof(T));
-#else
-        // Specify the vertex attributes in location = 0, no offset
-        glVertexAttribPointer(0, 4, FLOAT_TYPE, GL_FALSE, width_bytes, nullptr);
-        // Specify the uv attributes in location = 1, offset is in bytes
-        glVertexAttribPointer(1, 2, FLOAT_TYPE, GL_FALSE, width_bytes, (GLvoid *)(uv_off * sizeof(T)));
-        // Specify the normal attributes in location = 2, offset is in bytes
-        glVertexAttribPointer(2, 3, FLOAT_TYPE, GL_FALSE, width_bytes, (GLvoid *)(normal_off * sizeof(T)));
-#endif
-    }
-    inline static void create_buffer_binding(const GLuint vbo, const GLuint bind_point)
-    {
-#ifdef MGL_VB43
-        //  Create the buffer binding point
-        glVertexAttribBinding(0, bind_point);
-        glVertexAttribBinding(1, bind_point);
-        glVertexAttribBinding(2, bind_point);
-
-        // No offset, standard stride, binding point 0
-        glBindVertexBuffer(bind_point, vbo, 0, width_bytes);
-#endif
-    }
-    inline static void create(const GLuint vbo)
-    {
-        // Enable the attributes
-        enable_attributes();
-
-        // Create the vertex attributes
-        create_vertex_attributes();
-
-#ifdef MGL_VB43
-        // Create the buffer binding point
-        create_buffer_binding(vbo, 0);
-#endif
-    }
-    inline static void check(const min::mesh<T, K> &m)
-    {
-        // Verify normal, tangent and bitangent sizes
-        const auto vert_size = m.vertex.size();
-        if (m.uv.size() != vert_size || m.normal.size() != vert_size)
-        {
-            throw std::runtime_error("terrain_vertex: vertex, uv, or normals invalid length");
-        }
-    }
-    inline static void copy(std::vector<T> &data, const min::mesh<T, K> &m, const size_t mesh_offset)
-    {
-        const size_t size = m.vertex.size();
-        for (size_t i = 0; i < size; i++)
-        {
-            // Calculate index into data buffer
-            const size_t j = mesh_offset + (i * width_size);
-
-            // Copy the vertex data, 4 floats
-            std::memcpy(&data[j], &m.vertex[i], vertex_size);
-
-            // Copy the uv data, 2 floats, offset is in number of floats
-            std::memcpy(&data[j + uv_off], &m.uv[i], uv_size);
-
-            // Copy the normal data, 3 floats, offset is in number of floats
-            std::memcpy(&data[j + normal_off], &m.normal[i], normal_size);
+            // Copy the packed vertex data, 1 float
+            std::memcpy(&data[j], &packed, vertex_size);
         }
     }
     inline static void destroy()
@@ -236,14 +120,10 @@ class terrain_vertex
     {
         // Disable the vertex attributes
         glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
     }
     inline static void enable_attributes()
     {
         glEnableVertexAttribArray(0);
-        glEnableVertexAttribArray(1);
-        glEnableVertexAttribArray(2);
     }
     inline static constexpr size_t width()
     {
@@ -254,7 +134,6 @@ class terrain_vertex
         return GL_DYNAMIC_DRAW;
     }
 };
-#endif
 }
 
 #endif
@@ -510,7 +510,7 @@ class ui_overlay
     inline void update(const min::vec3<float> &p, const min::vec3<float> &dir,
                        const float health, const float energy, const double fps,
                        const double idle, const size_t chunks, const size_t insts,
-                       const std::string &target, const float time, const float dt)
+                       const size_t paths, const double latency, const std::string &target, const float time, const float dt)
     {
         // If menu needs updating
         if (_menu.is_dirty())
@@ -533,6 +533,7 @@ class ui_overlay
             _text.set_debug_idle(idle);
             _text.set_debug_chunks(chunks);
             _text.set_debug_insts(insts);
+            _text.set_debug_paths(paths, latency);
             _text.set_debug_target(target);
         }
 
@@ -66,7 +66,7 @@ class ui_text
     static constexpr size_t _ui = _timer + 1;
     static constexpr size_t _alert = _ui + 2;
     static constexpr size_t _debug = _alert + 1;
-    static constexpr size_t _stream = _debug + 14;
+    static constexpr size_t _stream = _debug + 15;
     static constexpr size_t _menu = _stream + _max_stream;
     static constexpr size_t _text_end = _menu + ui_menu::max_size();
 
@@ -657,6 +657,15 @@ class ui_text
         _ss << "INSTANCES: " << insts;
         _text.set_text(_debug + 10, _ss.str());
     }
+    inline void set_debug_paths(const size_t paths, const double latency)
+    {
+        // Clear and reset the stream
+        clear_stream();
+
+        // Update path queue depth and average latency in milliseconds
+        _ss << "PATHS: " << paths << " (" << std::round(latency) << " ms)";
+        _text.set_text(_debug + 11, _ss.str());
+    }
     inline void set_debug_target(const std::string &str)
     {
         // Clear and reset the stream
@@ -664,15 +673,15 @@ class ui_text
 
         // Update FPS and IDLE
         _ss << "TARGET: " << str;
-        _text.set_text(_debug + 11, _ss.str());
+        _text.set_text(_debug + 12, _ss.str());
     }
     inline void set_debug_version(const std::string &str)
     {
-        _text.set_text(_debug + 12, str);
+        _text.set_text(_debug + 13, str);
     }
     inline void set_debug_game_mode(const std::string &str)
     {
-        _text.set_text(_debug + 13, str);
+        _text.set_text(_debug + 14, str);
     }
     inline void set_focus(const std::string &str)
     {
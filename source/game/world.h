@@ -848,7 +848,7 @@ class world
             if (_grid.is_update_chunk(i))
             {
                 // Upload contents to the vertex buffer
-                _terrain.upload_geometry(i, _grid.get_chunk(i));
+                _terrain.upload_geometry(i, _grid.get_chunk(i), _grid.get_chunk_origin(i));
 
                 // Flag that we updated the chunk
                 _grid.update_chunk(i);
@@ -1103,6 +1103,14 @@ class world
     {
         return _instance.get_inst_in_view();
     }
+    inline size_t get_path_depth() const
+    {
+        return _grid.get_path_queue().get_depth();
+    }
+    inline double get_path_latency() const
+    {
+        return _grid.get_path_queue().get_latency_avg();
+    }
     inline const load_state &get_load_state() const
     {
         return _state;
@@ -1528,7 +1536,7 @@ class world
             if (_grid.is_update_chunk(i))
             {
                 // Upload contents to the vertex buffer
-                _terrain.upload_geometry(i, _grid.get_chunk(i));
+                _terrain.upload_geometry(i, _grid.get_chunk(i), _grid.get_chunk_origin(i));
 
                 // Flag that we updated the chunk
                 _grid.update_chunk(i);
@@ -19,6 +19,8 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #define _BDS_MANDELBULB_ASYM_BDS_
 
 #include <game/id.h>
+#include <kernel/mandelbulb_batch.h>
+#include <kernel/mandelbulb_fold.h>
 #include <min/thread_pool.h>
 #include <min/vec3.h>
 
@@ -40,6 +42,10 @@ class mandelbulb_asym
     int _j;
     int _k;
     int _l;
+    simd_level _simd;
+    bool _fold;
+    std::vector<game::block_id> _classes;
+    size_t _class_size;
     inline static float pow9(const float x)
     {
         return x * x * x * x * x * x * x * x * x;
@@ -74,26 +80,8 @@ class mandelbulb_asym
         size_t iterations = 0;
         for (size_t i = 0; i < 32; i++)
         {
-            // X coordinate
-            const float dx = (y0 * y0 + z0 * z0);
-            const float dx2 = dx * dx;
-            const float dx3 = dx2 * dx;
-            const float dx4 = dx3 * dx;
-            x1 = pow9(x0) - _a * pow7(x0) * dx + _b * pow5(x0) * dx2 - _c * pow3(x0) * dx3 + _d * x0 * dx4 + x0;
-
-            // Y coordinate
-            const float dy = (z0 * z0 + x0 * x0);
-            const float dy2 = dy * dy;
-            const float dy3 = dy2 * dy;
-            const float dy4 = dy3 * dy;
-            y1 = pow9(y0) - _e * pow7(y0) * dy + _f * pow5(y0) * dy2 - _g * pow3(y0) * dy3 + _h * y0 * dy4 + y0;
-
-            // Z coordinate
-            const float dz = (x0 * x0 + y0 * y0);
-            const float dz2 = dz * dz;
-            const float dz3 = dz2 * dz;
-            const float dz4 = dz3 * dz;
-            z1 = pow9(z0) - _i * pow7(z0) * dz + _j * pow5(z0) * dz2 - _k * pow3(z0) * dz3 + _l * z0 * dz4 + z0;
+            // Do one iteration
+            iterate(x0, y0, z0, x1, y1, z1);
 
             if (std::abs(x1 - x0) < 1E-3 && std::abs(y1 - y0) < 1E-3 && std::abs(z1 - z0) < 1E-3)
             {
@@ -102,6 +90,12 @@ class mandelbulb_asym
                 break;
             }
 
+            // A non-finite coordinate stays non-finite, this cell can never converge
+            if (!std::isfinite(x1) || !std::isfinite(y1) || !std::isfinite(z1))
+            {
+                break;
+            }
+
             // Prime next loop
             x0 = x1;
             y0 = y1;
@@ -123,9 +117,10 @@ class mandelbulb_asym
                     const int i, const int j, const int k, const int l)
         : _a(a), _b(b), _c(c), _d(d),
           _e(e), _f(f), _g(g), _h(h),
-          _i(i), _j(j), _k(k), _l(l) {}
+          _i(i), _j(j), _k(k), _l(l), _simd(simd_support()), _fold(true), _class_size(0) {}
 
     mandelbulb_asym(std::mt19937 &rng)
+        : _simd(simd_support()), _fold(true), _class_size(0)
     {
         // Generate bucket tiers
         std::uniform_int_distribution<int> bucket(0, 5);
@@ -167,6 +162,28 @@ class mandelbulb_asym
     template <typename F>
     inline void generate(min::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
     {
+        // Iterate one cell per symmetry class and mirror the result if the grid allows
+        if (_fold && mandelbulb_fold(pool, _simd, fold_symmetry::mirror, *this, grid, gsize, f))
+        {
+            return;
+        }
+
+        // Iterate blocks of cells in lockstep if the CPU supports it
+        if (_simd != simd_level::scalar)
+        {
+            const size_t lanes = simd_lanes(_simd);
+            const size_t blocks = (grid.size() + lanes - 1) / lanes;
+            const size_t d = static_cast<size_t>(gsize * 0.6667);
+            const simd_level level = _simd;
+            const auto work = [this, &grid, d, &f, level](std::mt19937 &gen, const size_t b) {
+                mandelbulb_batch(level, *this, grid, b, d, f);
+            };
+
+            // Run the job in parallel
+            pool.run(std::cref(work), 0, blocks);
+            return;
+        }
+
         // Create working function
         const auto work = [this, &grid, gsize, &f](std::mt19937 &gen, const size_t i) {
             // Do mandelbulb on this cell if empty
@@ -179,6 +196,65 @@ class mandelbulb_asym
         // Run the job in parallel
         pool.run(std::cref(work), 0, grid.size());
     }
+    template <typename F>
+    inline void generate_chunk(const min::tri<size_t> &start, std::vector<game::block_id> &cells, const size_t chunk_size, const size_t gsize, const F &f) const
+    {
+        // Mirror the class results prepared for this grid
+        if (_class_size == gsize)
+        {
+            fold_chunk(fold_symmetry::mirror, _classes, gsize, start, cells, chunk_size);
+            return;
+        }
+
+        // Iterate the empty cells of the chunk in lockstep
+        mandelbulb_chunk(_simd, *this, start, cells, chunk_size, gsize, f);
+    }
+    inline bool get_fold() const
+    {
+        return _fold;
+    }
+    inline simd_level get_simd() const
+    {
+        return _simd;
+    }
+    inline void iterate(const float x0, const float y0, const float z0, float &x1, float &y1, float &z1) const
+    {
+        // X coordinate
+        const float dx = (y0 * y0 + z0 * z0);
+        const float dx2 = dx * dx;
+        const float dx3 = dx2 * dx;
+        const float dx4 = dx3 * dx;
+        x1 = pow9(x0) - _a * pow7(x0) * dx + _b * pow5(x0) * dx2 - _c * pow3(x0) * dx3 + _d * x0 * dx4 + x0;
+
+        // Y coordinate
+        const float dy = (z0 * z0 + x0 * x0);
+        const float dy2 = dy * dy;
+        const float dy3 = dy2 * dy;
+        const float dy4 = dy3 * dy;
+        y1 = pow9(y0) - _e * pow7(y0) * dy + _f * pow5(y0) * dy2 - _g * pow3(y0) * dy3 + _h * y0 * dy4 + y0;
+
+        // Z coordinate
+        const float dz = (x0 * x0 + y0 * y0);
+        const float dz2 = dz * dz;
+        const float dz3 = dz2 * dz;
+        const float dz4 = dz3 * dz;
+        z1 = pow9(z0) - _i * pow7(z0) * dz + _j * pow5(z0) * dz2 - _k * pow3(z0) * dz3 + _l * z0 * dz4 + z0;
+    }
+    template <typename F>
+    inline void prepare(min::thread_pool &pool, const size_t gsize, const F &f)
+    {
+        // Iterate one cell per symmetry class once for every chunk if the grid allows
+        const bool fold = _fold && fold_classes(pool, _simd, fold_symmetry::mirror, *this, gsize, f, _classes);
+        _class_size = fold ? gsize : 0;
+    }
+    inline void set_fold(const bool flag)
+    {
+        _fold = flag;
+    }
+    inline void set_simd(const simd_level level)
+    {
+        _simd = level;
+    }
 };
 }
 
@@ -0,0 +1,236 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_MANDELBULB_BATCH_BDS_
+#define _BDS_MANDELBULB_BATCH_BDS_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <game/id.h>
+#include <kernel/simd.h>
+#include <limits>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace kernel
+{
+
+template <size_t N, typename K>
+BDS_SIMD_INLINE void mandelbulb_lanes(const K &k, float *x0, float *y0, float *z0, game::block_id *out)
+{
+    // Iteration each lane converged on, -1 while still running, -2 once it escaped
+    int32_t iterations[N];
+    for (size_t l = 0; l < N; l++)
+    {
+        iterations[l] = -1;
+    }
+
+    // Iterate all lanes in lockstep until every lane converged or escaped
+    for (int32_t i = 0; i < 32; i++)
+    {
+        int32_t running = 0;
+        for (size_t l = 0; l < N; l++)
+        {
+            // Same step as the scalar kernel
+            float x1, y1, z1;
+            k.iterate(x0[l], y0[l], z0[l], x1, y1, z1);
+            const bool converged = (std::abs(x1 - x0[l]) < 1E-3) & (std::abs(y1 - y0[l]) < 1E-3) & (std::abs(z1 - z0[l]) < 1E-3);
+
+            // A non-finite coordinate stays non-finite, the lane can never converge
+            const float max = std::numeric_limits<float>::max();
+            const bool finite = (std::abs(x1) <= max) & (std::abs(y1) <= max) & (std::abs(z1) <= max);
+
+            // Freeze lanes that already converged or escaped
+            const bool live = iterations[l] == -1;
+            iterations[l] = (live & converged) ? i : (live & !finite) ? -2 : iterations[l];
+            x0[l] = live ? x1 : x0[l];
+            y0[l] = live ? y1 : y0[l];
+            z0[l] = live ? z1 : z0[l];
+            running |= live & !converged & finite;
+        }
+
+        // Early exit when the whole batch converged or escaped
+        if (!running)
+        {
+            break;
+        }
+    }
+
+    // If we converged return atlas
+    for (size_t l = 0; l < N; l++)
+    {
+        out[l] = (iterations[l] >= 0) ? static_cast<game::block_id>(iterations[l] % 21) : game::block_id::EMPTY;
+    }
+}
+
+template <size_t N, typename K, typename F>
+BDS_SIMD_INLINE void mandelbulb_cells(const K &k, const size_t *keys, const size_t count, const size_t d, const F &f, game::block_id *out)
+{
+    float x[N];
+    float y[N];
+    float z[N];
+    game::block_id ids[N];
+
+    // Set start points
+    for (size_t l = 0; l < count; l++)
+    {
+        const min::vec3<float> p = f(keys[l]);
+        x[l] = p.x() / d;
+        y[l] = p.y() / d;
+        z[l] = p.z() / d;
+    }
+
+    // Pad unused lanes with the last cell, it converges with the batch
+    for (size_t l = count; l < N; l++)
+    {
+        x[l] = x[count - 1];
+        y[l] = y[count - 1];
+        z[l] = z[count - 1];
+    }
+
+    // Run the lanes and copy out the results
+    mandelbulb_lanes<N>(k, x, y, z, ids);
+    for (size_t l = 0; l < count; l++)
+    {
+        out[l] = ids[l];
+    }
+}
+
+#ifdef BDS_SIMD_DISPATCH
+template <typename K, typename F>
+__attribute__((target("avx2"))) inline void mandelbulb_cells_avx2(const K &k, const size_t *keys, const size_t count, const size_t d, const F &f, game::block_id *out)
+{
+    mandelbulb_cells<8>(k, keys, count, d, f, out);
+}
+template <typename K, typename F>
+__attribute__((target("avx512f"))) inline void mandelbulb_cells_avx512(const K &k, const size_t *keys, const size_t count, const size_t d, const F &f, game::block_id *out)
+{
+    mandelbulb_cells<16>(k, keys, count, d, f, out);
+}
+#endif
+
+template <typename K, typename F>
+inline void mandelbulb_batch(const simd_level level, const K &k, const size_t *keys, const size_t count, const size_t d, const F &f, game::block_id *out)
+{
+#ifdef BDS_SIMD_DISPATCH
+    // Call the lane kernel compiled for this instruction set
+    if (level == simd_level::avx512)
+    {
+        mandelbulb_cells_avx512(k, keys, count, d, f, out);
+        return;
+    }
+    else if (level == simd_level::avx2)
+    {
+        mandelbulb_cells_avx2(k, keys, count, d, f, out);
+        return;
+    }
+#endif
+
+    // One cell at a time
+    for (size_t i = 0; i < count; i++)
+    {
+        mandelbulb_cells<1>(k, &keys[i], 1, d, f, &out[i]);
+    }
+}
+
+template <typename K, typename F>
+inline void mandelbulb_chunk(const simd_level level, const K &k, const min::tri<size_t> &start, std::vector<game::block_id> &cells,
+                             const size_t chunk_size, const size_t gsize, const F &f)
+{
+    size_t keys[16];
+    size_t index[16];
+    game::block_id out[16];
+
+    // Gather the empty cells of the chunk into lane sized blocks, rows along Z are contiguous
+    const size_t lanes = simd_lanes(level);
+    const size_t d = static_cast<size_t>(gsize * 0.6667);
+    size_t count = 0;
+    for (size_t x = 0, c = 0; x < chunk_size; x++)
+    {
+        for (size_t y = 0; y < chunk_size; y++)
+        {
+            const size_t row = ((start.x() + x) * gsize + start.y() + y) * gsize + start.z();
+            for (size_t z = 0; z < chunk_size; z++, c++)
+            {
+                if (cells[c] == game::block_id::EMPTY)
+                {
+                    keys[count] = row + z;
+                    index[count++] = c;
+                }
+
+                // Run the lanes and scatter the results when the block is full
+                if (count == lanes)
+                {
+                    mandelbulb_batch(level, k, keys, count, d, f, out);
+                    for (size_t l = 0; l < count; l++)
+                    {
+                        cells[index[l]] = out[l];
+                    }
+                    count = 0;
+                }
+            }
+        }
+    }
+
+    // Run the last partial block
+    if (count > 0)
+    {
+        mandelbulb_batch(level, k, keys, count, d, f, out);
+        for (size_t l = 0; l < count; l++)
+        {
+            cells[index[l]] = out[l];
+        }
+    }
+}
+
+template <typename K, typename F>
+inline void mandelbulb_batch(const simd_level level, const K &k, std::vector<game::block_id> &grid, const size_t block, const size_t d, const F &f)
+{
+    size_t keys[16];
+    game::block_id out[16];
+
+    // Gather the empty cells of this block
+    const size_t lanes = simd_lanes(level);
+    const size_t start = block * lanes;
+    const size_t end = std::min(start + lanes, grid.size());
+    size_t count = 0;
+    for (size_t i = start; i < end; i++)
+    {
+        if (grid[i] == game::block_id::EMPTY)
+        {
+            keys[count++] = i;
+        }
+    }
+
+    // Skip full blocks
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Run the lanes and scatter the results
+    mandelbulb_batch(level, k, keys, count, d, f, out);
+    for (size_t l = 0; l < count; l++)
+    {
+        grid[keys[l]] = out[l];
+    }
+}
+}
+
+#endif
@@ -18,13 +18,26 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_MANDELBULB_EXP_BDS_
 #define _BDS_MANDELBULB_EXP_BDS_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <game/id.h>
+#include <kernel/mandelbulb_batch.h>
+#include <kernel/mandelbulb_fold.h>
 #include <min/thread_pool.h>
 #include <min/vec3.h>
 
 namespace kernel
 {
 
+enum class exp_mode
+{
+    libm,
+    bounded,
+    fast
+};
+
 class mandelbulb_exp
 {
   private:
@@ -32,6 +45,74 @@ class mandelbulb_exp
     int _b;
     int _c;
     int _d;
+    simd_level _simd;
+    bool _fold;
+    exp_mode _exp;
+    std::vector<game::block_id> _classes;
+    size_t _class_size;
+    inline static float pow2i(const int32_t n)
+    {
+        // Build 2^n from the float exponent bits
+        const int32_t bits = (n + 127) << 23;
+        float out;
+        std::memcpy(&out, &bits, sizeof(float));
+        return out;
+    }
+    inline static float exp_bounded(const float x)
+    {
+        // Split x = n * ln(2) + r with |r| <= ln(2) / 2, clamped to the normal float range
+        const float c = std::min(std::max(x, -87.0f), 88.0f);
+        const float n = std::floor(c * 1.44269504089f + 0.5f);
+
+        // Reduce in double, fast math may fold a two constant float reduction and lose precision
+        const float r = static_cast<double>(c) - static_cast<double>(n) * 0.6931471805599453;
+
+        // Degree 6 polynomial for exp(r), relative error within a few float ulp
+        float p = 1.9875691500E-4f;
+        p = p * r + 1.3981999507E-3f;
+        p = p * r + 8.3334519073E-3f;
+        p = p * r + 4.1665795894E-2f;
+        p = p * r + 1.6666665459E-1f;
+        p = p * r + 5.0000001201E-1f;
+        const float e = (p * r * r + r + 1.0f) * pow2i(static_cast<int32_t>(n));
+
+        // Underflow to zero like std::exp
+        return (x < -87.0f) ? 0.0f : e;
+    }
+    inline static float exp_fast(const float x)
+    {
+        // Split x = n * ln(2) + r with |r| <= ln(2) / 2, clamped to the normal float range
+        const float c = std::min(std::max(x, -87.0f), 88.0f);
+        const float n = std::floor(c * 1.44269504089f + 0.5f);
+        const float r = c - n * 0.69314718056f;
+
+        // Degree 3 polynomial for exp(r), relative error below 6E-4
+        const float p = ((1.6666667E-1f * r + 5.0E-1f) * r + 1.0f) * r + 1.0f;
+        const float e = p * pow2i(static_cast<int32_t>(n));
+
+        // Underflow to zero like std::exp
+        return (x < -87.0f) ? 0.0f : e;
+    }
+    BDS_SIMD_NOINLINE static float exp_libm(const float x)
+    {
+        // Out of line so batched lanes never swap in a vector exp that rounds differently
+        return std::exp(x * -1.0);
+    }
+    template <exp_mode M>
+    inline static float exp_neg(const float x)
+    {
+        // Calculate exp(-x) with the selected exp function, resolved at compile time
+        if (M == exp_mode::bounded)
+        {
+            return exp_bounded(-x);
+        }
+        else if (M == exp_mode::fast)
+        {
+            return exp_fast(-x);
+        }
+
+        return exp_libm(x);
+    }
     inline static float pow9(const float x)
     {
         return x * x * x * x * x * x * x * x * x;
@@ -48,6 +129,44 @@ class mandelbulb_exp
     {
         return x * x * x;
     }
+    template <exp_mode M>
+    inline void iterate(const float x0, const float y0, const float z0, float &x1, float &y1, float &z1) const
+    {
+        // X coordinate
+        const float dx = exp_neg<M>(y0 * y0 + z0 * z0);
+        const float dx2 = dx * dx;
+        const float dx3 = dx2 * dx;
+        const float dx4 = dx3 * dx;
+        x1 = pow9(x0) - _a * pow7(x0) * dx + _b * pow5(x0) * dx2 - _c * pow3(x0) * dx3 + _d * x0 * dx4 + x0;
+
+        // Y coordinate
+        const float dy = exp_neg<M>(z0 * z0 + x0 * x0);
+        const float dy2 = dy * dy;
+        const float dy3 = dy2 * dy;
+        const float dy4 = dy3 * dy;
+        y1 = pow9(y0) - _a * pow7(y0) * dy + _b * pow5(y0) * dy2 - _c * pow3(y0) * dy3 + _d * y0 * dy4 + y0;
+
+        // Z coordinate
+        const float dz = exp_neg<M>(x0 * x0 + y0 * y0);
+        const float dz2 = dz * dz;
+        const float dz3 = dz2 * dz;
+        const float dz4 = dz3 * dz;
+        z1 = pow9(z0) - _a * pow7(z0) * dz + _b * pow5(z0) * dz2 - _c * pow3(z0) * dz3 + _d * z0 * dz4 + z0;
+    }
+    template <exp_mode M>
+    class exp_kernel
+    {
+      private:
+        const mandelbulb_exp &_k;
+
+      public:
+        exp_kernel(const mandelbulb_exp &k) : _k(k) {}
+        inline void iterate(const float x0, const float y0, const float z0, float &x1, float &y1, float &z1) const
+        {
+            _k.iterate<M>(x0, y0, z0, x1, y1, z1);
+        }
+    };
+    template <exp_mode M>
     inline game::block_id do_mandelbulb(const min::vec3<float> &p, const size_t size)
     {
         // Copy point
@@ -66,26 +185,8 @@ class mandelbulb_exp
         size_t iterations = 0;
         for (size_t i = 0; i < 32; i++)
         {
-            // X coordinate
-            const float dx = std::exp((y0 * y0 + z0 * z0) * -1.0);
-            const float dx2 = dx * dx;
-            const float dx3 = dx2 * dx;
-            const float dx4 = dx3 * dx;
-            x1 = pow9(x0) - _a * pow7(x0) * dx + _b * pow5(x0) * dx2 - _c * pow3(x0) * dx3 + _d * x0 * dx4 + x0;
-
-            // Y coordinate
-            const float dy = std::exp((z0 * z0 + x0 * x0) * -1.0);
-            const float dy2 = dy * dy;
-            const float dy3 = dy2 * dy;
-            const float dy4 = dy3 * dy;
-            y1 = pow9(y0) - _a * pow7(y0) * dy + _b * pow5(y0) * dy2 - _c * pow3(y0) * dy3 + _d * y0 * dy4 + y0;
-
-            // Z coordinate
-            const float dz = std::exp((x0 * x0 + y0 * y0) * -1.0);
-            const float dz2 = dz * dz;
-            const float dz3 = dz2 * dz;
-            const float dz4 = dz3 * dz;
-            z1 = pow9(z0) - _a * pow7(z0) * dz + _b * pow5(z0) * dz2 - _c * pow3(z0) * dz3 + _d * z0 * dz4 + z0;
+            // Do one iteration
+            iterate<M>(x0, y0, z0, x1, y1, z1);
 
             if (std::abs(x1 - x0) < 1E-3 && std::abs(y1 - y0) < 1E-3 && std::abs(z1 - z0) < 1E-3)
             {
@@ -94,6 +195,12 @@ class mandelbulb_exp
                 break;
             }
 
+            // A non-finite coordinate stays non-finite, this cell can never converge
+            if (!std::isfinite(x1) || !std::isfinite(y1) || !std::isfinite(z1))
+            {
+                break;
+            }
+
             // Prime next loop
             x0 = x1;
             y0 = y1;
@@ -108,12 +215,64 @@ class mandelbulb_exp
 
         return game::block_id::EMPTY;
     }
+    template <exp_mode M, typename F>
+    inline void generate_chunk_exp(const min::tri<size_t> &start, std::vector<game::block_id> &cells, const size_t chunk_size, const size_t gsize, const F &f) const
+    {
+        // Iterate the empty cells of the chunk in lockstep
+        mandelbulb_chunk(_simd, exp_kernel<M>(*this), start, cells, chunk_size, gsize, f);
+    }
+    template <exp_mode M, typename F>
+    inline void generate_exp(min::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
+    {
+        // Iterate one cell per symmetry class and mirror the result if the grid allows
+        if (_fold && mandelbulb_fold(pool, _simd, fold_symmetry::octahedral, exp_kernel<M>(*this), grid, gsize, f))
+        {
+            return;
+        }
+
+        // Iterate blocks of cells in lockstep if the CPU supports it
+        if (_simd != simd_level::scalar)
+        {
+            const size_t lanes = simd_lanes(_simd);
+            const size_t blocks = (grid.size() + lanes - 1) / lanes;
+            const size_t d = static_cast<size_t>(gsize * 0.6667);
+            const simd_level level = _simd;
+            const exp_kernel<M> k(*this);
+            const auto work = [&k, &grid, d, &f, level](std::mt19937 &gen, const size_t b) {
+                mandelbulb_batch(level, k, grid, b, d, f);
+            };
+
+            // Run the job in parallel
+            pool.run(std::cref(work), 0, blocks);
+            return;
+        }
+
+        // Create working function
+        const auto work = [this, &grid, gsize, &f](std::mt19937 &gen, const size_t i) {
+            // Do mandelbulb on this cell if empty
+            if (grid[i] == game::block_id::EMPTY)
+            {
+                grid[i] = do_mandelbulb<M>(f(i), gsize);
+            }
+        };
+
+        // Run the job in parallel
+        pool.run(std::cref(work), 0, grid.size());
+    }
+
+    template <exp_mode M, typename F>
+    inline bool prepare_exp(min::thread_pool &pool, const size_t gsize, const F &f)
+    {
+        // Iterate one cell per symmetry class once for every chunk if the grid allows
+        return _fold && fold_classes(pool, _simd, fold_symmetry::octahedral, exp_kernel<M>(*this), gsize, f, _classes);
+    }
 
   public:
     mandelbulb_exp(const int a, const int b, const int c, const int d)
-        : _a(a), _b(b), _c(c), _d(d) {}
+        : _a(a), _b(b), _c(c), _d(d), _simd(simd_support()), _fold(true), _exp(exp_mode::bounded), _class_size(0) {}
 
     mandelbulb_exp(std::mt19937 &rng)
+        : _simd(simd_support()), _fold(true), _exp(exp_mode::bounded), _class_size(0)
     {
         // Generate random range
         std::uniform_int_distribution<int> range(1, 15);
@@ -136,17 +295,86 @@ class mandelbulb_exp
     template <typename F>
     inline void generate(min::thread_pool &pool, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
     {
-        // Create working function
-        const auto work = [this, &grid, gsize, &f](std::mt19937 &gen, const size_t i) {
-            // Do mandelbulb on this cell if empty
-            if (grid[i] == game::block_id::EMPTY)
-            {
-                grid[i] = do_mandelbulb(f(i), gsize);
-            }
-        };
+        // Select the exp function once for the whole grid
+        switch (_exp)
+        {
+        case exp_mode::bounded:
+            generate_exp<exp_mode::bounded>(pool, grid, gsize, f);
+            break;
+        case exp_mode::fast:
+            generate_exp<exp_mode::fast>(pool, grid, gsize, f);
+            break;
+        default:
+            generate_exp<exp_mode::libm>(pool, grid, gsize, f);
+            break;
+        }
+    }
+    template <typename F>
+    inline void generate_chunk(const min::tri<size_t> &start, std::vector<game::block_id> &cells, const size_t chunk_size, const size_t gsize, const F &f) const
+    {
+        // Mirror the class results prepared for this grid
+        if (_class_size == gsize)
+        {
+            fold_chunk(fold_symmetry::octahedral, _classes, gsize, start, cells, chunk_size);
+            return;
+        }
 
-        // Run the job in parallel
-        pool.run(std::cref(work), 0, grid.size());
+        // Select the exp function once for the whole chunk
+        switch (_exp)
+        {
+        case exp_mode::bounded:
+            generate_chunk_exp<exp_mode::bounded>(start, cells, chunk_size, gsize, f);
+            break;
+        case exp_mode::fast:
+            generate_chunk_exp<exp_mode::fast>(start, cells, chunk_size, gsize, f);
+            break;
+        default:
+            generate_chunk_exp<exp_mode::libm>(start, cells, chunk_size, gsize, f);
+            break;
+        }
+    }
+    inline exp_mode get_exp() const
+    {
+        return _exp;
+    }
+    inline bool get_fold() const
+    {
+        return _fold;
+    }
+    inline simd_level get_simd() const
+    {
+        return _simd;
+    }
+    template <typename F>
+    inline void prepare(min::thread_pool &pool, const size_t gsize, const F &f)
+    {
+        // Select the exp function once for the whole grid
+        bool fold;
+        switch (_exp)
+        {
+        case exp_mode::bounded:
+            fold = prepare_exp<exp_mode::bounded>(pool, gsize, f);
+            break;
+        case exp_mode::fast:
+            fold = prepare_exp<exp_mode::fast>(pool, gsize, f);
+            break;
+        default:
+            fold = prepare_exp<exp_mode::libm>(pool, gsize, f);
+            break;
+        }
+        _class_size = fold ? gsize : 0;
+    }
+    inline void set_exp(const exp_mode mode)
+    {
+        _exp = mode;
+    }
+    inline void set_fold(const bool flag)
+    {
+        _fold = flag;
+    }
+    inline void set_simd(const simd_level level)
+    {
+        _simd = level;
     }
 };
 }
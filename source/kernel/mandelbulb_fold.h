@@ -0,0 +1,214 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_MANDELBULB_FOLD_BDS_
+#define _BDS_MANDELBULB_FOLD_BDS_
+
+#include <algorithm>
+#include <functional>
+#include <game/id.h>
+#include <kernel/mandelbulb_batch.h>
+#include <min/thread_pool.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <vector>
+
+namespace kernel
+{
+
+// Every kernel is odd in its own coordinate and even in the others, so flipping
+// the sign of an axis flips the orbit exactly. Kernels with one coefficient set
+// are also unchanged when axes are swapped.
+enum class fold_symmetry
+{
+    mirror,
+    octahedral
+};
+
+inline size_t fold_class(const fold_symmetry sym, const size_t half, size_t a, size_t b, size_t c)
+{
+    // Index of an octant cell among the class cells
+    if (sym == fold_symmetry::octahedral)
+    {
+        // Sort ascending since axes can be swapped
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+        if (b > c)
+        {
+            std::swap(b, c);
+        }
+        if (a > b)
+        {
+            std::swap(a, b);
+        }
+
+        return c * (c + 1) * (c + 2) / 6 + b * (b + 1) / 2 + a;
+    }
+
+    return (a * half + b) * half + c;
+}
+
+template <typename F>
+inline bool fold_check(const fold_symmetry sym, const size_t gsize, const F &f)
+{
+    // Cell centers along each axis must mirror about the origin
+    const size_t last = gsize - 1;
+    for (size_t t = 0; t < gsize; t++)
+    {
+        const float x = f(t * gsize * gsize).x();
+        const float y = f(t * gsize).y();
+        const float z = f(t).z();
+        if (x != -f((last - t) * gsize * gsize).x() || y != -f((last - t) * gsize).y() || z != -f(last - t).z())
+        {
+            return false;
+        }
+
+        // Swapping axes needs the same centers on every axis
+        if (sym == fold_symmetry::octahedral && (x != y || x != z))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename K, typename F>
+inline bool fold_classes(min::thread_pool &pool, const simd_level level, const fold_symmetry sym,
+                         const K &k, const size_t gsize, const F &f, std::vector<game::block_id> &ids)
+{
+    // Only fold cubic grids with mirrored cell centers
+    if (!fold_check(sym, gsize, f))
+    {
+        return false;
+    }
+
+    // Cells are mirrored into the lower octant of the grid
+    const size_t half = (gsize + 1) / 2;
+    const size_t d = static_cast<size_t>(gsize * 0.6667);
+
+    // Class cells are numbered layer by layer, each layer is contiguous in class order
+    const bool octahedral = (sym == fold_symmetry::octahedral);
+    ids.resize(octahedral ? half * (half + 1) * (half + 2) / 6 : half * half * half);
+    const size_t lanes = simd_lanes(level);
+    const auto work = [&ids, octahedral, gsize, half, lanes, level, &k, d, &f](std::mt19937 &gen, const size_t layer) {
+        size_t keys[16];
+        size_t next = octahedral ? layer * (layer + 1) * (layer + 2) / 6 : layer * half * half;
+        size_t count = 0;
+
+        // Pick one cell per symmetry class, keys are built per block instead of stored for the whole grid
+        const size_t rows = octahedral ? layer + 1 : half;
+        for (size_t j = 0; j < rows; j++)
+        {
+            const size_t cols = octahedral ? j + 1 : half;
+            for (size_t i = 0; i < cols; i++)
+            {
+                keys[count++] = octahedral ? (i * gsize + j) * gsize + layer : (layer * gsize + j) * gsize + i;
+
+                // Iterate the class cells in lane sized blocks
+                if (count == lanes)
+                {
+                    mandelbulb_batch(level, k, keys, count, d, f, &ids[next]);
+                    next += count;
+                    count = 0;
+                }
+            }
+        }
+
+        // Iterate the last partial block
+        if (count > 0)
+        {
+            mandelbulb_batch(level, k, keys, count, d, f, &ids[next]);
+        }
+    };
+
+    // Run the job in parallel
+    pool.run(std::cref(work), 0, half);
+
+    return true;
+}
+
+inline void fold_chunk(const fold_symmetry sym, const std::vector<game::block_id> &ids, const size_t gsize,
+                       const min::tri<size_t> &start, std::vector<game::block_id> &cells, const size_t chunk_size)
+{
+    // Copy the class results into every empty cell of the chunk, rows along Z are contiguous
+    const size_t half = (gsize + 1) / 2;
+    for (size_t x = 0, c = 0; x < chunk_size; x++)
+    {
+        // Fold the row into the lower octant
+        const size_t gx = start.x() + x;
+        const size_t a = std::min(gx, gsize - 1 - gx);
+        for (size_t y = 0; y < chunk_size; y++)
+        {
+            const size_t gy = start.y() + y;
+            const size_t b = std::min(gy, gsize - 1 - gy);
+            for (size_t z = 0; z < chunk_size; z++, c++)
+            {
+                // Skip cells that are already set
+                if (cells[c] == game::block_id::EMPTY)
+                {
+                    const size_t gz = start.z() + z;
+                    cells[c] = ids[fold_class(sym, half, a, b, std::min(gz, gsize - 1 - gz))];
+                }
+            }
+        }
+    }
+}
+
+template <typename K, typename F>
+inline bool mandelbulb_fold(min::thread_pool &pool, const simd_level level, const fold_symmetry sym,
+                            const K &k, std::vector<game::block_id> &grid, const size_t gsize, const F &f)
+{
+    // Iterate one cell per symmetry class
+    std::vector<game::block_id> ids;
+    if (grid.size() != gsize * gsize * gsize || !fold_classes(pool, level, sym, k, gsize, f, ids))
+    {
+        return false;
+    }
+
+    // Cells are mirrored into the lower octant of the grid
+    const size_t half = (gsize + 1) / 2;
+
+    // Copy the class results into every empty cell, one grid row at a time
+    const auto mirror = [&ids, sym, &grid, gsize, half](std::mt19937 &gen, const size_t row) {
+        // Fold the row into the lower octant
+        const size_t x = row / gsize;
+        const size_t y = row % gsize;
+        const size_t a = std::min(x, gsize - 1 - x);
+        const size_t b = std::min(y, gsize - 1 - y);
+
+        // Skip cells that are already set
+        const size_t start = row * gsize;
+        for (size_t z = 0; z < gsize; z++)
+        {
+            if (grid[start + z] == game::block_id::EMPTY)
+            {
+                grid[start + z] = ids[fold_class(sym, half, a, b, std::min(z, gsize - 1 - z))];
+            }
+        }
+    };
+
+    // Run the job in parallel
+    pool.run(std::cref(mirror), 0, gsize * gsize);
+
+    return true;
+}
+}
+
+#endif
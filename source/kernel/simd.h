@@ -0,0 +1,84 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_SIMD_BDS_
+#define _BDS_SIMD_BDS_
+
+#include <cstddef>
+
+// Runtime dispatch to AVX2 and AVX-512 kernels needs GCC or clang on x86
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define BDS_SIMD_DISPATCH
+#define BDS_SIMD_INLINE __attribute__((always_inline)) inline
+#define BDS_SIMD_NOINLINE __attribute__((noinline))
+#else
+#define BDS_SIMD_INLINE inline
+#define BDS_SIMD_NOINLINE
+#endif
+
+namespace kernel
+{
+
+enum class simd_level
+{
+    scalar,
+    avx2,
+    avx512
+};
+
+inline simd_level simd_detect()
+{
+#ifdef BDS_SIMD_DISPATCH
+    // Query the running CPU
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return simd_level::avx512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        return simd_level::avx2;
+    }
+#endif
+
+    // Fall back to one cell at a time
+    return simd_level::scalar;
+}
+
+inline simd_level simd_support()
+{
+    // Detect once per process
+    static const simd_level level = simd_detect();
+    return level;
+}
+
+inline size_t simd_lanes(const simd_level level)
+{
+    // Cells per block for each instruction set
+    switch (level)
+    {
+    case simd_level::avx512:
+        return 16;
+    case simd_level::avx2:
+        return 8;
+    default:
+        return 1;
+    }
+}
+}
+
+#endif
@@ -18,8 +18,11 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_TERRAIN_BASE_BDS_
 #define _BDS_TERRAIN_BASE_BDS_
 
+#include <algorithm>
+#include <game/counter_rng.h>
 #include <game/id.h>
-#include <game/perlin.h>
+#include <game/chunk_noise.h>
+#include <game/fractal_noise.h>
 #include <min/thread_pool.h>
 #include <min/vec3.h>
 
@@ -33,7 +36,8 @@ class terrain_base
     const size_t _chunk_size;
     const size_t _start;
     const size_t _stop;
-    perlin_noise _noise;
+    const uint64_t _dope;
+    fractal_noise _noise;
 
     inline size_t key(const min::tri<size_t> &index) const
     {
@@ -48,134 +52,77 @@ class terrain_base
 
         return false;
     }
-    inline float do_perlin(const size_t x, const size_t y, const size_t z) const
+    inline game::block_id cell(const size_t x, const size_t y, const size_t z, const float value) const
     {
-        // Relative grid components in chunk
-        const float inv_cs = 1.0 / _chunk_size;
-        const float rx = x * inv_cs;
-        const float ry = y * inv_cs;
-        const float rz = z * inv_cs;
-
-        // Calculate noise for this grid cell
-        return _noise.perlin(rx, ry, rz);
-    }
+        // If on edge, write as STONE2
+        if (on_edge(x) || on_edge(y) || on_edge(z))
+        {
+            return game::block_id::STONE2;
+        }
+
+        // Dope minerals in base, keyed by cell so threads and chunks don't matter
+        game::counter_rng dope(_dope, key(min::tri<size_t>(x, y, z)));
+
+        // Pick the mineral band of the noise value
+        if (value >= 0.0 && value < 0.10)
+        {
+            return (dope.uniform(0, 110) <= 2) ? game::block_id::GOLD : game::block_id::STONE1;
+        }
+        else if (value >= 0.10 && value < 0.15)
+        {
+            return (dope.uniform(0, 110) <= 4) ? game::block_id::SILVER : game::block_id::STONE2;
+        }
+        else if (value >= 0.15 && value < 0.20)
+        {
+            return (dope.uniform(0, 110) <= 6) ? game::block_id::IRON : game::block_id::IRIDIUM;
+        }
+        else if (value >= 0.20 && value < 0.25)
+        {
+            return (dope.uniform(0, 110) <= 6) ? game::block_id::COPPER : game::block_id::DIRT1;
+        }
+        else if (value >= 0.35 && value < 0.40)
+        {
+            return (dope.uniform(0, 110) <= 8) ? game::block_id::CALCIUM : game::block_id::DIRT2;
+        }
+        else if (value >= 0.40 && value < 0.45)
+        {
+            return (dope.uniform(0, 110) <= 10) ? game::block_id::SODIUM : game::block_id::CLAY1;
+        }
+        else if (value >= 0.45 && value < 0.50)
+        {
+            return (dope.uniform(0, 110) <= 8) ? game::block_id::MAGNESIUM : game::block_id::CLAY2;
+        }
+        else if (value >= 0.51 && value < 0.515)
+        {
+            return (dope.uniform(0, 110) <= 10) ? game::block_id::POTASSIUM : game::block_id::SODIUM;
+        }
 
+        return game::block_id::EMPTY;
+    }
   public:
-    terrain_base(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop)
-        : _scale(scale), _chunk_size(chunk_size), _start(start), _stop(stop) {}
+    terrain_base(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop, const uint64_t seed)
+        : _scale(scale), _chunk_size(chunk_size), _start(start), _stop(stop),
+          _dope(game::counter_rng::derive(seed, game::seed_stream::dope)),
+          _noise(seed, static_cast<float>(1.0 / chunk_size), fractal_type::fbm, 1) {}
 
     inline void generate(min::thread_pool &pool, std::vector<game::block_id> &write) const
     {
         // Create working function
         const auto work = [this, &write](std::mt19937 &gen, const size_t i) {
-            // Dope minerals in base
-            std::uniform_int_distribution<unsigned> dope(0, 110);
+            // Calculate the noise of the whole slice
+            const size_t ny = _stop - _start;
+            std::vector<float> noise(ny * _scale);
+            _noise.brick(min::tri<size_t>(i, _start, 0), 1, ny, _scale, noise.data());
 
             // Fill out this section
-            for (size_t j = _start; j < _stop; j++)
+            for (size_t j = 0; j < ny; j++)
             {
                 for (size_t k = 0; k < _scale; k++)
                 {
-                    // Calculate key index
-                    const size_t index = key(min::tri<size_t>(i, j, k));
-
-                    // If on edge, write as STONE2
-                    if (on_edge(i) || on_edge(j) || on_edge(k))
-                    {
-                        write[index] = game::block_id::STONE2;
-                    }
-                    else
+                    const game::block_id id = cell(i, _start + j, k, noise[j * _scale + k]);
+                    if (id != game::block_id::EMPTY)
                     {
-                        // Calculate 3d perlin
-                        const float value = do_perlin(i, j, k);
-                        if (value >= 0.0 && value < 0.10)
-                        {
-                            if (dope(gen) <= 2)
-                            {
-                                write[index] = game::block_id::GOLD;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::STONE1;
-                            }
-                        }
-                        else if (value >= 0.10 && value < 0.15)
-                        {
-                            if (dope(gen) <= 4)
-                            {
-                                write[index] = game::block_id::SILVER;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::STONE2;
-                            }
-                        }
-                        else if (value >= 0.15 && value < 0.20)
-                        {
-                            if (dope(gen) <= 6)
-                            {
-                                write[index] = game::block_id::IRON;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::IRIDIUM;
-                            }
-                        }
-                        else if (value >= 0.20 && value < 0.25)
-                        {
-                            if (dope(gen) <= 6)
-                            {
-                                write[index] = game::block_id::COPPER;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::DIRT1;
-                            }
-                        }
-                        else if (value >= 0.35 && value < 0.40)
-                        {
-                            if (dope(gen) <= 8)
-                            {
-                                write[index] = game::block_id::CALCIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::DIRT2;
-                            }
-                        }
-                        else if (value >= 0.40 && value < 0.45)
-                        {
-                            if (dope(gen) <= 10)
-                            {
-                                write[index] = game::block_id::SODIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::CLAY1;
-                            }
-                        }
-                        else if (value >= 0.45 && value < 0.50)
-                        {
-                            if (dope(gen) <= 8)
-                            {
-                                write[index] = game::block_id::MAGNESIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::CLAY2;
-                            }
-                        }
-                        else if (value >= 0.51 && value < 0.515)
-                        {
-                            if (dope(gen) <= 10)
-                            {
-                                write[index] = game::block_id::POTASSIUM;
-                            }
-                            else
-                            {
-                                write[index] = game::block_id::SODIUM;
-                            }
-                        }
+                        write[key(min::tri<size_t>(i, _start + j, k))] = id;
                     }
                 }
             }
@@ -184,6 +131,50 @@ class terrain_base
         // Parallelize on X axis
         pool.run(std::cref(work), 0, _scale);
     }
+    inline void generate_chunk(const min::tri<size_t> &start, std::vector<game::block_id> &cells) const
+    {
+        // Noise of this chunk only
+        chunk_noise noise(_chunk_size);
+        const size_t layer = noise.add(_noise);
+        noise.set_chunk(start);
+
+        generate_chunk(start, cells, noise, layer);
+    }
+    inline void generate_chunk(const min::tri<size_t> &start, std::vector<game::block_id> &cells, chunk_noise &noise, const size_t layer) const
+    {
+        // Clip the chunk rows to the base section
+        const size_t cs = _chunk_size;
+        const size_t y_start = std::max(start.y(), _start);
+        const size_t y_stop = std::min(start.y() + cs, _stop);
+        if (y_start >= y_stop)
+        {
+            return;
+        }
+
+        // Noise of the chunk is shared with other layers
+        const float *const field = noise.get(layer);
+
+        // Chunk cells are x major, rows along Z are contiguous
+        for (size_t i = 0; i < cs; i++)
+        {
+            for (size_t y = y_start; y < y_stop; y++)
+            {
+                const size_t row = (i * cs + (y - start.y())) * cs;
+                for (size_t k = 0; k < cs; k++)
+                {
+                    const game::block_id id = cell(start.x() + i, y, start.z() + k, field[row + k]);
+                    if (id != game::block_id::EMPTY)
+                    {
+                        cells[row + k] = id;
+                    }
+                }
+            }
+        }
+    }
+    inline const fractal_noise &get_noise() const
+    {
+        return _noise;
+    }
 };
 }
 
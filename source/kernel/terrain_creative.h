@@ -18,6 +18,7 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_TERRAIN_CREATIVE_BDS_
 #define _BDS_TERRAIN_CREATIVE_BDS_
 
+#include <game/counter_rng.h>
 #include <game/id.h>
 #include <min/thread_pool.h>
 #include <min/vec3.h>
@@ -29,26 +30,36 @@ class terrain_creative
 {
   private:
     const size_t _scale;
+    const size_t _chunk_size;
+    const uint64_t _seed;
 
     inline size_t key(const min::tri<size_t> &index) const
     {
         return min::vec3<float>::grid_key(index, _scale);
     }
+    inline game::block_id roll(const size_t index) const
+    {
+        // Roll a random block, keyed by cell so threads and chunks don't matter
+        game::counter_rng dice(_seed, index);
+        switch (dice.uniform(0, 2))
+        {
+        case 0:
+            return static_cast<game::block_id>(dice.uniform(0, 20));
+        case 1:
+            return static_cast<game::block_id>(dice.uniform(24, 30));
+        default:
+            return static_cast<game::block_id>(dice.uniform(32, 37));
+        }
+    }
 
   public:
-    terrain_creative(const size_t scale)
-        : _scale(scale) {}
+    terrain_creative(const size_t scale, const size_t chunk_size, const uint64_t seed)
+        : _scale(scale), _chunk_size(chunk_size), _seed(game::counter_rng::derive(seed, game::seed_stream::creative)) {}
 
     inline void generate(min::thread_pool &pool, std::vector<game::block_id> &write) const
     {
         // Create working function
         const auto work = [this, &write](std::mt19937 &gen, const size_t i) {
-            // Dope minerals in base
-            std::uniform_int_distribution<unsigned> group(0, 2);
-            std::uniform_int_distribution<unsigned> group1(0, 20);
-            std::uniform_int_distribution<unsigned> group2(24, 30);
-            std::uniform_int_distribution<unsigned> group3(32, 37);
-
             // Fill out this section
             for (size_t j = 0; j < _scale; j++)
             {
@@ -62,20 +73,7 @@ class terrain_creative
                     {
                         // Calculate key index
                         const size_t index = key(min::tri<size_t>(i, j, k));
-
-                        // Roll a random block
-                        switch (group(gen))
-                        {
-                        case 0:
-                            write[index] = static_cast<game::block_id>(group1(gen));
-                            break;
-                        case 1:
-                            write[index] = static_cast<game::block_id>(group2(gen));
-                            break;
-                        case 2:
-                            write[index] = static_cast<game::block_id>(group3(gen));
-                            break;
-                        }
+                        write[index] = roll(index);
                     }
                 }
             }
@@ -84,6 +82,28 @@ class terrain_creative
         // Parallelize on X axis
         pool.run(std::cref(work), 0, _scale);
     }
+    inline void generate_chunk(const min::tri<size_t> &start, std::vector<game::block_id> &cells) const
+    {
+        // Chunk cells are x major, rows along Z are contiguous
+        const size_t cs = _chunk_size;
+        for (size_t x = 0; x < cs; x++)
+        {
+            for (size_t y = 0; y < cs; y++)
+            {
+                for (size_t z = 0; z < cs; z++)
+                {
+                    // Place block every 4 blocks away
+                    const size_t i = start.x() + x;
+                    const size_t j = start.y() + y;
+                    const size_t k = start.z() + z;
+                    if ((i & 3) == 0 && (j & 3) == 0 && (k & 3) == 0)
+                    {
+                        cells[(x * cs + y) * cs + z] = roll(key(min::tri<size_t>(i, j, k)));
+                    }
+                }
+            }
+        }
+    }
 };
 }
 
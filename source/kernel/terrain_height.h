@@ -18,8 +18,12 @@ along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef _BDS_TERRAIN_HEIGHT_BDS_
 #define _BDS_TERRAIN_HEIGHT_BDS_
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <game/counter_rng.h>
+#include <game/height_map.h>
 #include <game/id.h>
-#include <min/height_map.h>
 #include <min/thread_pool.h>
 #include <min/vec3.h>
 
@@ -30,8 +34,18 @@ class terrain_height
 {
   private:
     const size_t _scale;
+    const size_t _chunk_size;
+    const size_t _chunk_scale;
     const size_t _start;
     const size_t _stop;
+    const uint64_t _terrain;
+    const uint64_t _trees;
+    const uint64_t _plants;
+    std::vector<size_t> _level;
+    std::vector<std::vector<uint32_t>> _tree_columns;
+    std::vector<std::vector<uint32_t>> _plant_columns;
+    size_t _tree_count;
+    size_t _plant_count;
 
     inline size_t key(const min::tri<size_t> &index) const
     {
@@ -46,167 +60,281 @@ class terrain_height
 
         return false;
     }
-    inline void terrain(min::thread_pool &pool, std::vector<game::block_id> &write, const min::height_map<float> &map) const
+    inline size_t column_key(const size_t x, const size_t z) const
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t grass_start = game::id_value(game::block_id::GRASS1);
-            const int_fast8_t grass_end = game::id_value(game::block_id::GRASS2);
-            const int_fast8_t dirt_start = game::id_value(game::block_id::DIRT1);
-            const int_fast8_t dirt_end = game::id_value(game::block_id::DIRT2);
-            const int_fast8_t sand_start = game::id_value(game::block_id::SAND1);
-            const int_fast8_t sand_end = game::id_value(game::block_id::SAND2);
-            std::uniform_int_distribution<int> grass(grass_start, grass_end);
-            std::uniform_int_distribution<int> soil(dirt_start, dirt_end);
-            std::uniform_int_distribution<int> sand(sand_start, sand_end);
-
-            // Z axis
-            for (size_t k = 0; k < _scale; k++)
+        return (x / _chunk_size) * _chunk_scale + (z / _chunk_size);
+    }
+    template <typename F>
+    inline void column(const size_t x, const size_t z, const size_t y_start, const size_t y_stop, const F &write) const
+    {
+        const int_fast8_t grass_start = game::id_value(game::block_id::GRASS1);
+        const int_fast8_t grass_end = game::id_value(game::block_id::GRASS2);
+        const int_fast8_t dirt_start = game::id_value(game::block_id::DIRT1);
+        const int_fast8_t dirt_end = game::id_value(game::block_id::DIRT2);
+        const int_fast8_t sand_start = game::id_value(game::block_id::SAND1);
+        const int_fast8_t sand_end = game::id_value(game::block_id::SAND2);
+
+        // Get the height
+        const size_t level = _level[x * _scale + z];
+        const size_t height = (level > _stop) ? _stop : level;
+        const size_t mid = _start + (height / 2);
+        const size_t end = _start + (height - 1);
+
+        // Clip the column to the rows asked for
+        const size_t first = std::max(y_start, _start);
+        const size_t last = std::min(y_stop, end + 1);
+        if (first >= last)
+        {
+            return;
+        }
+
+        // Random stream of this column, one draw per cell so skip the rows below
+        game::counter_rng rng(_terrain, x * _scale + z);
+        rng.discard(first - _start);
+
+        // Sand section, soil section and grass surface
+        for (size_t y = first; y < last; y++)
+        {
+            if (y < mid)
             {
-                // Get the height
-                const size_t level = static_cast<size_t>(std::round(map.get(i, k)));
-                const size_t height = (level > _stop) ? _stop : level;
-                const size_t mid = _start + (height / 2);
-                const size_t end = _start + (height - 1);
-
-                // Sand section
-                for (size_t j = _start; j < mid; j++)
-                {
-                    const size_t write_key = key(min::tri<size_t>(i, j, k));
-                    write[write_key] = static_cast<game::block_id>(sand(gen));
-                }
+                write(y, static_cast<game::block_id>(rng.uniform(sand_start, sand_end)));
+            }
+            else if (y < end)
+            {
+                write(y, static_cast<game::block_id>(rng.uniform(dirt_start, dirt_end)));
+            }
+            else
+            {
+                write(y, static_cast<game::block_id>(rng.uniform(grass_start, grass_end)));
+            }
+        }
+    }
+    inline void index()
+    {
+        // Number of trees and plants, default scale
+        const float area_scale = (_scale * _scale) / (128.0 * 128.0);
+        const size_t tree_low = std::ceil(area_scale * 256.0);
+        const size_t tree_high = std::ceil(area_scale * 1024.0);
+        _tree_count = game::counter_rng(_trees, 0).uniform(tree_low, tree_high);
+        const size_t plant_low = std::ceil(area_scale * 64.0);
+        const size_t plant_high = std::ceil(area_scale * 128.0);
+        _plant_count = game::counter_rng(_plants, 0).uniform(plant_low, plant_high);
 
-                // Soil section
-                for (size_t j = mid; j < end; j++)
+        // Index trees by the chunk columns their leaves can reach, in placement order
+        for (size_t i = 0; i < _tree_count; i++)
+        {
+            game::counter_rng rng(_trees, i + 1);
+            const size_t x = rng.uniform(static_cast<size_t>(3), _scale - 4);
+            const size_t z = rng.uniform(static_cast<size_t>(3), _scale - 4);
+            const size_t cx_end = (x + 2) / _chunk_size;
+            const size_t cz_end = (z + 2) / _chunk_size;
+            for (size_t cx = (x - 2) / _chunk_size; cx <= cx_end; cx++)
+            {
+                for (size_t cz = (z - 2) / _chunk_size; cz <= cz_end; cz++)
                 {
-                    const size_t write_key = key(min::tri<size_t>(i, j, k));
-                    write[write_key] = static_cast<game::block_id>(soil(gen));
+                    _tree_columns[cx * _chunk_scale + cz].push_back(static_cast<uint32_t>(i));
                 }
-
-                // Grass surface
-                const size_t write_key = key(min::tri<size_t>(i, end, k));
-                write[write_key] = static_cast<game::block_id>(grass(gen));
             }
-        };
+        }
 
-        // Run height map in parallel
-        pool.run(std::cref(work), 0, _scale);
+        // Index plants by chunk column, in placement order
+        for (size_t i = 0; i < _plant_count; i++)
+        {
+            game::counter_rng rng(_plants, i + 1);
+            const size_t x = rng.uniform(static_cast<size_t>(3), _scale - 4);
+            const size_t z = rng.uniform(static_cast<size_t>(3), _scale - 4);
+            _plant_columns[column_key(x, z)].push_back(static_cast<uint32_t>(i));
+        }
     }
-    inline void plants(min::thread_pool &pool, std::vector<game::block_id> &write, const min::height_map<float> &map, const size_t size) const
+    template <typename F>
+    inline void plant(const size_t i, const F &write) const
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t plant_start = game::id_value(game::block_id::TOMATO);
-            const int_fast8_t plant_end = game::id_value(game::block_id::GREEN_PEPPER);
-            std::uniform_int_distribution<int> plant(plant_start, plant_end);
-
-            // Get random X/Z coord, Y from height map
-            std::uniform_int_distribution<size_t> p(3, _scale - 4);
-            const size_t x = p(gen);
-            const size_t z = p(gen);
-            const size_t y = _start + static_cast<size_t>(std::round(map.get(x, z)));
-
-            // Create plants in empty cells on top of height map
-            const size_t write_key = key(min::tri<size_t>(x, y, z));
-            if (write[write_key] == game::block_id::EMPTY)
+        const int_fast8_t plant_start = game::id_value(game::block_id::TOMATO);
+        const int_fast8_t plant_end = game::id_value(game::block_id::GREEN_PEPPER);
+
+        // Random stream of this plant
+        game::counter_rng rng(_plants, i + 1);
+
+        // Get random X/Z coord, Y from height map
+        const size_t x = rng.uniform(static_cast<size_t>(3), _scale - 4);
+        const size_t z = rng.uniform(static_cast<size_t>(3), _scale - 4);
+        const size_t y = _start + _level[x * _scale + z];
+
+        // Plants are only created in empty cells on top of height map
+        write(x, y, z, static_cast<game::block_id>(rng.uniform(plant_start, plant_end)));
+    }
+    template <typename F>
+    inline void tree(const size_t i, const F &write) const
+    {
+        const int_fast8_t leaf_start = game::id_value(game::block_id::LEAF1);
+        const int_fast8_t leaf_end = game::id_value(game::block_id::LEAF4);
+        const int_fast8_t wood_start = game::id_value(game::block_id::WOOD1);
+        const int_fast8_t wood_end = game::id_value(game::block_id::WOOD2);
+
+        // Random stream of this tree
+        game::counter_rng rng(_trees, i + 1);
+
+        // Get random X/Z coord
+        const size_t x = rng.uniform(static_cast<size_t>(3), _scale - 4);
+        const size_t z = rng.uniform(static_cast<size_t>(3), _scale - 4);
+
+        // Get the top of trees at X/Z coord, random size between 4 and 18
+        const size_t tree_base = _start + _level[x * _scale + z];
+        const size_t tree_height = tree_base + rng.uniform(4, 18);
+        const size_t tree_top = (tree_height > _stop) ? _stop : tree_height;
+
+        // Create tree wood
+        const game::block_id wood_type = static_cast<game::block_id>(rng.uniform(wood_start, wood_end));
+        for (size_t y = tree_base; y < tree_top; y++)
+        {
+            write(x, y, z, wood_type);
+        }
+
+        // Leaf start position and leaf type
+        const size_t x_start = x - 2;
+        const size_t y_start = tree_top - 2;
+        const size_t z_start = z - 2;
+        const game::block_id leaf_type = static_cast<game::block_id>(rng.uniform(leaf_start, leaf_end));
+
+        // Generate cubic leaves
+        const size_t dx = rng.uniform(0, 1);
+        const size_t x_end = x_start + (5 - dx);
+        for (size_t x = x_start + dx; x < x_end; x++)
+        {
+            const size_t y_end = y_start + 3;
+            for (size_t y = y_start; y < y_end; y++)
             {
-                write[write_key] = static_cast<game::block_id>(plant(gen));
+                const size_t dz = rng.uniform(0, 1);
+                const size_t z_end = z_start + (5 - dz);
+                for (size_t z = z_start + dz; z < z_end; z++)
+                {
+                    write(x, y, z, leaf_type);
+                }
             }
-        };
-
-        // Run height map in parallel
-        pool.run(std::cref(work), 0, size);
+        }
     }
-    inline void trees(min::thread_pool &pool, std::vector<game::block_id> &write, const min::height_map<float> &map, const size_t size) const
+
+    template <typename F>
+    inline void tile(const size_t sx, const size_t sz, const size_t y_start, const size_t y_stop, const F &cell) const
     {
-        // Parallelize on X axis
-        const auto work = [this, &map, &write](std::mt19937 &gen, const size_t i) {
-            const int_fast8_t leaf_start = game::id_value(game::block_id::LEAF1);
-            const int_fast8_t leaf_end = game::id_value(game::block_id::LEAF4);
-            const int_fast8_t wood_start = game::id_value(game::block_id::WOOD1);
-            const int_fast8_t wood_end = game::id_value(game::block_id::WOOD2);
-
-            // Random numbers between 5 and 13, including both
-            std::uniform_int_distribution<unsigned> tree_size(4, 18);
-            std::uniform_int_distribution<int> wood(wood_start, wood_end);
-            std::uniform_int_distribution<int> leaf(leaf_start, leaf_end);
-
-            // Get random X/Z coord
-            std::uniform_int_distribution<size_t> p(3, _scale - 4);
-            const size_t x = p(gen);
-            const size_t z = p(gen);
-
-            // Get the top of trees at X/Z coord
-            const size_t tree_base = _start + static_cast<size_t>(std::round(map.get(x, z)));
-            const size_t tree_height = tree_base + tree_size(gen);
-            const size_t tree_top = (tree_height > _stop) ? _stop : tree_height;
-
-            // Create tree wood
-            const int_fast8_t wood_type = wood(gen);
-            for (size_t y = tree_base; y < tree_top; y++)
+        // Generate the terrain columns of this chunk column tile
+        const size_t cs = _chunk_size;
+        for (size_t x = sx; x < sx + cs; x++)
+        {
+            for (size_t z = sz; z < sz + cs; z++)
             {
-                const size_t write_key = key(min::tri<size_t>(x, y, z));
-                write[write_key] = static_cast<game::block_id>(wood_type);
+                column(x, z, y_start, y_stop, [&cell, x, z](const size_t y, const game::block_id id) {
+                    cell(x, y, z) = id;
+                });
             }
+        }
 
-            // Leaf start position and leaf type
-            const size_t x_start = x - 2;
-            const size_t y_start = tree_top - 2;
-            const size_t z_start = z - 2;
-            const int_fast8_t leaf_type = leaf(gen);
-
-            // Generate cubic leaves
-            std::uniform_int_distribution<unsigned> leaf_offset(0, 1);
-            const size_t dx = leaf_offset(gen);
-            const size_t x_end = x_start + (5 - dx);
-            for (size_t x = x_start + dx; x < x_end; x++)
+        // Place trees reaching this tile in order so the last tree wins, only keep cells inside the tile
+        const size_t ckey = column_key(sx, sz);
+        const auto place = [&cell, cs, sx, sz, y_start, y_stop](const size_t x, const size_t y, const size_t z, const game::block_id id) {
+            if (x - sx < cs && z - sz < cs && y >= y_start && y < y_stop)
             {
-                const size_t y_end = y_start + 3;
-                for (size_t y = y_start; y < y_end; y++)
+                cell(x, y, z) = id;
+            }
+        };
+        for (const uint32_t i : _tree_columns[ckey])
+        {
+            tree(i, place);
+        }
+
+        // Plants only grow in empty cells of their own tile, place them in order after the trees
+        const auto grow = [&cell, y_start, y_stop](const size_t x, const size_t y, const size_t z, const game::block_id id) {
+            if (y >= y_start && y < y_stop)
+            {
+                game::block_id &c = cell(x, y, z);
+                if (c == game::block_id::EMPTY)
                 {
-                    const size_t dz = leaf_offset(gen);
-                    const size_t z_end = z_start + (5 - dz);
-                    for (size_t z = z_start + dz; z < z_end; z++)
-                    {
-                        const size_t write_key = key(min::tri<size_t>(x, y, z));
-                        write[write_key] = static_cast<game::block_id>(leaf_type);
-                    }
+                    c = id;
                 }
             }
         };
-
-        // Run height map in parallel
-        pool.run(std::cref(work), 0, size);
+        for (const uint32_t i : _plant_columns[ckey])
+        {
+            plant(i, grow);
+        }
     }
 
   public:
-    terrain_height(const size_t scale, const size_t start, const size_t stop)
-        : _scale(scale), _start(start), _stop(stop) {}
-
-    inline void generate(min::thread_pool &pool, std::mt19937 &gen, std::vector<game::block_id> &write) const
+    terrain_height(const size_t scale, const size_t chunk_size, const size_t start, const size_t stop, const uint64_t seed)
+        : _scale(scale), _chunk_size(chunk_size), _chunk_scale(scale / chunk_size), _start(start), _stop(stop),
+          _terrain(game::counter_rng::derive(seed, game::seed_stream::terrain)),
+          _trees(game::counter_rng::derive(seed, game::seed_stream::trees)),
+          _plants(game::counter_rng::derive(seed, game::seed_stream::plants)),
+          _level(scale * scale),
+          _tree_columns(_chunk_scale * _chunk_scale),
+          _plant_columns(_chunk_scale * _chunk_scale),
+          _tree_count(0), _plant_count(0)
     {
-        // Generate height map
+        // Generate height map from the seed
         const size_t level = std::ceil(std::log2(_scale));
-        min::height_map<float> map(gen, level, 4.0, 8.0);
+        game::height_map map(game::counter_rng::derive(seed, game::seed_stream::height_map), level, 4.0, 8.0);
         map.gauss_blur_5x5();
 
-        // Generate terrain
-        terrain(pool, write, map);
+        // Keep the rounded height of each column
+        for (size_t i = 0; i < _scale; i++)
+        {
+            for (size_t k = 0; k < _scale; k++)
+            {
+                _level[i * _scale + k] = static_cast<size_t>(std::round(map.get(i, k)));
+            }
+        }
 
-        // Default scale
-        const float area_scale = (_scale * _scale) / (128.0 * 128.0);
+        // Index trees and plants by chunk column
+        index();
+    }
 
-        // Generate trees
-        const size_t tree_low = std::ceil(area_scale * 256.0);
-        const size_t tree_high = std::ceil(area_scale * 1024.0);
-        std::uniform_int_distribution<size_t> tree_dist(tree_low, tree_high);
-        trees(pool, write, map, tree_dist(gen));
+    inline void generate(min::thread_pool &pool, std::vector<game::block_id> &write) const
+    {
+        // Generate terrain, parallelize on X axis
+        const auto work = [this, &write](std::mt19937 &gen, const size_t i) {
+            for (size_t k = 0; k < _scale; k++)
+            {
+                column(i, k, _start, _scale, [this, &write, i, k](const size_t j, const game::block_id id) {
+                    write[key(min::tri<size_t>(i, j, k))] = id;
+                });
+            }
+        };
+        pool.run(std::cref(work), 0, _scale);
 
-        // Generate plants
-        const size_t plant_low = std::ceil(area_scale * 64.0);
-        const size_t plant_high = std::ceil(area_scale * 128.0);
-        std::uniform_int_distribution<size_t> plant_dist(plant_low, plant_high);
-        plants(pool, write, map, plant_dist(gen));
+        // Trees overlap so place them in order, the last tree wins
+        const auto place = [this, &write](const size_t x, const size_t y, const size_t z, const game::block_id id) {
+            write[key(min::tri<size_t>(x, y, z))] = id;
+        };
+        for (size_t i = 0; i < _tree_count; i++)
+        {
+            tree(i, place);
+        }
+
+        // Plants check for empty cells so place them in order
+        const auto grow = [this, &write](const size_t x, const size_t y, const size_t z, const game::block_id id) {
+            const size_t write_key = key(min::tri<size_t>(x, y, z));
+            if (write[write_key] == game::block_id::EMPTY)
+            {
+                write[write_key] = id;
+            }
+        };
+        for (size_t i = 0; i < _plant_count; i++)
+        {
+            plant(i, grow);
+        }
+    }
+    inline void generate_chunk(const min::tri<size_t> &start, std::vector<game::block_id> &cells) const
+    {
+        // Chunk cells are x major, rows along Z are contiguous
+        const size_t cs = _chunk_size;
+        const size_t sx = start.x();
+        const size_t sy = start.y();
+        const size_t sz = start.z();
+
+        // Generate the part of the chunk column tile inside this chunk
+        tile(sx, sz, sy, sy + cs, [&cells, cs, sx, sy, sz](const size_t x, const size_t y, const size_t z) -> game::block_id & {
+            return cells[((x - sx) * cs + (y - sy)) * cs + (z - sz)];
+        });
     }
 };
 }
@@ -16,6 +16,14 @@ You should have received a copy of the GNU General Public License
 along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <iostream>
+#include <tchunk_file.h>
+#include <tchunk_store.h>
+#include <tdelta_file.h>
+#include <tgenerate.h>
+#include <tgrid_search.h>
+#include <tmandelbulb.h>
+#include <tperlin.h>
+#include <tterrain_mesher.h>
 #include <tthread_pool.h>
 
 int main()
@@ -24,6 +32,14 @@ int main()
     {
         bool out = true;
         out = out && test_thread_pool();
+        out = out && test_chunk_store();
+        out = out && test_chunk_file();
+        out = out && test_delta_file();
+        out = out && test_mandelbulb();
+        out = out && test_perlin();
+        out = out && test_generate();
+        out = out && test_grid_search();
+        out = out && test_terrain_mesher();
         if (out)
         {
             std::cout << "Game tests passed!" << std::endl;
@@ -0,0 +1,147 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_CHUNK_FILE_BDS_
+#define _BDS_TEST_CHUNK_FILE_BDS_
+
+#include <algorithm>
+#include <cstdio>
+#include <game/chunk_file.h>
+#include <game/chunk_store.h>
+#include <game/file.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_chunk_file_equal(const game::chunk_store &a, const game::chunk_store &b)
+{
+    bool out = true;
+    const size_t size = a.size();
+    for (size_t i = 0; i < size; i++)
+    {
+        out = out && (a.get(i) == b.get(i));
+    }
+
+    return out;
+}
+
+bool test_chunk_file()
+{
+    bool out = true;
+
+    // Create a small grid with a mix of empty, uniform and mixed chunks
+    const size_t scale = 16;
+    const std::string file_name = "chunk_file.test";
+    game::chunk_store store(scale, 4);
+    for (size_t i = 0; i < 1024; i++)
+    {
+        store.set(i, game::block_id::STONE1);
+    }
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<size_t> key(0, store.size() - 1);
+    std::uniform_int_distribution<int> id(-1, 4);
+    for (size_t i = 0; i < 2000; i++)
+    {
+        store.set(key(gen), static_cast<game::block_id>(id(gen)));
+    }
+
+    // Test full save and load
+    game::chunk_file save(scale, 4, store.get_chunks());
+    save.save(file_name, store);
+    game::chunk_file load(scale, 4, store.get_chunks());
+    game::chunk_store loaded(scale, 4);
+    out = out && compare(game::chunk_file::is_chunk_file(file_name), true);
+    out = out && compare(load.load_index(file_name), true);
+    load.page_chunks(loaded);
+    out = out && compare(loaded.resident() == 0, true);
+    out = out && compare(test_chunk_file_equal(store, loaded), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk file full save");
+    }
+
+    // Edit a few chunks, growing one past its slot, and save only those
+    const std::vector<size_t> dirty = {0, 1, 2, 3, 5, 63};
+    store.get_chunk(5).clear();
+    for (size_t i = 0; i < 64; i++)
+    {
+        store.set(i, static_cast<game::block_id>(i % 20));
+    }
+    store.set(store.size() - 1, game::block_id::DIRT1);
+    std::vector<uint8_t> before;
+    game::file::load_file(file_name, before);
+    save.save(file_name, store, dirty);
+
+    // Test incremental save and load
+    game::chunk_store reloaded(scale, 4);
+    out = out && compare(load.load_index(file_name), true);
+    load.page_chunks(reloaded);
+    out = out && compare(test_chunk_file_equal(store, reloaded), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk file incremental save");
+    }
+
+    // A full save that can't be written keeps the index, the next save still appends to the old file
+    std::vector<uint8_t> kept;
+    game::file::load_file(file_name, kept);
+    save.save("missing_directory/" + file_name, store);
+    store.set(min::tri<size_t>(0, 4, 12), game::block_id::SAND2);
+    save.save(file_name, store, {7});
+    std::vector<uint8_t> appended;
+    game::file::load_file(file_name, appended);
+    game::chunk_store kept_store(scale, 4);
+    out = out && compare(appended.size() > kept.size(), true);
+    out = out && compare(load.load_index(file_name), true);
+    load.page_chunks(kept_store);
+    out = out && compare(test_chunk_file_equal(store, kept_store), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk file failed save");
+    }
+
+    // A save interrupted before the index is written still holds the old world
+    std::vector<uint8_t> crashed;
+    game::file::load_file(file_name, crashed);
+    std::copy(before.begin(), before.begin() + 5 * 4 + store.get_chunks() * 16, crashed.begin());
+    game::file::save_file(file_name, crashed);
+    game::chunk_store recovered(scale, 4);
+    out = out && compare(crashed.size() > before.size(), true);
+    out = out && compare(load.load_index(file_name), true);
+    load.page_chunks(recovered);
+    out = out && compare(test_chunk_file_equal(loaded, recovered), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk file interrupted save");
+    }
+
+    // Test that mismatched dimensions are rejected
+    game::chunk_file wrong(scale, 8, 8);
+    out = out && compare(wrong.load_index(file_name), false);
+    std::remove(file_name.c_str());
+    out = out && compare(game::chunk_file::is_chunk_file(file_name), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk file dimension check");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
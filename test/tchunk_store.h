@@ -0,0 +1,162 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_CHUNK_STORE_BDS_
+#define _BDS_TEST_CHUNK_STORE_BDS_
+
+#include <game/chunk_store.h>
+#include <min/thread_pool.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_chunk_store()
+{
+    bool out = true;
+
+    // Create a small grid and a dense reference grid
+    const size_t scale = 16;
+    game::chunk_store store(scale, 4);
+    std::vector<game::block_id> dense(scale * scale * scale, game::block_id::EMPTY);
+
+    // Test empty store
+    out = out && compare(store.get(0) == game::block_id::EMPTY, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk store empty get");
+    }
+
+    // Randomly edit the store, forcing palette growth and compaction
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<size_t> key(0, dense.size() - 1);
+    std::uniform_int_distribution<int> id(-1, 37);
+    for (size_t i = 0; i < 20000; i++)
+    {
+        const size_t k = key(gen);
+        const game::block_id value = static_cast<game::block_id>(id(gen));
+        dense[k] = value;
+        store.set(k, value);
+
+        // Compact all chunks every so often
+        if (i % 1000 == 0)
+        {
+            for (size_t c = 0; c < 64; c++)
+            {
+                store.compact(c);
+            }
+        }
+    }
+
+    // Test random edits
+    bool passed = true;
+    for (size_t i = 0; i < dense.size(); i++)
+    {
+        passed = passed && (store.get(i) == dense[i]);
+    }
+    out = out && passed;
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk store random edits");
+    }
+
+    // Test expanding the store
+    std::vector<game::block_id> copy;
+    store.copy(copy);
+    out = out && compare(copy == dense, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk store copy");
+    }
+
+    // Test copying a chunk with its neighbor faces into a padded array
+    std::vector<game::block_id> padded;
+    const size_t as = 6;
+    passed = true;
+    for (const size_t c : {0, 21, 63})
+    {
+        store.copy_apron(c, padded, game::block_id::INVALID);
+        const size_t cx = c / 16;
+        const size_t cy = (c / 4) % 4;
+        const size_t cz = c % 4;
+        for (size_t x = 0; x < as; x++)
+        {
+            for (size_t y = 0; y < as; y++)
+            {
+                for (size_t z = 0; z < as; z++)
+                {
+                    // Skip apron edges and corners
+                    const size_t border = (x == 0 || x == as - 1) + (y == 0 || y == as - 1) + (z == 0 || z == as - 1);
+                    if (border > 1)
+                    {
+                        continue;
+                    }
+
+                    // Cells outside the grid are INVALID
+                    const size_t gx = cx * 4 + x - 1;
+                    const size_t gy = cy * 4 + y - 1;
+                    const size_t gz = cz * 4 + z - 1;
+                    const bool inside = gx < scale && gy < scale && gz < scale;
+                    const game::block_id expect = inside ? dense[(gx * scale + gy) * scale + gz] : game::block_id::INVALID;
+                    passed = passed && (padded[(x * as + y) * as + z] == expect);
+                }
+            }
+        }
+    }
+    out = out && passed;
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk store copy apron");
+    }
+
+    // Test compressing a dense grid
+    min::thread_pool pool;
+    game::chunk_store loaded(scale, 4);
+    loaded.load(pool, dense);
+    pool.kill();
+    passed = true;
+    for (size_t i = 0; i < dense.size(); i++)
+    {
+        passed = passed && (loaded.get(i) == dense[i]);
+    }
+    out = out && passed;
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk store load");
+    }
+
+    // Test that uniform chunks collapse after compaction
+    for (size_t i = 0; i < dense.size(); i++)
+    {
+        store.set(i, game::block_id::STONE1);
+    }
+    for (size_t c = 0; c < 64; c++)
+    {
+        store.compact(c);
+    }
+    out = out && compare(store.get_chunk(0).is_uniform(), true);
+    out = out && compare(store.get(100) == game::block_id::STONE1, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed chunk store uniform compaction");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
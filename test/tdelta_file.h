@@ -0,0 +1,115 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_DELTA_FILE_BDS_
+#define _BDS_TEST_DELTA_FILE_BDS_
+
+#include <cstdio>
+#include <game/chunk_file.h>
+#include <game/chunk_store.h>
+#include <game/delta_file.h>
+#include <game/file.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_delta_file()
+{
+    bool out = true;
+
+    // Edit a few cells of a small grid, including the first and last cell
+    const size_t scale = 16;
+    const std::string file_name = "delta_file.test";
+    game::chunk_store store(scale, 4);
+    const std::vector<size_t> keys = {0, 7, 8, 300, 301, 4095};
+    for (const size_t k : keys)
+    {
+        store.set(k, static_cast<game::block_id>(k % 20));
+    }
+    store.set(301, game::block_id::EMPTY);
+
+    // Test save and load of seed and edits
+    game::delta_file save(scale, 4, 1);
+    save.save(file_name, game::world_type::portal, 0xDEADBEEF12345678ull, store, keys);
+    game::delta_file load(scale, 4, 1);
+    out = out && compare(game::delta_file::is_delta_file(file_name), true);
+    out = out && compare(game::chunk_file::is_chunk_file(file_name), false);
+    out = out && compare(load.load(file_name), true);
+    out = out && compare(load.get_type() == game::world_type::portal, true);
+    out = out && compare(load.get_seed() == 0xDEADBEEF12345678ull, true);
+    out = out && compare(load.get_keys() == keys, true);
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        out = out && compare(load.get_ids()[i] == store.get(keys[i]), true);
+    }
+    out = out && compare(game::file::exists_file(file_name + ".tmp"), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed delta file save");
+    }
+
+    // A save that can't be written leaves the old world in place
+    save.save("missing_directory/" + file_name, game::world_type::normal, 1, store, keys);
+    out = out && compare(load.load(file_name), true);
+    out = out && compare(load.get_seed() == 0xDEADBEEF12345678ull, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed delta file failed save");
+    }
+
+    // Test that worlds from another generator version are refused and flagged
+    game::delta_file newer(scale, 4, 2);
+    out = out && compare(newer.load(file_name), false);
+    out = out && compare(newer.is_stale(), true);
+    out = out && compare(load.load(file_name), true);
+    out = out && compare(load.is_stale(), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed delta file generator version");
+    }
+
+    // Test that unknown block ids are rejected
+    std::vector<uint8_t> stream;
+    game::file::load_file(file_name, stream);
+    std::vector<uint8_t> bad = stream;
+    bad.back() = static_cast<uint8_t>(22);
+    game::file::save_file(file_name, bad);
+    out = out && compare(load.load(file_name), false);
+    out = out && compare(load.is_stale(), false);
+    game::file::save_file(file_name, stream);
+    if (!out)
+    {
+        throw std::runtime_error("Failed delta file block ids");
+    }
+
+    // Test that mismatched dimensions and truncated files are rejected
+    game::delta_file wrong(scale, 8, 1);
+    out = out && compare(wrong.load(file_name), false);
+    stream.resize(stream.size() - 1);
+    game::file::save_file(file_name, stream);
+    out = out && compare(load.load(file_name), false);
+    std::remove(file_name.c_str());
+    if (!out)
+    {
+        throw std::runtime_error("Failed delta file checks");
+    }
+
+    // return status
+    return out;
+}
+
+#endif
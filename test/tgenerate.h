@@ -0,0 +1,165 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_GENERATE_BDS_
+#define _BDS_TEST_GENERATE_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <kernel/terrain_base.h>
+#include <kernel/terrain_creative.h>
+#include <kernel/terrain_height.h>
+#include <min/thread_pool.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+std::vector<game::block_id> test_generate_normal(min::thread_pool &pool, const size_t scale, const uint64_t seed)
+{
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+
+    // Same steps as the normal world generator
+    kernel::terrain_base base(scale, 8, 0, scale / 2, seed);
+    base.generate(pool, grid);
+    kernel::terrain_height height(scale, 8, scale / 2, scale - 1, seed);
+    height.generate(pool, grid);
+
+    return grid;
+}
+
+std::vector<game::block_id> test_generate_creative(min::thread_pool &pool, const size_t scale, const uint64_t seed)
+{
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+
+    // Same steps as the creative world generator
+    kernel::terrain_creative creative(scale, 8, seed);
+    creative.generate(pool, grid);
+
+    return grid;
+}
+
+uint64_t test_generate_hash(const std::vector<game::block_id> &grid)
+{
+    // FNV-1a over the block ids, a fixed value catches any change to what a seed produces
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (const game::block_id id : grid)
+    {
+        hash ^= static_cast<uint8_t>(static_cast<int8_t>(id));
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+template <typename F>
+std::vector<game::block_id> test_generate_chunks(const size_t scale, const size_t chunk_size, const F &generate)
+{
+    std::vector<game::block_id> grid(scale * scale * scale, game::block_id::EMPTY);
+    std::vector<game::block_id> cells(chunk_size * chunk_size * chunk_size);
+
+    // Generate every chunk on its own and scatter it into the grid
+    for (size_t x = 0; x < scale; x += chunk_size)
+    {
+        for (size_t y = 0; y < scale; y += chunk_size)
+        {
+            for (size_t z = 0; z < scale; z += chunk_size)
+            {
+                std::fill(cells.begin(), cells.end(), game::block_id::EMPTY);
+                generate(min::tri<size_t>(x, y, z), cells);
+                for (size_t i = 0, c = 0; i < chunk_size; i++)
+                {
+                    for (size_t j = 0; j < chunk_size; j++)
+                    {
+                        for (size_t k = 0; k < chunk_size; k++, c++)
+                        {
+                            grid[((x + i) * scale + (y + j)) * scale + (z + k)] = cells[c];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return grid;
+}
+
+bool test_generate()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel, and one with a single worker
+    min::thread_pool pool;
+    min::thread_pool single(1);
+
+    // Worlds with the same seed must match no matter how many workers split the slices
+    const size_t scale = 64;
+    const std::vector<game::block_id> normal_world = test_generate_normal(pool, scale, 1234);
+    out = out && compare(normal_world == test_generate_normal(single, scale, 1234), true);
+    out = out && compare(normal_world == test_generate_normal(pool, scale, 1235), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed generate normal seed");
+    }
+
+    const std::vector<game::block_id> creative_world = test_generate_creative(pool, scale, 1234);
+    out = out && compare(creative_world == test_generate_creative(single, scale, 1234), true);
+    out = out && compare(creative_world == test_generate_creative(pool, scale, 1235), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed generate creative seed");
+    }
+
+    // A seed must produce the same world on every build, bump cgrid_generator::_version when these change
+    out = out && compare(test_generate_hash(normal_world) == 0xAA3FB63855E86CB2ull, true);
+    out = out && compare(test_generate_hash(creative_world) == 0xD7D756801B99A3B6ull, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed generate world hash");
+    }
+
+    // Chunks generated on their own must match the whole world
+    const uint64_t seed = 1234;
+    const kernel::terrain_base base(scale, 8, 0, scale / 2, seed);
+    const kernel::terrain_height height(scale, 8, scale / 2, scale - 1, seed);
+    const std::vector<game::block_id> normal = test_generate_chunks(scale, 8, [&base, &height](const min::tri<size_t> &start, std::vector<game::block_id> &cells) {
+        base.generate_chunk(start, cells);
+        height.generate_chunk(start, cells);
+    });
+    out = out && compare(normal == test_generate_normal(pool, scale, seed), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed generate normal chunks");
+    }
+
+    const kernel::terrain_creative creative(scale, 8, seed);
+    const std::vector<game::block_id> chunks = test_generate_chunks(scale, 8, [&creative](const min::tri<size_t> &start, std::vector<game::block_id> &cells) {
+        creative.generate_chunk(start, cells);
+    });
+    out = out && compare(chunks == test_generate_creative(pool, scale, seed), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed generate creative chunks");
+    }
+
+    // Kill the pools
+    pool.kill();
+    single.kill();
+
+    return out;
+}
+
+#endif
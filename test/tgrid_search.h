@@ -0,0 +1,389 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_GRID_SEARCH_BDS_
+#define _BDS_TEST_GRID_SEARCH_BDS_
+
+#include <algorithm>
+#include <game/chunk_store.h>
+#include <game/flow_field.h>
+#include <game/grid_search.h>
+#include <game/nav_graph.h>
+#include <game/path_queue.h>
+#include <game/search_map.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <test.h>
+#include <vector>
+
+bool test_grid_search()
+{
+    bool out = true;
+
+    // Fill a search map past its initial capacity
+    game::search_map<int_fast8_t> map(16);
+    for (size_t i = 0; i < 1000; i++)
+    {
+        map.insert(i * 4099, static_cast<int_fast8_t>(i % 2));
+    }
+    bool passed = true;
+    for (size_t i = 0; i < 1000; i++)
+    {
+        const int_fast8_t *value = map.find(i * 4099);
+        passed = passed && value && (*value == static_cast<int_fast8_t>(i % 2));
+    }
+    out = out && passed;
+    out = out && compare(static_cast<int>(map.size()), 1000);
+    out = out && compare(map.find(7) == nullptr, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed search map insert");
+    }
+
+    // Clearing forgets every key without shrinking the table
+    const size_t capacity = map.capacity();
+    map.clear();
+    out = out && compare(map.find(4099) == nullptr, true);
+    out = out && compare(static_cast<int>(map.size()), 0);
+    out = out && compare(map.capacity() == capacity, true);
+    map.insert(4099, 1);
+    out = out && compare(static_cast<int>(*map.find(4099)), 1);
+    if (!out)
+    {
+        throw std::runtime_error("Failed search map clear");
+    }
+
+    // Empty world with a wall across X, open only along the top row
+    const size_t scale = 16;
+    game::chunk_store store(scale, 8);
+    for (size_t y = 0; y < scale - 1; y++)
+    {
+        for (size_t z = 0; z < scale; z++)
+        {
+            store.set(min::tri<size_t>(8, y, z), game::block_id::STONE2);
+        }
+    }
+
+    // Search a straight line next to the wall
+    game::grid_search search(scale);
+    const size_t a_key = min::vec3<float>::grid_key(min::tri<size_t>(2, 4, 4), scale);
+    const size_t b_key = min::vec3<float>::grid_key(min::tri<size_t>(6, 4, 4), scale);
+    search.search(store, a_key, b_key);
+    const std::vector<size_t> path = search.get_path();
+    out = out && compare(static_cast<int>(path.size()), 5);
+    out = out && compare(path.size() > 0 && path.back() == b_key, true);
+    out = out && compare(search.is_found(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed grid search straight path");
+    }
+
+    // Searches do not leak nodes into the next search
+    search.search(store, a_key, b_key);
+    out = out && compare(search.get_path() == path, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed grid search repeat");
+    }
+
+    // Route over the wall, the path is a horizon of unit steps through empty cells
+    const size_t c_key = min::vec3<float>::grid_key(min::tri<size_t>(12, 4, 4), scale);
+    search.search(store, a_key, c_key);
+    const std::vector<size_t> &route = search.get_path();
+    bool steps = (route.size() == 21) && (route.front() == a_key);
+    for (size_t i = 1; i < route.size(); i++)
+    {
+        const min::tri<size_t> p = min::vec3<float>::grid_index(route[i - 1], scale);
+        const min::tri<size_t> q = min::vec3<float>::grid_index(route[i], scale);
+        const size_t dist = (std::max(p.x(), q.x()) - std::min(p.x(), q.x())) + (std::max(p.y(), q.y()) - std::min(p.y(), q.y())) + (std::max(p.z(), q.z()) - std::min(p.z(), q.z()));
+        steps = steps && (dist == 1) && (store.get(route[i]) == game::block_id::EMPTY);
+    }
+    out = out && compare(search.is_found(), true);
+    out = out && compare(steps, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed grid search route around wall");
+    }
+
+    // A goal inside terrain is never found, the path heads for the nearest reachable cell
+    const size_t wall_key = min::vec3<float>::grid_key(min::tri<size_t>(8, 4, 4), scale);
+    search.search(store, a_key, wall_key);
+    out = out && compare(search.is_found(), false);
+    out = out && compare(search.get_path().size() > 0 && search.get_path().back() == min::vec3<float>::grid_key(min::tri<size_t>(7, 4, 4), scale), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed grid search walled goal");
+    }
+
+    // Starting inside terrain finds nothing
+    search.search(store, wall_key, b_key);
+    out = out && compare(search.get_path().empty(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed grid search blocked start");
+    }
+
+    // Searches stop at the query budget, the next search gets a full budget
+    search.set_budget(64);
+    search.search(store, a_key, c_key);
+    out = out && compare(search.is_found(), false);
+    out = out && compare(static_cast<int>(search.get_expanded()), 64);
+    search.search(store, a_key, b_key);
+    out = out && compare(search.is_found(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed grid search query budget");
+    }
+
+    // Snapshot the chunks of a box of the world
+    const size_t chunk_scale = scale / 8;
+    const auto box = [&store, scale, chunk_scale](const min::tri<size_t> &lower, const min::tri<size_t> &upper) -> game::path_snapshot {
+        game::path_snapshot out(scale, 8, lower, upper);
+        for (size_t x = lower.x(); x < upper.x(); x++)
+        {
+            for (size_t y = lower.y(); y < upper.y(); y++)
+            {
+                for (size_t z = lower.z(); z < upper.z(); z++)
+                {
+                    out.push_back(std::make_shared<const game::palette_chunk>(store.get_chunk((x * chunk_scale + y) * chunk_scale + z)), 0);
+                }
+            }
+        }
+        return out;
+    };
+    game::path_snapshot snapshot = box(min::tri<size_t>(0, 0, 0), min::tri<size_t>(chunk_scale, 1, chunk_scale));
+    out = out && compare(snapshot.get(wall_key) == game::block_id::STONE2, true);
+    out = out && compare(snapshot.get(a_key) == game::block_id::EMPTY, true);
+    out = out && compare(snapshot.get(min::vec3<float>::grid_key(min::tri<size_t>(2, 8, 4), scale)) == game::block_id::INVALID, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed path snapshot");
+    }
+
+    // Search on a worker thread, the wall can't be crossed inside the snapshot
+    game::path_queue queue(scale, 8, 8, 1);
+    queue.push(3, 7, a_key, c_key, std::move(snapshot), nullptr);
+    bool popped = false;
+    std::vector<size_t> async;
+    while (!popped)
+    {
+        std::this_thread::yield();
+        queue.pop([&popped, &async](const size_t id, const size_t ticket, const std::vector<size_t> &keys) {
+            popped = (id == 3) && (ticket == 7);
+            async = keys;
+        });
+    }
+    out = out && compare(async.size() > 0 && async.front() == a_key, true);
+    out = out && compare(async.size() > 0 && async.back() == min::vec3<float>::grid_key(min::tri<size_t>(7, 4, 4), scale), true);
+    out = out && compare(static_cast<int>(queue.get_completed()), 1);
+    out = out && compare(static_cast<int>(queue.get_depth()), 0);
+    out = out && compare(static_cast<int>(queue.get_max_depth()), 1);
+    out = out && compare(queue.get_latency_max() >= queue.get_latency_avg(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed path queue");
+    }
+
+    // Route over the chunk graph of the whole world, the only portal across the wall is in the top row
+    const game::path_snapshot world = box(min::tri<size_t>(0, 0, 0), min::tri<size_t>(chunk_scale, chunk_scale, chunk_scale));
+    game::nav_graph nav(scale, 8);
+    out = out && compare(nav.route(world, a_key, c_key, 1000), true);
+    const std::vector<size_t> portals = nav.get_route();
+    bool top = false;
+    bool open = true;
+    for (const size_t key : portals)
+    {
+        const min::tri<size_t> p = min::vec3<float>::grid_index(key, scale);
+        top = top || (p.x() == 7 && p.y() == scale - 1) || (p.x() == 8 && p.y() == scale - 1);
+        open = open && (store.get(key) == game::block_id::EMPTY);
+    }
+    out = out && compare(top, true);
+    out = out && compare(open, true);
+    out = out && compare(nav.get_built() >= 4, true);
+    const size_t built = nav.get_built();
+    if (!out)
+    {
+        throw std::runtime_error("Failed nav graph route");
+    }
+
+    // Routes are cut at the last portal within reach, chunks are reused
+    out = out && compare(nav.route(world, a_key, c_key, 8), true);
+    out = out && compare(nav.get_route().size() < portals.size(), true);
+    const min::tri<size_t> w = min::vec3<float>::grid_index(nav.get_waypoint(), scale);
+    out = out && compare(w.y() + 1 == 8 || w.y() == 8, true);
+    out = out && compare(nav.get_built() == built, true);
+    out = out && compare(nav.route(world, a_key, b_key, 1000), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed nav graph reach");
+    }
+
+    // Goals out of the snapshot are routed on the worker, the search heads up to the portal in reach
+    queue.push(4, 8, a_key, c_key, box(min::tri<size_t>(0, 0, 0), min::tri<size_t>(1, 1, 1)), std::make_shared<const game::path_snapshot>(world));
+    popped = false;
+    while (!popped)
+    {
+        std::this_thread::yield();
+        queue.pop([&popped, &async](const size_t id, const size_t ticket, const std::vector<size_t> &keys) {
+            popped = (id == 4) && (ticket == 8);
+            async = keys;
+        });
+    }
+    const min::tri<size_t> up = min::vec3<float>::grid_index(async.back(), scale);
+    out = out && compare(async.front() == a_key, true);
+    out = out && compare(up.y() == 7 && (up.x() == 3 || up.x() == 4), true);
+    std::vector<size_t> missing;
+    queue.pop_missing(missing);
+    out = out && compare(missing.empty(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed path queue route");
+    }
+
+    // Routes through chunks the world has no copy of fail and report them
+    const size_t gap_key = (1 * chunk_scale + 1) * chunk_scale;
+    game::path_snapshot gap(scale, 8, min::tri<size_t>(0, 0, 0), min::tri<size_t>(chunk_scale, chunk_scale, chunk_scale));
+    for (size_t i = 0; i < chunk_scale * chunk_scale * chunk_scale; i++)
+    {
+        gap.push_back((i != gap_key) ? std::make_shared<const game::palette_chunk>(store.get_chunk(i)) : nullptr, 0);
+    }
+    game::nav_graph blind(scale, 8);
+    out = out && compare(blind.route(gap, a_key, c_key, 1000), false);
+    const std::vector<size_t> &unseen = blind.get_missing();
+    out = out && compare(std::find(unseen.begin(), unseen.end(), gap_key) != unseen.end(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed nav graph missing chunks");
+    }
+
+    // A face with two openings gets a portal for each, only the off center one leads to the goal
+    game::chunk_store split(scale, 8);
+    for (size_t y = 0; y < scale; y++)
+    {
+        for (size_t z = 0; z < scale; z++)
+        {
+            split.set(min::tri<size_t>(8, y, z), game::block_id::STONE2);
+        }
+    }
+    split.set(min::tri<size_t>(8, 3, 3), game::block_id::EMPTY);
+    split.set(min::tri<size_t>(9, 3, 3), game::block_id::STONE2);
+    split.set(min::tri<size_t>(8, 0, 6), game::block_id::EMPTY);
+    const size_t hole_key = min::vec3<float>::grid_key(min::tri<size_t>(8, 0, 6), scale);
+    game::path_snapshot split_world(scale, 8, min::tri<size_t>(0, 0, 0), min::tri<size_t>(chunk_scale, chunk_scale, chunk_scale));
+    for (size_t i = 0; i < chunk_scale * chunk_scale * chunk_scale; i++)
+    {
+        split_world.push_back(std::make_shared<const game::palette_chunk>(split.get_chunk(i)), 0);
+    }
+    game::nav_graph runs(scale, 8);
+    out = out && compare(runs.route(split_world, a_key, min::vec3<float>::grid_key(min::tri<size_t>(12, 2, 2), scale), 1000), true);
+    const std::vector<size_t> &through = runs.get_route();
+    out = out && compare(std::find(through.begin(), through.end(), hole_key) != through.end(), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed nav graph face runs");
+    }
+
+    // Build a flow field toward the goal over several frames
+    game::flow_field field(scale, 8);
+    field.set_budget(256);
+    field.set_goal(c_key);
+    size_t frames = 0;
+    do
+    {
+        field.update(store);
+        frames++;
+    } while (field.is_building());
+    out = out && compare(field.is_ready(), true);
+    out = out && compare(frames > 1, true);
+    out = out && compare(static_cast<int>(field.get_distance(c_key)), 0);
+    out = out && compare(static_cast<int>(field.get_distance(a_key)), 32);
+    out = out && compare(static_cast<int>(field.get_distance(wall_key)), 0xFFFF);
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow field distance");
+    }
+
+    // Drones walk down the field along the same kind of route as the search
+    out = out && compare(field.path(store, a_key, c_key), true);
+    const std::vector<size_t> &flow = field.get_path();
+    steps = (flow.size() == 21) && (flow.front() == a_key);
+    for (size_t i = 1; i < flow.size(); i++)
+    {
+        steps = steps && (field.get_distance(flow[i]) + 1 == field.get_distance(flow[i - 1])) && (store.get(flow[i]) == game::block_id::EMPTY);
+    }
+    out = out && compare(steps, true);
+    out = out && compare(field.path(store, a_key, b_key), false);
+    out = out && compare(field.path(store, c_key, c_key), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow field path");
+    }
+
+    // While a field toward a new goal is built, drones only use the finished field for its own goal
+    field.set_goal(b_key);
+    field.update(store);
+    out = out && compare(field.is_building(), true);
+    out = out && compare(field.path(store, a_key, c_key), true);
+    out = out && compare(field.path(store, a_key, b_key), false);
+    do
+    {
+        field.update(store);
+    } while (field.is_building());
+    out = out && compare(field.path(store, a_key, c_key), false);
+    out = out && compare(field.path(store, a_key, b_key), true);
+    field.set_goal(c_key);
+    do
+    {
+        field.update(store);
+    } while (field.is_building());
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow field goal change");
+    }
+
+    // Closing the top row walls off the goal once the field is rebuilt
+    for (size_t z = 0; z < scale; z++)
+    {
+        const min::tri<size_t> index(8, scale - 1, z);
+        store.set(index, game::block_id::STONE2);
+        field.edit(index);
+    }
+    do
+    {
+        field.update(store);
+    } while (field.is_building());
+    out = out && compare(static_cast<int>(field.get_distance(a_key)), 0xFFFF);
+    out = out && compare(field.path(store, a_key, c_key), false);
+    game::path_snapshot edited(scale, 8, min::tri<size_t>(0, 0, 0), min::tri<size_t>(chunk_scale, chunk_scale, chunk_scale));
+    for (size_t i = 0; i < chunk_scale * chunk_scale * chunk_scale; i++)
+    {
+        const bool top_row = i / chunk_scale == 1 * chunk_scale + 1;
+        edited.push_back(std::make_shared<const game::palette_chunk>(store.get_chunk(i)), top_row ? 1 : 0);
+    }
+    out = out && compare(nav.route(edited, a_key, c_key, 1000), false);
+    if (!out)
+    {
+        throw std::runtime_error("Failed flow field edit");
+    }
+
+    return out;
+}
+
+#endif
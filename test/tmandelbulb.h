@@ -0,0 +1,144 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_MANDELBULB_BDS_
+#define _BDS_TEST_MANDELBULB_BDS_
+
+#include <iostream>
+#include <kernel/mandelbulb_asym.h>
+#include <kernel/mandelbulb_exp.h>
+#include <kernel/mandelbulb_sym.h>
+#include <min/thread_pool.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+template <typename K>
+bool test_mandelbulb_batch(K &k, min::thread_pool &pool)
+{
+    // Cell centers of a small portal grid
+    const size_t scale = 32;
+    const auto f = [scale](const size_t i) -> min::vec3<float> {
+        const float half = scale / 2;
+        const size_t x = i / (scale * scale);
+        const size_t y = (i / scale) % scale;
+        const size_t z = i % scale;
+        return min::vec3<float>(x - half + 0.5, y - half + 0.5, z - half + 0.5);
+    };
+
+    // Prefill some cells, generate must skip them
+    std::vector<game::block_id> scalar(scale * scale * scale, game::block_id::EMPTY);
+    for (size_t i = 0; i < scalar.size(); i += 37)
+    {
+        scalar[i] = game::block_id::STONE2;
+    }
+    std::vector<game::block_id> batch = scalar;
+    std::vector<game::block_id> fold = scalar;
+
+    // Generate one cell at a time, with the best supported lane width, and folded by symmetry
+    k.set_fold(false);
+    k.set_simd(kernel::simd_level::scalar);
+    k.generate(pool, scalar, scale, f);
+    k.set_simd(kernel::simd_support());
+    k.generate(pool, batch, scale, f);
+    k.set_fold(true);
+    k.generate(pool, fold, scale, f);
+
+    // Generate chunk by chunk from the class table and without it
+    std::vector<game::block_id> chunks = scalar;
+    std::vector<game::block_id> lanes = scalar;
+    const size_t chunk_size = 8;
+    for (const bool prepare : {true, false})
+    {
+        k.set_fold(prepare);
+        k.prepare(pool, scale, f);
+        std::vector<game::block_id> &grid = prepare ? chunks : lanes;
+        for (size_t x = 0; x < scale; x += chunk_size)
+        {
+            for (size_t y = 0; y < scale; y += chunk_size)
+            {
+                for (size_t z = 0; z < scale; z += chunk_size)
+                {
+                    // Gather the chunk, generate it and scatter it back into the grid
+                    std::vector<game::block_id> cells(chunk_size * chunk_size * chunk_size);
+                    for (size_t i = 0; i < cells.size(); i++)
+                    {
+                        cells[i] = grid[((x + i / (chunk_size * chunk_size)) * scale + y + (i / chunk_size) % chunk_size) * scale + z + i % chunk_size];
+                    }
+                    k.generate_chunk(min::tri<size_t>(x, y, z), cells, chunk_size, scale, f);
+                    for (size_t i = 0; i < cells.size(); i++)
+                    {
+                        grid[((x + i / (chunk_size * chunk_size)) * scale + y + (i / chunk_size) % chunk_size) * scale + z + i % chunk_size] = cells[i];
+                    }
+                }
+            }
+        }
+    }
+
+    // Batched, folded and chunked kernels must match the scalar kernel exactly
+    bool out = true;
+    out = out && compare(scalar == batch, true);
+    out = out && compare(scalar == fold, true);
+    out = out && compare(scalar == chunks, true);
+    out = out && compare(scalar == lanes, true);
+    return out;
+}
+
+bool test_mandelbulb()
+{
+    bool out = true;
+
+    // Create a threadpool for doing work in parallel
+    min::thread_pool pool;
+
+    // Test symmetric mandelbulb
+    kernel::mandelbulb_sym sym(1, 10, 30, 5);
+    out = out && test_mandelbulb_batch(sym, pool);
+    if (!out)
+    {
+        throw std::runtime_error("Failed mandelbulb sym batch");
+    }
+
+    // Test asymmetric mandelbulb
+    kernel::mandelbulb_asym asym(1, 10, 30, 5, 2, 8, 20, 4, 3, 12, 25, 6);
+    out = out && test_mandelbulb_batch(asym, pool);
+    if (!out)
+    {
+        throw std::runtime_error("Failed mandelbulb asym batch");
+    }
+
+    // Test exponential mandelbulb with every exp function
+    kernel::mandelbulb_exp exp(3, 5, 7, 2);
+    for (const auto mode : {kernel::exp_mode::libm, kernel::exp_mode::bounded, kernel::exp_mode::fast})
+    {
+        exp.set_exp(mode);
+        out = out && test_mandelbulb_batch(exp, pool);
+        if (!out)
+        {
+            throw std::runtime_error("Failed mandelbulb exp batch");
+        }
+    }
+
+    // Kill the pool
+    pool.kill();
+
+    return out;
+}
+
+#endif
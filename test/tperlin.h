@@ -0,0 +1,161 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_PERLIN_BDS_
+#define _BDS_TEST_PERLIN_BDS_
+
+#include <game/chunk_noise.h>
+#include <game/fractal_noise.h>
+#include <game/perlin.h>
+#include <stdexcept>
+#include <test.h>
+#include <vector>
+
+bool test_perlin_batch(kernel::perlin_noise &noise, const size_t chunk_size)
+{
+    // Brick of samples on the terrain lattice, spanning several lattice cells per axis
+    const size_t n = 4 * chunk_size + 3;
+    const float inv_cs = 1.0 / chunk_size;
+    std::vector<float> coord(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        coord[i] = (i + 1) * inv_cs;
+    }
+
+    // Evaluate the brick with the batch kernel
+    std::vector<float> batch(n * n * n);
+    noise.perlin_brick(coord.data(), n, coord.data(), n, coord.data(), n, batch.data());
+
+    // Batch must match the scalar kernel within float tolerance
+    bool out = true;
+    for (size_t i = 0, c = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            for (size_t k = 0; k < n; k++, c++)
+            {
+                const float scalar = noise.perlin(coord[i], coord[j], coord[k]);
+                out = out && compare(scalar, batch[c], 1E-6);
+            }
+        }
+    }
+
+    return out;
+}
+
+bool test_fractal_range(const kernel::fractal_noise &noise)
+{
+    // Octave sums are normalized to [0, 1]
+    const size_t n = 16;
+    std::vector<float> field(n * n * n);
+    noise.brick(min::tri<size_t>(3, 5, 7), n, n, n, field.data());
+
+    bool out = true;
+    for (const float f : field)
+    {
+        out = out && compare(f >= 0.0 && f <= 1.0, true);
+    }
+
+    return out;
+}
+
+bool test_fractal()
+{
+    bool out = true;
+
+    // One fbm octave is the plain perlin noise
+    const size_t n = 12;
+    const float frequency = 1.0 / 8;
+    std::vector<float> coord(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        coord[i] = (i + 4) * frequency;
+    }
+    const kernel::perlin_noise perlin(1234);
+    std::vector<float> expect(n * n * n);
+    perlin.perlin_brick(coord.data(), n, coord.data(), n, coord.data(), n, expect.data());
+    const kernel::fractal_noise single(1234, frequency, kernel::fractal_type::fbm, 1);
+    std::vector<float> field(n * n * n);
+    single.brick(min::tri<size_t>(4, 4, 4), n, n, n, field.data());
+    out = out && compare(field == expect, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed fractal single octave");
+    }
+
+    // Multiple octaves, ridged and warped noise stay in range
+    out = out && test_fractal_range(kernel::fractal_noise(1234, frequency, kernel::fractal_type::fbm, 5));
+    out = out && test_fractal_range(kernel::fractal_noise(1234, frequency, kernel::fractal_type::ridged, 5));
+    out = out && test_fractal_range(kernel::fractal_noise(1234, frequency, kernel::fractal_type::fbm, 3, 2.0, 0.5, 4.0));
+    if (!out)
+    {
+        throw std::runtime_error("Failed fractal range");
+    }
+
+    // Chunk fields match the brick and are sampled once per chunk
+    const size_t cs = 8;
+    const kernel::fractal_noise fbm(1234, frequency, kernel::fractal_type::fbm, 4);
+    std::vector<float> chunk(cs * cs * cs);
+    fbm.brick(min::tri<size_t>(8, 16, 24), cs, cs, cs, chunk.data());
+    kernel::chunk_noise cache(cs);
+    const size_t layer = cache.add(fbm);
+    cache.set_chunk(min::tri<size_t>(8, 16, 24));
+    const float *const first = cache.get(layer);
+    out = out && compare(std::vector<float>(first, first + chunk.size()) == chunk, true);
+    out = out && compare(cache.get(layer) == first, true);
+    cache.set_chunk(min::tri<size_t>(16, 16, 24));
+    out = out && compare(cache.get(layer)[0] != chunk[0], true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed fractal chunk cache");
+    }
+
+    return out;
+}
+
+bool test_perlin()
+{
+    bool out = true;
+
+    // Same noise for the same seed
+    kernel::perlin_noise noise(1234);
+    const kernel::perlin_noise same(1234);
+    out = out && compare(noise.perlin(1.25, 2.5, 3.75), same.perlin(1.25, 2.5, 3.75), 0.0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed perlin seed");
+    }
+
+    // Test the baseline and the best supported batch kernel
+    for (const kernel::simd_level level : {kernel::simd_level::scalar, kernel::simd_support()})
+    {
+        noise.set_simd(level);
+        out = out && test_perlin_batch(noise, 8);
+        out = out && test_perlin_batch(noise, 6);
+        if (!out)
+        {
+            throw std::runtime_error("Failed perlin batch");
+        }
+    }
+
+    // Fractal noise is built on the batch kernel
+    out = out && test_fractal();
+
+    return out;
+}
+
+#endif
@@ -0,0 +1,367 @@
+/* Copyright [2013-2018] [Aaron Springstroh, Minimal Graphics Library]
+
+This file is part of the Beyond Dying Skies.
+
+Beyond Dying Skies is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+Beyond Dying Skies is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with Beyond Dying Skies.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _BDS_TEST_TERRAIN_MESHER_BDS_
+#define _BDS_TEST_TERRAIN_MESHER_BDS_
+
+#include <algorithm>
+#include <cstdint>
+#include <game/chunk_remesher.h>
+#include <game/chunk_store.h>
+#include <game/geometry.h>
+#include <game/id.h>
+#include <game/mesh_batch.h>
+#include <game/terrain_mesher.h>
+#include <min/mesh.h>
+#include <min/thread_pool.h>
+#include <min/tri.h>
+#include <min/vec3.h>
+#include <random>
+#include <stdexcept>
+#include <test.h>
+#include <thread>
+#include <vector>
+
+min::tri<size_t> test_terrain_mesher_start(const size_t scale, const size_t chunk_size, const size_t key)
+{
+    // First cell of the chunk, chunk keys are x major
+    const size_t chunk_scale = scale / chunk_size;
+    const size_t cx = key / (chunk_scale * chunk_scale);
+    const size_t cy = (key / chunk_scale) % chunk_scale;
+    const size_t cz = key % chunk_scale;
+
+    return min::tri<size_t>(cx * chunk_size, cy * chunk_size, cz * chunk_size);
+}
+min::vec3<float> test_terrain_mesher_origin(const size_t scale, const size_t chunk_size, const size_t key)
+{
+    // Chunk corner in world space
+    const min::tri<size_t> start = test_terrain_mesher_start(scale, chunk_size, key);
+    const float world_min = -static_cast<float>(scale / 2);
+
+    return min::vec3<float>(start.x(), start.y(), start.z()) + world_min;
+}
+void test_terrain_mesher_grid(const game::chunk_store &store, const size_t scale, const size_t chunk_size, const game::terrain_mesher &mesher, const size_t key, min::mesh<float, uint32_t> &mesh)
+{
+    // Reference mesh, faces are culled with a grid lookup per neighbor
+    const size_t edge = scale - 1;
+    const min::tri<size_t> edges(edge, edge, edge);
+    const min::tri<size_t> start = test_terrain_mesher_start(scale, chunk_size, key);
+    const float world_min = -static_cast<float>(scale / 2);
+    const auto get_block = [&store](const min::tri<size_t> &index) -> game::block_id {
+        return store.get(index);
+    };
+
+    // Clear the mesh and mesher
+    mesh.clear();
+    mesher.clear();
+    mesher.set_origin(test_terrain_mesher_origin(scale, chunk_size, key));
+
+    // Generate cell faces
+    const size_t xs = start.x();
+    const size_t ys = start.y();
+    const size_t zs = start.z();
+    for (size_t x = xs; x < xs + chunk_size; x++)
+    {
+        for (size_t y = ys; y < ys + chunk_size; y++)
+        {
+            for (size_t z = zs; z < zs + chunk_size; z++)
+            {
+                const min::tri<size_t> index(x, y, z);
+                const game::block_id atlas = get_block(index);
+                if (atlas != game::block_id::EMPTY)
+                {
+                    const min::vec3<float> p = min::vec3<float>(x, y, z) + world_min + 0.5;
+                    mesher.generate_chunk_faces(p, index, edges, get_block, static_cast<float>(atlas));
+                }
+            }
+        }
+    }
+
+    // Generate mesh
+    mesher.generate_chunk_serial(mesh);
+}
+template <typename F>
+void test_terrain_mesher_padded(const game::chunk_store &store, const size_t scale, const size_t chunk_size, const game::terrain_mesher &mesher, const size_t key, min::mesh<float, uint32_t> &mesh, const F &generate)
+{
+    // Clear the mesh and mesher
+    mesh.clear();
+    mesher.clear();
+    mesher.set_origin(test_terrain_mesher_origin(scale, chunk_size, key));
+
+    // Generate cell faces from the chunk and a one cell apron
+    std::vector<game::block_id> padded;
+    store.copy_apron(key, padded, game::block_id::INVALID);
+    generate(padded);
+
+    // Generate mesh
+    mesher.generate_chunk_serial(mesh);
+}
+bool test_terrain_mesher_equal(const min::mesh<float, uint32_t> &a, const min::mesh<float, uint32_t> &b)
+{
+    // Vertex streams must match exactly, in order
+    const size_t size = a.vertex.size();
+    bool out = (size == b.vertex.size());
+    for (size_t i = 0; out && i < size; i++)
+    {
+        const min::vec4<float> &u = a.vertex[i];
+        const min::vec4<float> &v = b.vertex[i];
+        out = (u.x() == v.x()) && (u.y() == v.y()) && (u.z() == v.z()) && (u.w() == v.w());
+    }
+
+    return out;
+}
+void test_terrain_mesher_faces(const min::mesh<float, uint32_t> &mesh, std::vector<uint64_t> &faces)
+{
+    // Split every quad into unit faces keyed by face code, plane and cell
+    const size_t size = mesh.vertex.size();
+    for (size_t i = 0; i < size; i += 6)
+    {
+        float lo[3] = {mesh.vertex[i].x(), mesh.vertex[i].y(), mesh.vertex[i].z()};
+        float hi[3] = {lo[0], lo[1], lo[2]};
+        for (size_t j = i + 1; j < i + 6; j++)
+        {
+            const float v[3] = {mesh.vertex[j].x(), mesh.vertex[j].y(), mesh.vertex[j].z()};
+            for (size_t k = 0; k < 3; k++)
+            {
+                lo[k] = std::min(lo[k], v[k]);
+                hi[k] = std::max(hi[k], v[k]);
+            }
+        }
+
+        // The quad is flat along the face normal
+        const uint64_t code = static_cast<uint64_t>(mesh.vertex[i].w());
+        const size_t n = (code & 7) / 2;
+        const size_t a = (n == 0) ? 1 : 0;
+        const size_t b = (n == 2) ? 1 : 2;
+        for (size_t u = static_cast<size_t>(lo[a]); u < static_cast<size_t>(hi[a]); u++)
+        {
+            for (size_t w = static_cast<size_t>(lo[b]); w < static_cast<size_t>(hi[b]); w++)
+            {
+                faces.push_back(((code * 64 + static_cast<uint64_t>(lo[n])) * 64 + u) * 64 + w);
+            }
+        }
+    }
+}
+bool test_terrain_mesher()
+{
+    bool out = true;
+
+    // Seeded world with solid ground, a cave, scattered blocks and empty sky
+    const size_t scale = 32;
+    const size_t chunk_size = 8;
+    game::chunk_store store(scale, chunk_size);
+    const game::block_id ids[] = {game::block_id::EMPTY, game::block_id::SAND1, game::block_id::DIRT1, game::block_id::STONE1, game::block_id::GRASS1};
+    for (size_t x = 0; x < scale; x++)
+    {
+        for (size_t y = 0; y < scale / 2; y++)
+        {
+            for (size_t z = 0; z < scale; z++)
+            {
+                const bool cave = (x > 4 && x < 20 && y > 3 && y < 9 && z > 6 && z < 14);
+                store.set(min::tri<size_t>(x, y, z), cave ? game::block_id::EMPTY : game::block_id::STONE1);
+            }
+        }
+    }
+    std::mt19937 gen(17);
+    std::uniform_int_distribution<size_t> cell(0, scale - 1);
+    std::uniform_int_distribution<size_t> id(0, 4);
+    for (size_t i = 0; i < 6000; i++)
+    {
+        store.set(min::tri<size_t>(cell(gen), cell(gen), cell(gen)), ids[id(gen)]);
+    }
+
+    // Packed vertices keep every field in the bits the terrain shaders unpack, at the limits
+    const uint32_t packed = game::face_pack(min::vec4<float>(127.0, 0.0, 127.0, game::face_code(5, 37)));
+    out = out && compare(static_cast<int>(packed & 127u), 127);
+    out = out && compare(static_cast<int>((packed >> 7u) & 127u), 0);
+    out = out && compare(static_cast<int>((packed >> 14u) & 127u), 127);
+    out = out && compare(static_cast<int>((packed >> 21u) & 7u), 5);
+    out = out && compare(static_cast<int>((packed >> 24u) & 63u), 37);
+    const uint32_t last = game::face_pack(min::vec4<float>(0.0, 127.0, 0.0, game::face_code(0, 63)));
+    out = out && compare(static_cast<int>((last >> 7u) & 127u), 127);
+    out = out && compare(static_cast<int>((last >> 21u) & 7u), 0);
+    out = out && compare(static_cast<int>((last >> 24u) & 63u), 63);
+    out = out && compare(static_cast<int>(last >> 30u), 0);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher face pack");
+    }
+
+    // Reference meshes of every chunk from grid lookups
+    const size_t chunks = store.get_chunks();
+    game::terrain_mesher mesher(chunk_size);
+    std::vector<min::mesh<float, uint32_t>> reference(chunks, min::mesh<float, uint32_t>("chunk"));
+    size_t faces = 0;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        test_terrain_mesher_grid(store, scale, chunk_size, mesher, key, reference[key]);
+        faces += reference[key].vertex.size() / 6;
+    }
+    out = out && compare(faces > 0, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher reference");
+    }
+
+    // Padded copies give the same vertex streams as grid lookups
+    min::mesh<float, uint32_t> mesh("chunk");
+    bool strided = true;
+    bool padded = true;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        test_terrain_mesher_padded(store, scale, chunk_size, mesher, key, mesh, [&mesher](const std::vector<game::block_id> &cells) {
+            mesher.generate_chunk_strided(cells);
+        });
+        strided = strided && test_terrain_mesher_equal(reference[key], mesh);
+        test_terrain_mesher_padded(store, scale, chunk_size, mesher, key, mesh, [&mesher](const std::vector<game::block_id> &cells) {
+            mesher.generate_chunk_padded(cells);
+        });
+        padded = padded && test_terrain_mesher_equal(reference[key], mesh);
+    }
+    out = out && compare(strided, true);
+    out = out && compare(padded, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher padded faces");
+    }
+
+    // Occupancy bitmasks give the same vertex streams as grid lookups
+    bool masked = true;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        test_terrain_mesher_padded(store, scale, chunk_size, mesher, key, mesh, [&mesher](const std::vector<game::block_id> &cells) {
+            mesher.generate_chunk_masked(cells);
+        });
+        masked = masked && test_terrain_mesher_equal(reference[key], mesh);
+    }
+    out = out && compare(masked, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher masked faces");
+    }
+
+    // The widest chunk fills all 64 bits of a padded row
+    const size_t wide = 62;
+    game::chunk_store wide_store(wide, wide);
+    std::uniform_int_distribution<size_t> wide_cell(0, wide - 1);
+    for (size_t i = 0; i < 40000; i++)
+    {
+        wide_store.set(min::tri<size_t>(wide_cell(gen), wide_cell(gen), wide_cell(gen)), ids[1 + id(gen) % 4]);
+    }
+    game::terrain_mesher wide_mesher(wide);
+    min::mesh<float, uint32_t> wide_reference("chunk");
+    test_terrain_mesher_grid(wide_store, wide, wide, wide_mesher, 0, wide_reference);
+    test_terrain_mesher_padded(wide_store, wide, wide, wide_mesher, 0, mesh, [&wide_mesher](const std::vector<game::block_id> &cells) {
+        wide_mesher.generate_chunk_masked(cells);
+    });
+    out = out && compare(wide_reference.vertex.size() > 0, true);
+    out = out && compare(test_terrain_mesher_equal(wide_reference, mesh), true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher masked 64 bit rows");
+    }
+
+    // Chunk parallel batches give the same meshes as serial chunk updates
+    min::thread_pool pool;
+    game::mesh_batch batch(chunk_size, 3, false);
+    std::vector<size_t> keys(chunks);
+    for (size_t key = 0; key < chunks; key++)
+    {
+        keys[key] = key;
+    }
+    std::vector<min::mesh<float, uint32_t>> batched(chunks, min::mesh<float, uint32_t>("chunk"));
+    batch.generate(pool, store, keys, batched, [scale, chunk_size](const size_t key) {
+        return test_terrain_mesher_origin(scale, chunk_size, key);
+    });
+    pool.kill();
+    bool same = true;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        same = same && test_terrain_mesher_equal(reference[key], batched[key]);
+    }
+    out = out && compare(same, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher batch");
+    }
+
+    // Remesh every chunk on background threads from padded snapshots
+    std::vector<min::mesh<float, uint32_t>> remeshed(chunks, min::mesh<float, uint32_t>("chunk"));
+    std::vector<bool> done(chunks, false);
+    {
+        const float world_min = -static_cast<float>(scale / 2);
+        game::chunk_remesher remesher(chunk_size, min::vec3<float>(world_min, world_min, world_min), 2, false);
+        for (size_t key = 0; key < chunks; key++)
+        {
+            std::vector<game::block_id> cells;
+            store.copy_apron(key, cells, game::block_id::INVALID);
+            remesher.push(key, 0, static_cast<float>(chunks - key), test_terrain_mesher_start(scale, chunk_size, key), std::move(cells));
+        }
+        size_t received = 0;
+        while (received < chunks)
+        {
+            std::this_thread::yield();
+            remesher.pop([&remeshed, &done, &received](const size_t key, const size_t version, min::mesh<float, uint32_t> &mesh) {
+                remeshed[key].vertex = mesh.vertex;
+                received += !done[key];
+                done[key] = true;
+            });
+        }
+    }
+    same = true;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        same = same && test_terrain_mesher_equal(reference[key], remeshed[key]);
+    }
+    out = out && compare(same, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher background remesh");
+    }
+
+    // Greedy meshes cover the same visible faces with fewer quads
+    game::terrain_mesher greedy(chunk_size);
+    greedy.set_greedy(true);
+    min::mesh<float, uint32_t> merged("chunk");
+    size_t quads = 0;
+    same = true;
+    for (size_t key = 0; key < chunks; key++)
+    {
+        test_terrain_mesher_grid(store, scale, chunk_size, greedy, key, merged);
+        quads += merged.vertex.size() / 6;
+
+        // Compare the sorted unit faces
+        std::vector<uint64_t> expect;
+        std::vector<uint64_t> cover;
+        test_terrain_mesher_faces(reference[key], expect);
+        test_terrain_mesher_faces(merged, cover);
+        std::sort(expect.begin(), expect.end());
+        std::sort(cover.begin(), cover.end());
+        same = same && (expect == cover);
+    }
+    out = out && compare(same, true);
+    out = out && compare(quads < faces, true);
+    if (!out)
+    {
+        throw std::runtime_error("Failed terrain mesher greedy cover");
+    }
+
+    // return status
+    return out;
+}
+
+#endif